@@ -37,7 +37,8 @@ There are two versions of long-form integers depending on whether the GMP
 library is available.  If it is then the byte cells contain "limbs",
 typically native 32 or 64-bit words.  If it is not, the fall-back
 Poly code is used in which long-form integers are vectors of
-bytes (i.e. unsigned char).
+bytes (i.e. unsigned char).  Multiplication and division in the
+fall-back code convert these to native words.
 Integers are always stored in the least possible number of words, and
 will be shortened to the short-form when possible.
 
@@ -93,6 +94,9 @@ Thanks are due to D. Knuth for the long division algorithm.
 #include "memmgr.h"
 #include "rtsentry.h"
 #include "profiling.h"
+#include "gc.h"
+#include "gctaskfarm.h"
+#include "polystring.h"
 
 extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyAddArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
@@ -105,6 +109,11 @@ extern "C" {
     POLYEXTERNALSYMBOL POLYSIGNED PolyCompareArbitrary(POLYUNSIGNED arg1, POLYUNSIGNED arg2);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyGCDArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyLCMArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyMultiplyModArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyPowModArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAddMultiplyArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyDivModArbitraryPair(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyFormatArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetLowOrderAsLargeWord(POLYUNSIGNED threadId, POLYUNSIGNED arg);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyOrArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyAndArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2);
@@ -936,158 +945,947 @@ Handle sub_longc(TaskData *taskData, Handle y, Handle x)
 } /* sub_longc */
 
 
-Handle mult_longc(TaskData *taskData, Handle y, Handle x)
-{
-    int sign_x, sign_y;
-#if USE_GMP
-    mp_limb_t    x_extend, y_extend;
-    mp_size_t lx, ly;
-    (void)convertToLong(x, &x_extend, &lx, &sign_x);
-    (void)convertToLong(y, &y_extend, &ly, &sign_y);
+static inline size_t maxSize(size_t a, size_t b) { return a > b ? a : b; }
+
+#ifndef USE_GMP
+/*
+Multiplication and division in the fall-back code.  The numbers are held as
+vectors of bytes but the arithmetic is done on native words, "digits", in a
+work area.  Since the values are little-endian and padded to a whole number of
+Poly words the conversion is just a copy on little-endian machines.
+Small products use the schoolbook method.  Above KARATSUBA_THRESHOLD digits
+Karatsuba's method is used and above TOOM3_THRESHOLD Toom-Cook 3-way
+multiplication.  Division uses Knuth's algorithm D but when the divisor has at
+least DIV_NEWTON_THRESHOLD digits and the quotient is at least as long it
+computes a reciprocal of the divisor by Newton's method and uses that to
+produce the quotient a block at a time.  The thresholds were chosen by timing
+on X86-64.
+*/
+
+#if (SIZEOF_POLYWORD == 8 && defined(__SIZEOF_INT128__))
+typedef uint64_t arbDigit;
+typedef unsigned __int128 arbDoubleDigit;
 #else
-    byte    x_extend[sizeof(PolyWord)], y_extend[sizeof(PolyWord)];
-    POLYUNSIGNED lx, ly;
-    (void)convertToLong(x, x_extend, &lx, &sign_x);
-    (void)convertToLong(y, y_extend, &ly, &sign_y);
+typedef uint32_t arbDigit;
+typedef uint64_t arbDoubleDigit;
 #endif
-    // Check for zero args.
-    if (lx == 0 || ly == 0) return taskData->saveVec.push(TAGGED(0));
 
-#if USE_GMP
-    Handle z = alloc_and_save(taskData, WORDS((lx+ly)*sizeof(mp_limb_t)), F_MUTABLE_BIT|F_BYTE_OBJ);
-    mp_limb_t *w = DEREFLIMBHANDLE(z);
-    mp_limb_t *u = IS_INT(DEREFWORD(x)) ? &x_extend : DEREFLIMBHANDLE(x);
-    mp_limb_t *v = IS_INT(DEREFWORD(y)) ? &y_extend : DEREFLIMBHANDLE(y);
+#define DIGIT_BITS          (sizeof(arbDigit)*8)
+#define DIGITS(bytes)       (((bytes)+sizeof(arbDigit)-1)/sizeof(arbDigit))
 
-    // The first argument must be the longer.
-    if (lx < ly) mpn_mul(w, v, ly, u, lx);
-    else mpn_mul(w, u, lx, v, ly);
+#ifndef KARATSUBA_THRESHOLD
+#define KARATSUBA_THRESHOLD     24
+#endif
+#ifndef TOOM3_THRESHOLD
+#define TOOM3_THRESHOLD         100
+#endif
+#ifndef DIV_NEWTON_THRESHOLD
+#define DIV_NEWTON_THRESHOLD    500
+#endif
+#ifndef RECIPROCAL_THRESHOLD
+#define RECIPROCAL_THRESHOLD    100
+#endif
+#if (KARATSUBA_THRESHOLD < 16 || TOOM3_THRESHOLD < 48 || RECIPROCAL_THRESHOLD < 8)
+// digitsMulScratch and digitsReciprocal assume these.
+#error "Multiplication or division threshold too small"
+#endif
 
-    return make_canonical(taskData, z, sign_x ^ sign_y);
+static void digitsFromBytes(arbDigit *d, size_t ld, const byte *b, POLYUNSIGNED lb)
+// Set ld digits from lb bytes, zero-extending.
+{
+#ifndef WORDS_BIGENDIAN
+    memcpy(d, b, lb);
+    memset((byte*)d + lb, 0, ld*sizeof(arbDigit) - lb);
 #else
-    /* Get space for result */
-    Handle long_z = alloc_and_save(taskData, WORDS(lx+ly+1), F_MUTABLE_BIT|F_BYTE_OBJ);
-
-    /* Can now load the actual addresses because they will not change now. */
-    byte *u = IS_INT(DEREFWORD(x)) ? x_extend : DEREFBYTEHANDLE(x);
-    byte *v = IS_INT(DEREFWORD(y)) ? y_extend : DEREFBYTEHANDLE(y);
-    byte *w = DEREFBYTEHANDLE(long_z);
-
-    for(POLYUNSIGNED i = 0; i < lx; i++)
+    for (size_t i = 0; i < ld; i++)
     {
-        POLYUNSIGNED j;
-        long r = 0; /* Set the carry to zero */
-        for(j = 0; j < ly; j++)
+        arbDigit r = 0;
+        for (unsigned j = 0; j < sizeof(arbDigit); j++)
         {
-            /* Compute the product. */
-            r += u[i] * v[j];
-            /* Now add in to the result. */
-            r += w[i+j];
-            w[i+j] = r & 0xff;
-            r >>= 8;
+            POLYUNSIGNED n = i*sizeof(arbDigit) + j;
+            if (n < lb) r |= (arbDigit)b[n] << (8*j);
         }
-        /* Put in any carry. */
-        w[i+j] = (byte)r;
+        d[i] = r;
     }
+#endif
+}
 
-    return make_canonical(taskData, long_z, sign_x ^ sign_y);
+static void bytesFromDigits(byte *b, POLYUNSIGNED lb, const arbDigit *d)
+// Set lb bytes from the digits.  Any higher digits must be zero.
+{
+#ifndef WORDS_BIGENDIAN
+    memcpy(b, d, lb);
+#else
+    for (POLYUNSIGNED n = 0; n < lb; n++)
+        b[n] = (byte)(d[n/sizeof(arbDigit)] >> (8*(n % sizeof(arbDigit))));
 #endif
-} /* mult_long */
+}
 
-#ifndef USE_GMP
-static void div_unsigned_long(byte *u, byte *v, byte *remres, byte *divres, POLYUNSIGNED lu, POLYUNSIGNED lv)
-// Unsigned division. This is the main divide and remainder routine.
-// remres must be at least lu+1 bytes long
-// divres must be at least lu-lv+1 bytes long but can be zero if not required
+// Length with leading zeros removed.
+static size_t digitsLength(const arbDigit *u, size_t lu)
+{
+    while (lu > 0 && u[lu-1] == 0) lu--;
+    return lu;
+}
+
+static int digitsCompare(const arbDigit *u, size_t lu, const arbDigit *v, size_t lv)
+{
+    lu = digitsLength(u, lu);
+    lv = digitsLength(v, lv);
+    if (lu != lv) return lu < lv ? -1 : 1;
+    while (lu > 0)
+    {
+        lu--;
+        if (u[lu] != v[lu]) return u[lu] < v[lu] ? -1 : 1;
+    }
+    return 0;
+}
+
+// w = u + v where lu >= lv.  w may be the same as u or v.  Returns the carry.
+static arbDigit digitsAdd(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv)
+{
+    arbDigit carry = 0;
+    size_t i = 0;
+    for (; i < lv; i++)
+    {
+        arbDigit s = u[i] + carry;
+        carry = s < carry;
+        w[i] = s + v[i];
+        carry += w[i] < s;
+    }
+    for (; i < lu; i++)
+    {
+        w[i] = u[i] + carry;
+        carry = w[i] < carry;
+    }
+    return carry;
+}
+
+// w = u - v where lu >= lv.  w may be the same as u or v.  Returns the borrow.
+static arbDigit digitsSub(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv)
+{
+    arbDigit borrow = 0;
+    size_t i = 0;
+    for (; i < lv; i++)
+    {
+        arbDigit s = u[i] - borrow;
+        borrow = u[i] < borrow;
+        borrow += s < v[i];
+        w[i] = s - v[i];
+    }
+    for (; i < lu; i++)
+    {
+        arbDigit s = u[i];
+        w[i] = s - borrow;
+        borrow = s < borrow;
+    }
+    return borrow;
+}
+
+// Negate an n-digit two's complement value in place.
+static void digitsNegate(arbDigit *u, size_t n)
+{
+    arbDigit carry = 1;
+    for (size_t i = 0; i < n; i++)
+    {
+        u[i] = ~u[i] + carry;
+        carry = carry && u[i] == 0;
+    }
+}
+
+// w = u * m.  Returns the high digit.
+static arbDigit digitsMul1(arbDigit *w, const arbDigit *u, size_t n, arbDigit m)
 {
-    POLYUNSIGNED i,j;
-    long r;
+    arbDigit carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        arbDoubleDigit p = (arbDoubleDigit)u[i] * m + carry;
+        w[i] = (arbDigit)p;
+        carry = (arbDigit)(p >> DIGIT_BITS);
+    }
+    return carry;
+}
 
-    /* Find out how far to shift v to get a 1 in the top bit. */
-    int bits = 0;
-    for(r = v[lv-1]; r < 128; r <<= 1) bits++; /* 128 ??? */
+// w += u * m.  Returns the carry.
+static arbDigit digitsAddMul1(arbDigit *w, const arbDigit *u, size_t n, arbDigit m)
+{
+    arbDigit carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        arbDoubleDigit p = (arbDoubleDigit)u[i] * m + carry + w[i];
+        w[i] = (arbDigit)p;
+        carry = (arbDigit)(p >> DIGIT_BITS);
+    }
+    return carry;
+}
 
-    /* Shift u that amount into res. We have allowed enough room for
-       overflow. */
-    r = 0;
-    for (i = 0; i < lu; i++)
+// w -= u * m.  Returns the borrow.
+static arbDigit digitsSubMul1(arbDigit *w, const arbDigit *u, size_t n, arbDigit m)
+{
+    arbDigit borrow = 0;
+    for (size_t i = 0; i < n; i++)
     {
-        r |= u[i] << bits; /*``Or in'' the new bits after shifting*/
-        remres[i] = r & 0xff;    /* Put into the destination. */
-        r >>= 8;                /* and shift down the carry. */
+        arbDoubleDigit p = (arbDoubleDigit)u[i] * m + borrow;
+        arbDigit lo = (arbDigit)p;
+        borrow = (arbDigit)(p >> DIGIT_BITS);
+        if (w[i] < lo) borrow++;
+        w[i] -= lo;
     }
-    remres[i] = (byte)r; /* Put in the carry */
+    return borrow;
+}
 
-    /* And v that amount. It has already been copied. */
-    if ( bits )
+// w = u << shift where shift < DIGIT_BITS.  Returns the bits shifted out.
+static arbDigit digitsShiftLeft(arbDigit *w, const arbDigit *u, size_t n, unsigned shift)
+{
+    if (shift == 0)
+    {
+        memmove(w, u, n*sizeof(arbDigit));
+        return 0;
+    }
+    arbDigit out = 0;
+    for (size_t i = 0; i < n; i++)
     {
-        r = 0;
-        for (i = 0; i < lv; i++)
-        { r |= v[i] << bits; v[i] = r & 0xff; r >>= 8; }
-        /* No carry */
+        arbDigit d = u[i];
+        w[i] = (d << shift) | out;
+        out = d >> (DIGIT_BITS-shift);
     }
+    return out;
+}
 
-    for(j = lu; j >= lv; j--)
+// w = u >> shift where shift < DIGIT_BITS.
+static void digitsShiftRight(arbDigit *w, const arbDigit *u, size_t n, unsigned shift)
+{
+    if (shift == 0)
+    {
+        memmove(w, u, n*sizeof(arbDigit));
+        return;
+    }
+    for (size_t i = 0; i < n; i++)
     {
-    /* j iterates over the higher digits of the dividend until we are left
-        with a number which is less than the divisor. This is the remainder. */
-        long quotient, dividend, r;
-        dividend = remres[j]*256 + remres[j-1];
-        quotient = (remres[j] == v[lv-1]) ? 255 : dividend/(long)v[lv-1];
+        arbDigit hi = i+1 < n ? u[i+1] << (DIGIT_BITS-shift) : 0;
+        w[i] = (u[i] >> shift) | hi;
+    }
+}
+
+static void digitsMulBasecase(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv)
+{
+    w[lu] = digitsMul1(w, u, lu, v[0]);
+    for (size_t j = 1; j < lv; j++)
+        w[lu+j] = digitsAddMul1(w+j, u, lu, v[j]);
+}
+
+// An upper bound on the size of the work area needed by digitsMul.  Each level
+// of Karatsuba or Toom-3 uses less than 4n+16 digits itself and the recursive
+// calls are on at most n/2+1 digits so 6n+100 is always enough.
+static size_t digitsMulScratch(size_t lu, size_t lv)
+{
+    if (lu < KARATSUBA_THRESHOLD || lv < KARATSUBA_THRESHOLD) return 0;
+    return 6*maxSize(lu, lv) + 100;
+}
+
+static void digitsMul(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch);
+
+static void digitsKaratsuba(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch)
+// Split u and v into halves: u = u1*B^h + u0, v = v1*B^h + v0.
+// Then u*v = u1*v1*B^2h + ((u0+u1)*(v0+v1) - u0*v0 - u1*v1)*B^h + u0*v0
+{
+    size_t h = (lu+1)/2;
+    arbDigit *su = scratch, *sv = su+h+1, *zm = sv+h+1, *next = zm+2*h+2;
+    digitsMul(w, u, h, v, h, next);
+    digitsMul(w+2*h, u+h, lu-h, v+h, lv-h, next);
+    su[h] = digitsAdd(su, u, h, u+h, lu-h);
+    sv[h] = digitsAdd(sv, v, h, v+h, lv-h);
+    digitsMul(zm, su, h+1, sv, h+1, next);
+    digitsSub(zm, zm, 2*h+2, w, 2*h);
+    digitsSub(zm, zm, 2*h+2, w+2*h, lu+lv-2*h);
+    digitsAdd(w+h, w+h, lu+lv-h, zm, digitsLength(zm, 2*h+2));
+}
+
+// Copy the magnitude of an n-digit two's complement value into the low n-1
+// digits of m.  u is negated if it was negative.  Returns true if it was.
+static bool digitsAbs(arbDigit *m, arbDigit *u, size_t n)
+{
+    bool negative = (u[n-1] >> (DIGIT_BITS-1)) != 0;
+    if (negative) digitsNegate(u, n);
+    memcpy(m, u, (n-1)*sizeof(arbDigit));
+    return negative;
+}
 
-        if (lv != 1)
+// Divide an n-digit two's complement value by 3.  It must be an exact multiple.
+static void digitsDivExact3(arbDigit *u, size_t n)
+{
+    const arbDigit inverse3 = (arbDigit)(~(arbDigit)0 / 3 * 2 + 1); // 3*inverse3 = 1 mod B
+    arbDigit carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        arbDigit d = u[i];
+        arbDigit borrow = d < carry;
+        arbDigit q = (arbDigit)((d - carry) * inverse3);
+        u[i] = q;
+        carry = (arbDigit)(((arbDoubleDigit)q * 3) >> DIGIT_BITS) + borrow;
+    }
+}
+
+// Arithmetic shift right of an n-digit two's complement value by one bit.
+static void digitsHalve(arbDigit *u, size_t n)
+{
+    arbDigit sign = u[n-1] & ((arbDigit)1 << (DIGIT_BITS-1));
+    digitsShiftRight(u, u, n, 1);
+    u[n-1] |= sign;
+}
+
+static void digitsToom3(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch)
+// Split u and v into three parts and evaluate the polynomials u2*x^2+u1*x+u0 and
+// v2*x^2+v1*x+v0 at 0, 1, -1, -2 and infinity.  The products are interpolated
+// using Bodrato's sequence.  Intermediate values are held as (2k+2)-digit two's
+// complement numbers, which is enough to hold any of them with their sign.
+{
+    size_t k = (lu+2)/3, lu2 = lu-2*k, lv2 = lv-2*k, e = k+2, l = 2*k+2, lw = lu+lv;
+    arbDigit *pu = scratch, *pv = pu+e, *au = pv+e, *av = au+k+1;
+    arbDigit *r1 = av+k+1, *rm1 = r1+l, *rm2 = rm1+l, *next = rm2+l;
+    const arbDigit *r0 = w, *rinf = w+4*k;
+    size_t linf = lw-4*k;
+
+    // Products at 0 and infinity go straight into the result.
+    digitsMul(w, u, k, v, k, next);
+    digitsMul(w+4*k, u+2*k, lu2, v+2*k, lv2, next);
+
+    // At 1: u0+u1+u2.
+    memcpy(pu, u, k*sizeof(arbDigit)); pu[k] = pu[k+1] = 0;
+    digitsAdd(pu, pu, e, u+k, k);
+    digitsAdd(pu, pu, e, u+2*k, lu2);
+    memcpy(pv, v, k*sizeof(arbDigit)); pv[k] = pv[k+1] = 0;
+    digitsAdd(pv, pv, e, v+k, k);
+    digitsAdd(pv, pv, e, v+2*k, lv2);
+    digitsMul(r1, pu, k+1, pv, k+1, next);
+
+    // At -1: u0-u1+u2.
+    memcpy(pu, u, k*sizeof(arbDigit)); pu[k] = pu[k+1] = 0;
+    digitsAdd(pu, pu, e, u+2*k, lu2);
+    digitsSub(pu, pu, e, u+k, k);
+    memcpy(pv, v, k*sizeof(arbDigit)); pv[k] = pv[k+1] = 0;
+    digitsAdd(pv, pv, e, v+2*k, lv2);
+    digitsSub(pv, pv, e, v+k, k);
+    {
+        bool negu = digitsAbs(au, pu, e), negv = digitsAbs(av, pv, e);
+        digitsMul(rm1, au, k+1, av, k+1, next);
+        if (negu != negv) digitsNegate(rm1, l);
+        // Restore the signed values for the next evaluation.
+        if (negu) digitsNegate(pu, e);
+        if (negv) digitsNegate(pv, e);
+    }
+
+    // At -2: 2*(u0-u1+u2+u2)-u0 = u0-2*u1+4*u2.
+    digitsAdd(pu, pu, e, u+2*k, lu2);
+    digitsShiftLeft(pu, pu, e, 1);
+    digitsSub(pu, pu, e, u, k);
+    digitsAdd(pv, pv, e, v+2*k, lv2);
+    digitsShiftLeft(pv, pv, e, 1);
+    digitsSub(pv, pv, e, v, k);
+    {
+        bool negative = digitsAbs(au, pu, e) != digitsAbs(av, pv, e);
+        digitsMul(rm2, au, k+1, av, k+1, next);
+        if (negative) digitsNegate(rm2, l);
+    }
+
+    // Interpolate.  Borrows and carries out of the top are discarded.
+    digitsSub(rm2, rm2, l, r1, l);          // r3 = (r(-2) - r(1))/3
+    digitsDivExact3(rm2, l);
+    digitsSub(r1, r1, l, rm1, l);           // r1 = (r(1) - r(-1))/2
+    digitsHalve(r1, l);
+    digitsSub(rm1, rm1, l, r0, 2*k);        // r2 = r(-1) - r(0)
+    digitsSub(rm2, rm1, l, rm2, l);         // r3 = (r2 - r3)/2 + 2*r(inf)
+    digitsHalve(rm2, l);
+    digitsAdd(rm2, rm2, l, rinf, linf);
+    digitsAdd(rm2, rm2, l, rinf, linf);
+    digitsAdd(rm1, rm1, l, r1, l);          // r2 = r2 + r1 - r(inf)
+    digitsSub(rm1, rm1, l, rinf, linf);
+    digitsSub(r1, r1, l, rm2, l);           // r1 = r1 - r3
+
+    // Add in the middle coefficients.
+    memset(w+2*k, 0, 2*k*sizeof(arbDigit));
+    digitsAdd(w+k, w+k, lw-k, r1, digitsLength(r1, l));
+    digitsAdd(w+2*k, w+2*k, lw-2*k, rm1, digitsLength(rm1, l));
+    digitsAdd(w+3*k, w+3*k, lw-3*k, rm2, digitsLength(rm2, l));
+}
+
+// w = u * v where lu >= lv >= 1.  w has lu+lv digits and must not overlap
+// u or v.  scratch must have at least digitsMulScratch(lu, lv) digits.
+static void digitsMul(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch)
+{
+    if (lv < KARATSUBA_THRESHOLD)
+        digitsMulBasecase(w, u, lu, v, lv);
+    else if (lv <= (lu+1)/2)
+    {
+        // Very different lengths.  Multiply v by lv-digit pieces of u.
+        digitsMul(w, u, lv, v, lv, scratch);
+        arbDigit *t = scratch;
+        for (size_t i = lv; i < lu; i += lv)
         {
-            while ((long)v[lv-2]*quotient >
-                (dividend - quotient*(long)v[lv-1])*256 + (long)remres[j-2])
-            {
-                quotient--;
-            }
+            size_t lp = lu-i < lv ? lu-i : lv;
+            digitsMul(t, v, lv, u+i, lp, scratch+2*lv);
+            memset(w+i+lv, 0, lp*sizeof(arbDigit));
+            digitsAdd(w+i, w+i, lv+lp, t, lv+lp);
         }
+    }
+    else if (lv >= TOOM3_THRESHOLD && lv > 2*((lu+2)/3))
+        digitsToom3(w, u, lu, v, lv, scratch);
+    else digitsKaratsuba(w, u, lu, v, lv, scratch);
+}
+
+// As digitsMul but the arguments may be in either order.
+static void digitsMulAny(arbDigit *w, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch)
+{
+    if (lu >= lv) digitsMul(w, u, lu, v, lv, scratch);
+    else digitsMul(w, v, lv, u, lu, scratch);
+}
+
+// q = u / d, returns the remainder.
+static arbDigit digitsDivRem1(arbDigit *q, const arbDigit *u, size_t lu, arbDigit d)
+{
+    arbDigit r = 0;
+    for (size_t i = lu; i-- > 0; )
+    {
+        arbDoubleDigit n = ((arbDoubleDigit)r << DIGIT_BITS) | u[i];
+        q[i] = (arbDigit)(n / d);
+        r = (arbDigit)(n % d);
+    }
+    return r;
+}
 
-        /* The quotient is at most 1 too large */
-        /* Subtract the product of this with ``v'' from ``res''. */
-        r = 1; /* Initial borrow */
-        for(i = 0; i < lv; i++)
+static void digitsDivKnuth(arbDigit *q, arbDigit *u, size_t lu, const arbDigit *v, size_t lv)
+// Knuth's algorithm D.  v has lv >= 2 digits and the top bit of v[lv-1] is set.
+// u has lu+1 digits and u[lu] < v[lv-1].  q gets lu-lv+1 digits and u is
+// replaced by the remainder in its low lv digits.
+{
+    const arbDoubleDigit base = (arbDoubleDigit)1 << DIGIT_BITS;
+    arbDigit vtop = v[lv-1], vnext = v[lv-2];
+    for (size_t j = lu-lv+1; j-- > 0; )
+    {
+        // Estimate the quotient digit from the top digits.  It is at most 2 too large.
+        arbDoubleDigit n = ((arbDoubleDigit)u[j+lv] << DIGIT_BITS) | u[j+lv-1];
+        arbDoubleDigit qhat, rhat;
+        if (u[j+lv] >= vtop)
         {
-            r += 255 + remres[j-lv+i] - quotient * v[i];
-            remres[j-lv+i] = r & 0xff;
-            r >>= 8;
+            qhat = base-1;
+            rhat = n - qhat*vtop;
         }
+        else
+        {
+            qhat = n / vtop;
+            rhat = n % vtop;
+        }
+        while (rhat < base && qhat*vnext > ((rhat << DIGIT_BITS) | u[j+lv-2]))
+        {
+            qhat--;
+            rhat += vtop;
+        }
+        // Subtract qhat*v.  If that goes negative the estimate was one too large.
+        arbDigit borrow = digitsSubMul1(u+j, v, lv, (arbDigit)qhat);
+        arbDigit top = u[j+lv];
+        u[j+lv] = top - borrow;
+        if (top < borrow)
+        {
+            qhat--;
+            u[j+lv] += digitsAdd(u+j, u+j, lv, v, lv);
+        }
+        q[j] = (arbDigit)qhat;
+    }
+}
+
+static size_t digitsReciprocalScratch(size_t k)
+{
+    if (k < RECIPROCAL_THRESHOLD) return 3*k + 4;
+    size_t h = (k+1)/2 + 1;
+    return h+1 + maxSize(digitsReciprocalScratch(h),
+        (k+h+1) + (k+2*h+2) + maxSize(digitsMulScratch(k, h+1), digitsMulScratch(k+h+1, h+1)));
+}
+
+static void digitsReciprocal(arbDigit *x, const arbDigit *d, size_t k, arbDigit *scratch)
+// Set x, k+1 digits, to approximately B^2k / d where d has k digits and is
+// normalised.  It is computed from the reciprocal of the top half of d with
+// one step of Newton's method and may differ from the exact value by a small
+// amount.  The callers check and correct the quotients they compute.
+{
+    if (k < RECIPROCAL_THRESHOLD)
+    {
+        arbDigit *n = scratch, *qq = scratch+2*k+2;
+        memset(n, 0, (2*k+2)*sizeof(arbDigit));
+        n[2*k] = 1;
+        digitsDivKnuth(qq, n, 2*k+1, d, k);
+        memcpy(x, qq, (k+1)*sizeof(arbDigit));
+        return;
+    }
+    size_t h = (k+1)/2 + 1;
+    arbDigit *xh = scratch, *t = xh+h+1, *c = t+k+h+1, *next = c+k+2*h+2;
+    digitsReciprocal(xh, d+k-h, h, t);
+    // The first approximation is x0 = xh*B^(k-h).  The next is
+    // x0 + x0*(B^2k - d*x0)/B^2k = x0 + xh*(B^(k+h) - d*xh)/B^2h.
+    digitsMul(t, d, k, xh, h+1, next);
+    bool tooLarge = t[k+h] != 0;
+    if (tooLarge) t[k+h]--;
+    else digitsNegate(t, k+h);
+    memset(x, 0, (k-h)*sizeof(arbDigit));
+    memcpy(x+k-h, xh, (h+1)*sizeof(arbDigit));
+    size_t le = digitsLength(t, k+h+1);
+    if (le == 0) return;
+    digitsMulAny(c, xh, h+1, t, le, next);
+    size_t lc = digitsLength(c, h+1+le);
+    if (lc <= 2*h) return;
+    lc -= 2*h;
+    if (lc > k+1) lc = k+1;
+    if (tooLarge) digitsSub(x, x, k+1, c+2*h, lc);
+    else digitsAdd(x, x, k+1, c+2*h, lc);
+}
+
+static void digitsIncrement(arbDigit *u, size_t n)
+{
+    for (size_t i = 0; i < n && ++u[i] == 0; i++) ;
+}
+
+static void digitsDecrement(arbDigit *u, size_t n)
+{
+    for (size_t i = 0; i < n && u[i]-- == 0; i++) ;
+}
+
+static void digitsDivBlock(arbDigit *q, arbDigit *a, const arbDigit *v, const arbDigit *x, size_t k, arbDigit *scratch)
+// Divide a, 2k digits, by v, k digits, with x the approximate reciprocal of v.
+// a must be less than v*B^k.  q gets k digits and the remainder replaces a.
+{
+    arbDigit *t = scratch, *next = t+2*k+2;
+    // Estimate the quotient as (a/B^(k-1))*x/B^(k+1).
+    digitsMul(t, a+k-1, k+1, x, k+1, next);
+    if (t[2*k+1] != 0) memset(q, 0xff, k*sizeof(arbDigit));
+    else memcpy(q, t+k+1, k*sizeof(arbDigit));
+    digitsMul(t, q, k, v, k, next);
+    while (digitsCompare(t, 2*k, a, 2*k) > 0)
+    {
+        digitsSub(t, t, 2*k, v, k);
+        digitsDecrement(q, k);
+    }
+    digitsSub(a, a, 2*k, t, 2*k);
+    while (digitsCompare(a, 2*k, v, k) >= 0)
+    {
+        digitsSub(a, a, 2*k, v, k);
+        digitsIncrement(q, k);
+    }
+}
+
+static bool useNewtonDivision(size_t lu, size_t lv)
+{
+    return lv >= DIV_NEWTON_THRESHOLD && lu-lv+1 >= lv;
+}
+
+// The size of the work area needed by digitsDivRem.
+static size_t digitsDivScratch(size_t lu, size_t lv)
+{
+    if (lv == 1) return 0;
+    if (! useNewtonDivision(lu, lv)) return lv + lu + 1;
+    return lv + lu + 1 + lv + 1 +
+        maxSize(digitsReciprocalScratch(lv), 2*lv + 2 + digitsMulScratch(lv+1, lv+1));
+}
+
+static void digitsDivRem(arbDigit *q, arbDigit *r, const arbDigit *u, size_t lu, const arbDigit *v, size_t lv, arbDigit *scratch)
+// Unsigned division.  u has lu digits and v has lv digits with lu >= lv and
+// v[lv-1] non-zero.  q gets lu-lv+1 digits and r gets lv digits.
+{
+    if (lv == 1)
+    {
+        r[0] = digitsDivRem1(q, u, lu, v[0]);
+        return;
+    }
+    // Shift both so that the top bit of the divisor is set.
+    unsigned shift = 0;
+    for (arbDigit top = v[lv-1]; (top >> (DIGIT_BITS-1)) == 0; top <<= 1) shift++;
+    arbDigit *vn = scratch, *un = vn+lv, *next = un+lu+1;
+    digitsShiftLeft(vn, v, lv, shift);
+    un[lu] = digitsShiftLeft(un, u, lu, shift);
+    if (! useNewtonDivision(lu, lv))
+        digitsDivKnuth(q, un, lu, vn, lv);
+    else
+    {
+        // Long division with lv-digit blocks as the digits.  If the quotient is not a
+        // whole number of blocks the top few digits are found by Knuth's method.
+        size_t k = lv, nq = lu-lv+1, blocks = nq/k, part = nq%k;
+        arbDigit *x = next;
+        next = x+k+1;
+        if (part != 0)
+            digitsDivKnuth(q+blocks*k, un+blocks*k, part+k-1, vn, k);
+        digitsReciprocal(x, vn, k, next);
+        for (size_t b = blocks; b-- > 0; )
+            digitsDivBlock(q+b*k, un+b*k, vn, x, k, next);
+    }
+    digitsShiftRight(r, un, lv, shift);
+}
+
+#endif
+
+// The work area for multiplication and division and the fused operations
+// below holds "limbs": GMP limbs or digits in the fall-back code.
+#ifdef USE_GMP
+typedef mp_limb_t arbLimb;
+#define LIMB_BITS           GMP_NUMB_BITS
+#else
+typedef arbDigit arbLimb;
+#define LIMB_BITS           DIGIT_BITS
+#endif
+
+// Number of limbs in the work area on the stack.  Longer operations use a
+// byte object on the heap.
+#define ARB_LOCAL_LIMBS     256
 
-        r += remres[j]; /* Borrow from leading digit. */
-                     /* If we are left with a borrow when the subtraction is complete the
-                     quotient must have been too big. We add ``v'' to the dividend and
-        subtract 1 from the quotient. */
-        if (r == 0 /* would be 1 if there were no borrow */)
+// Allocate a work area, either on the stack or on the heap.  This must be
+// done before any pointers into the heap are dereferenced.
+class ArbWorkArea
+{
+public:
+    ArbWorkArea(TaskData *taskData, size_t limbs)
+    {
+        if (limbs <= ARB_LOCAL_LIMBS) area = local;
+        else
         {
-            quotient --;
-            r = 0;
-            for (i = 0; i < lv; i++)
-            {
-                r += v[i] + remres[j-lv+i];
-                remres[j-lv+i] = r & 0xff;
-                r >>= 8;
-            }
+            heapArea = alloc_and_save(taskData, WORDS(limbs*sizeof(arbLimb)), F_MUTABLE_BIT|F_BYTE_OBJ);
+            area = 0;
         }
-        /* Place the next digit of quotient in result */
-        if (divres) divres[j-lv] = (byte)quotient;
     }
+    // Returns the address.  Only valid until the next allocation.
+    arbLimb *Address() { return area != 0 ? area : (arbLimb*)DEREFBYTEHANDLE(heapArea); }
+
+private:
+    arbLimb local[ARB_LOCAL_LIMBS];
+    arbLimb *area;
+    Handle heapArea;
+};
+
+// Operations on limbs in a work area.  With GMP these use the mpn_ functions
+// and otherwise the digit functions above.
+#ifdef USE_GMP
+static size_t limbsMulScratch(size_t, size_t) { return 0; }
+static size_t limbsDivScratch(size_t, size_t) { return 0; }
+
+static void limbsMul(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv, arbLimb *)
+{
+    if (lu >= lv) mpn_mul(w, u, lu, v, lv);
+    else mpn_mul(w, v, lv, u, lu);
+}
+
+static void limbsDivRem(arbLimb *q, arbLimb *r, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv, arbLimb *)
+{
+    mpn_tdiv_qr(q, r, 0, u, lu, v, lv);
+}
+
+static size_t limbsLength(const arbLimb *u, size_t lu)
+{
+    while (lu > 0 && u[lu-1] == 0) lu--;
+    return lu;
+}
+
+// w = u + v or u - v where lu >= lv.  Returns the carry or borrow.
+static arbLimb limbsAdd(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    if (lv != 0) return mpn_add(w, u, lu, v, lv);
+    memmove(w, u, lu*sizeof(arbLimb));
+    return 0;
+}
+
+static arbLimb limbsSub(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    if (lv != 0) return mpn_sub(w, u, lu, v, lv);
+    memmove(w, u, lu*sizeof(arbLimb));
+    return 0;
+}
+
+static int limbsCompare(const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    lu = limbsLength(u, lu);
+    lv = limbsLength(v, lv);
+    if (lu != lv) return lu < lv ? -1 : 1;
+    return mpn_cmp(u, v, lu);
+}
+
+// Returns the number of limbs in the absolute value.
+static size_t limbsOf(Handle x)
+{
+    mp_limb_t extend;
+    mp_size_t length;
+    (void)convertToLong(x, &extend, &length, NULL);
+    return length;
+}
+
+// Copy the absolute value into n limbs and return the sign.
+static int loadLimbs(Handle x, arbLimb *dest, size_t n)
+{
+    mp_limb_t extend;
+    mp_size_t length;
+    int sign;
+    mp_limb_t *u = convertToLong(x, &extend, &length, &sign);
+    memcpy(dest, u, length*sizeof(arbLimb));
+    memset(dest+length, 0, (n-length)*sizeof(arbLimb));
+    return sign;
+}
+
+// Make a new number from limbs in the work area.  Pointers into the work area
+// must be reloaded after this because it allocates.
+static Handle storeLimbs(TaskData *taskData, ArbWorkArea &work, size_t offset, size_t n, int sign)
+{
+    n = limbsLength(work.Address()+offset, n);
+    if (n == 0) return taskData->saveVec.push(TAGGED(0));
+    Handle result = alloc_and_save(taskData, WORDS(n*sizeof(arbLimb)), F_MUTABLE_BIT|F_BYTE_OBJ);
+    memcpy(DEREFLIMBHANDLE(result), work.Address()+offset, n*sizeof(arbLimb));
+    return make_canonical(taskData, result, sign);
+}
+#else
+static size_t limbsMulScratch(size_t lu, size_t lv) { return digitsMulScratch(lu, lv); }
+static size_t limbsDivScratch(size_t lu, size_t lv) { return digitsDivScratch(lu, lv); }
+
+static void limbsMul(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv, arbLimb *scratch)
+{
+    digitsMulAny(w, u, lu, v, lv, scratch);
+}
+
+static void limbsDivRem(arbLimb *q, arbLimb *r, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv, arbLimb *scratch)
+{
+    digitsDivRem(q, r, u, lu, v, lv, scratch);
+}
+
+static size_t limbsLength(const arbLimb *u, size_t lu) { return digitsLength(u, lu); }
+
+static arbLimb limbsAdd(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    return digitsAdd(w, u, lu, v, lv);
+}
+
+static arbLimb limbsSub(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    return digitsSub(w, u, lu, v, lv);
+}
+
+static int limbsCompare(const arbLimb *u, size_t lu, const arbLimb *v, size_t lv)
+{
+    return digitsCompare(u, lu, v, lv);
+}
+
+static size_t limbsOf(Handle x)
+{
+    byte extend[sizeof(PolyWord)];
+    POLYUNSIGNED length;
+    (void)convertToLong(x, extend, &length, NULL);
+    return DIGITS(length);
+}
+
+static int loadLimbs(Handle x, arbLimb *dest, size_t n)
+{
+    byte extend[sizeof(PolyWord)];
+    POLYUNSIGNED length;
+    int sign;
+    byte *u = convertToLong(x, extend, &length, &sign);
+    digitsFromBytes(dest, n, u, length);
+    return sign;
+}
+
+static Handle storeLimbs(TaskData *taskData, ArbWorkArea &work, size_t offset, size_t n, int sign)
+{
+    n = limbsLength(work.Address()+offset, n);
+    if (n == 0) return taskData->saveVec.push(TAGGED(0));
+    Handle result = alloc_and_save(taskData, WORDS(n*sizeof(arbLimb)), F_MUTABLE_BIT|F_BYTE_OBJ);
+    bytesFromDigits(DEREFBYTEHANDLE(result), n*sizeof(arbLimb), work.Address()+offset);
+    return make_canonical(taskData, result, sign);
+}
+#endif
+
+/*
+Multiplication of very long numbers can be split into independent products
+that are run in parallel on the GC task farm.  One or two levels of Karatsuba's
+method are used to split balanced operands and if the operands are very
+unbalanced the longer one is split in two.  The sums needed by Karatsuba are
+computed first, then the products are run in parallel and finally the results
+are combined.  The products are computed by limbsMul so with GMP each is an
+mpn_mul call.
+*/
+#ifndef PARALLEL_MUL_THRESHOLD
+#define PARALLEL_MUL_THRESHOLD  10000   // Limbs in the shorter operand
+#endif
+
+#define PARALLEL_MUL_MAX_PRODUCTS   9   // Products with two levels of splitting
+
+typedef struct {
+    arbLimb *w, *scratch;
+    const arbLimb *u, *v;
+    size_t lu, lv;
+} ParallelMulProduct;
+
+// A split step, recorded so that it can be combined once the products are known.
+typedef struct {
+    arbLimb *w, *t;
+    size_t lu, lv, h;
+    bool karatsuba;
+} ParallelMulStep;
+
+typedef struct {
+    ParallelMulProduct products[PARALLEL_MUL_MAX_PRODUCTS];
+    ParallelMulStep steps[PARALLEL_MUL_MAX_PRODUCTS];
+    unsigned nProducts, nSteps;
+} ParallelMulPlan;
+
+// Serialises the use of the task farm for multiplication.  WaitForCompletion
+// can only be called by one thread at a time.
+static PLock parallelMulLock("Parallel multiply");
+
+// The number of levels of splitting to use.  Zero if the multiplication should
+// not be done in parallel.
+static unsigned parallelMulLevels(size_t lv)
+{
+    if (lv < PARALLEL_MUL_THRESHOLD || gpTaskFarm == 0) return 0;
+    unsigned threads = gpTaskFarm->ThreadCount();
+    return threads <= 1 ? 0 : threads <= 3 ? 1 : 2;
+}
+
+// The size of the work area needed to multiply u by v with lu >= lv.
+static size_t parallelMulScratch(size_t lu, size_t lv, unsigned levels)
+{
+    if (lu < lv) { size_t l = lu; lu = lv; lv = l; }
+    if (levels == 0) return limbsMulScratch(lu, lv);
+    size_t h = (lu+1)/2;
+    if (lv > h) // Karatsuba: two sums and the middle product.
+        return 4*h + 4 + parallelMulScratch(h, h, levels-1) +
+            parallelMulScratch(lu-h, lv-h, levels-1) + parallelMulScratch(h+1, h+1, levels-1);
+    else // Split u.  The product of the upper part is added in.
+        return lu - h + lv + parallelMulScratch(h, lv, levels-1) + parallelMulScratch(lu-h, lv, levels-1);
+}
+
+// Split the multiplication of u by v into products.  Returns the part of the work area not used.
+static arbLimb *parallelMulSplit(ParallelMulPlan &plan, arbLimb *w, const arbLimb *u, size_t lu,
+                                 const arbLimb *v, size_t lv, arbLimb *work, unsigned levels)
+{
+    if (lu < lv) { const arbLimb *t = u; u = v; v = t; size_t l = lu; lu = lv; lv = l; }
+    if (levels == 0)
+    {
+        ParallelMulProduct &p = plan.products[plan.nProducts++];
+        p.w = w; p.u = u; p.lu = lu; p.v = v; p.lv = lv; p.scratch = work;
+        return work + limbsMulScratch(lu, lv);
+    }
+    ParallelMulStep &step = plan.steps[plan.nSteps++];
+    size_t h = (lu+1)/2;
+    step.w = w; step.lu = lu; step.lv = lv; step.h = h;
+    step.karatsuba = lv > h;
+    if (step.karatsuba)
+    {
+        // w = u0*v0 + ((u0+u1)*(v0+v1) - u0*v0 - u1*v1)*B^h + u1*v1*B^2h
+        arbLimb *su = work, *sv = su+h+1;
+        step.t = sv+h+1;
+        su[h] = limbsAdd(su, u, h, u+h, lu-h);
+        sv[h] = limbsAdd(sv, v, h, v+h, lv-h);
+        work = step.t+2*h+2;
+        work = parallelMulSplit(plan, w, u, h, v, h, work, levels-1);
+        work = parallelMulSplit(plan, w+2*h, u+h, lu-h, v+h, lv-h, work, levels-1);
+        return parallelMulSplit(plan, step.t, su, h+1, sv, h+1, work, levels-1);
+    }
+    else
+    {
+        // w = u0*v + u1*v*B^h
+        step.t = work;
+        work += lu-h+lv;
+        memset(w+h+lv, 0, (lu-h)*sizeof(arbLimb));
+        work = parallelMulSplit(plan, w, u, h, v, lv, work, levels-1);
+        return parallelMulSplit(plan, step.t, u+h, lu-h, v, lv, work, levels-1);
+    }
+}
+
+static void parallelMulTask(GCTaskId *, void *arg1, void *)
+{
+    ParallelMulProduct *p = (ParallelMulProduct *)arg1;
+    limbsMul(p->w, p->u, p->lu, p->v, p->lv, p->scratch);
+}
+
+// Multiply u by v into w, running the products in parallel.  Returns false if
+// the task farm is already being used for this, in which case nothing is done.
+static bool parallelMultiply(arbLimb *w, const arbLimb *u, size_t lu, const arbLimb *v, size_t lv,
+                             arbLimb *work, unsigned levels)
+{
+    if (! parallelMulLock.Trylock()) return false;
+    ParallelMulPlan plan;
+    plan.nProducts = plan.nSteps = 0;
+    (void)parallelMulSplit(plan, w, u, lu, v, lv, work, levels);
+    for (unsigned i = 1; i < plan.nProducts; i++)
+        gpTaskFarm->AddWorkOrRunNow(parallelMulTask, &plan.products[i], 0);
+    parallelMulTask(globalTask, &plan.products[0], 0);
+    gpTaskFarm->WaitForCompletion();
+    parallelMulLock.Unlock();
 
-    /* Likewise the remainder. */
-    if (bits)
+    // Combine the results.  The later steps are the inner ones.
+    for (unsigned i = plan.nSteps; i-- > 0; )
     {
-        r = 0;
-        j = lv;
-        while (j > 0)
+        ParallelMulStep &step = plan.steps[i];
+        size_t h = step.h, lu = step.lu, lv = step.lv, lw = lu+lv;
+        if (step.karatsuba)
         {
-            j--;
-            r |= remres[j];
-            remres[j] = (r >> bits) & 0xff;
-            r = (r & 0xff) << 8;
+            limbsSub(step.t, step.t, 2*h+2, step.w, 2*h);
+            limbsSub(step.t, step.t, 2*h+2, step.w+2*h, lw-2*h);
+            limbsAdd(step.w+h, step.w+h, lw-h, step.t, limbsLength(step.t, 2*h+2));
         }
+        else limbsAdd(step.w+h, step.w+h, lw-h, step.t, lu-h+lv);
+    }
+    return true;
+}
+
+Handle mult_longc(TaskData *taskData, Handle y, Handle x)
+{
+    int sign_x, sign_y;
+#if USE_GMP
+    mp_limb_t    x_extend, y_extend;
+    mp_size_t lx, ly;
+    (void)convertToLong(x, &x_extend, &lx, &sign_x);
+    (void)convertToLong(y, &y_extend, &ly, &sign_y);
+#else
+    byte    x_extend[sizeof(PolyWord)], y_extend[sizeof(PolyWord)];
+    POLYUNSIGNED lx, ly;
+    (void)convertToLong(x, x_extend, &lx, &sign_x);
+    (void)convertToLong(y, y_extend, &ly, &sign_y);
+#endif
+    // Check for zero args.
+    if (lx == 0 || ly == 0) return taskData->saveVec.push(TAGGED(0));
+
+#if USE_GMP
+    unsigned levels = parallelMulLevels(lx < ly ? lx : ly);
+    Handle z = alloc_and_save(taskData, WORDS((lx+ly)*sizeof(mp_limb_t)), F_MUTABLE_BIT|F_BYTE_OBJ);
+    ArbWorkArea work(taskData, levels == 0 ? 0 : parallelMulScratch(lx, ly, levels));
+    mp_limb_t *w = DEREFLIMBHANDLE(z);
+    mp_limb_t *u = IS_INT(DEREFWORD(x)) ? &x_extend : DEREFLIMBHANDLE(x);
+    mp_limb_t *v = IS_INT(DEREFWORD(y)) ? &y_extend : DEREFLIMBHANDLE(y);
+
+    if (levels == 0 || ! parallelMultiply(w, u, lx, v, ly, work.Address(), levels))
+    {
+        // The first argument must be the longer.
+        if (lx < ly) mpn_mul(w, v, ly, u, lx);
+        else mpn_mul(w, u, lx, v, ly);
     }
-} /* div_unsigned_long */
+
+    return make_canonical(taskData, z, sign_x ^ sign_y);
+#else
+    // Make u the longer.
+    bool swap = lx < ly;
+    POLYUNSIGNED lu = swap ? ly : lx, lv = swap ? lx : ly;
+    size_t du = DIGITS(lu), dv = DIGITS(lv);
+    unsigned levels = parallelMulLevels(dv);
+    size_t scratch = digitsMulScratch(du, dv);
+    if (levels != 0) scratch = maxSize(scratch, parallelMulScratch(du, dv, levels));
+    /* Get space for the result and the work area. */
+    Handle long_z = alloc_and_save(taskData, WORDS(lx+ly), F_MUTABLE_BIT|F_BYTE_OBJ);
+    ArbWorkArea work(taskData, du + dv + du + dv + scratch);
+
+    /* Can now load the actual addresses because they will not change now. */
+    byte *xb = IS_INT(DEREFWORD(x)) ? x_extend : DEREFBYTEHANDLE(x);
+    byte *yb = IS_INT(DEREFWORD(y)) ? y_extend : DEREFBYTEHANDLE(y);
+    arbDigit *u = work.Address(), *v = u+du, *w = v+dv;
+    digitsFromBytes(u, du, swap ? yb : xb, lu);
+    digitsFromBytes(v, dv, swap ? xb : yb, lv);
+    if (levels == 0 || ! parallelMultiply(w, u, du, v, dv, w+du+dv, levels))
+        digitsMul(w, u, du, v, dv, w+du+dv);
+    bytesFromDigits(DEREFBYTEHANDLE(long_z), lx+ly, w);
+
+    return make_canonical(taskData, long_z, sign_x ^ sign_y);
 #endif
+} /* mult_long */
 
 // Common code for div and mod.  Returns handles to the results.
 static void quotRem(TaskData *taskData, Handle y, Handle x, Handle &remHandle, Handle &divHandle)
@@ -1154,26 +1952,19 @@ static void quotRem(TaskData *taskData, Handle y, Handle x, Handle &remHandle, H
         return;
     }
 
-    /* copy in case it needs shifting */
-    Handle longCopyHndl = alloc_and_save(taskData, WORDS(ly), F_BYTE_OBJ | F_MUTABLE_BIT);
-    byte *u = IS_INT(DEREFWORD(y)) ? y_extend : DEREFBYTEHANDLE(y);
-    memcpy(DEREFBYTEHANDLE(longCopyHndl), u, ly);
-
+    size_t du = DIGITS(lx), dv = DIGITS(ly);
     Handle divRes = alloc_and_save(taskData, WORDS(lx-ly+1), F_MUTABLE_BIT|F_BYTE_OBJ);
-    Handle remRes = alloc_and_save(taskData, WORDS(lx+1), F_MUTABLE_BIT|F_BYTE_OBJ);
-
-    byte *long_x = IS_INT(DEREFWORD(x)) ? x_extend : DEREFBYTEHANDLE(x);
-    div_unsigned_long
-        (long_x,
-        DEREFBYTEHANDLE(longCopyHndl),
-        DEREFBYTEHANDLE(remRes), DEREFBYTEHANDLE(divRes),
-        lx, ly);
-
-    /* Clear the rest */
-    for(POLYUNSIGNED i=ly; i < lx+1; i++)
-    {
-        DEREFBYTEHANDLE(remRes)[i] = 0;
-    }
+    Handle remRes = alloc_and_save(taskData, WORDS(ly), F_MUTABLE_BIT|F_BYTE_OBJ);
+    ArbWorkArea work(taskData, du + dv + (du-dv+1) + dv + digitsDivScratch(du, dv));
+
+    byte *xb = IS_INT(DEREFWORD(x)) ? x_extend : DEREFBYTEHANDLE(x);
+    byte *yb = IS_INT(DEREFWORD(y)) ? y_extend : DEREFBYTEHANDLE(y);
+    arbDigit *u = work.Address(), *v = u+du, *quotient = v+dv, *remainder = quotient+du-dv+1;
+    digitsFromBytes(u, du, xb, lx);
+    digitsFromBytes(v, dv, yb, ly);
+    digitsDivRem(quotient, remainder, u, du, v, dv, remainder+dv);
+    bytesFromDigits(DEREFBYTEHANDLE(divRes), lx-ly+1, quotient);
+    bytesFromDigits(DEREFBYTEHANDLE(remRes), ly, remainder);
 
     remHandle = make_canonical(taskData, remRes, sign_x /* Same sign as dividend */ );
     divHandle = make_canonical(taskData, divRes, sign_x ^ sign_y);
@@ -1196,6 +1987,376 @@ Handle rem_longc(TaskData *taskData, Handle y, Handle x)
     return remHandle;
 }
 
+/*
+Fused operations.  These are equivalent to combinations of the operations
+above but keep the intermediate values in a work area so that only the final
+result is allocated on the heap.
+*/
+// r is the remainder, with length lm, after truncating division by m and sign is
+// the sign it should have.  Adjusts it to the result of "mod" which has the sign
+// of the divisor, signM, and returns the sign of the result.
+static int floorRemainder(arbLimb *r, const arbLimb *m, size_t lm, int sign, int signM)
+{
+    if (limbsLength(r, lm) == 0 || sign == signM) return sign;
+    limbsSub(r, m, lm, r, lm);
+    return signM;
+}
+
+// (a*b) mod m
+static Handle mulmod_arbitrary(TaskData *taskData, Handle a, Handle b, Handle m)
+{
+    size_t la = limbsOf(a), lb = limbsOf(b), lm = limbsOf(m);
+    if (lm == 0) raise_exception0(taskData, EXC_divide);
+    if (la == 0 || lb == 0) return taskData->saveVec.push(TAGGED(0));
+    size_t lp = la+lb, lq = lp >= lm ? lp-lm+1 : 1;
+    size_t scratch = maxSize(limbsMulScratch(la, lb), lp >= lm ? limbsDivScratch(lp, lm) : 0);
+    ArbWorkArea work(taskData, la + lb + lm + lp + lq + lm + scratch);
+
+    arbLimb *u = work.Address(), *v = u+la, *mod = v+lb, *p = mod+lm, *q = p+lp, *r = q+lq, *s = r+lm;
+    int sign = loadLimbs(a, u, la) ^ loadLimbs(b, v, lb);
+    int signM = loadLimbs(m, mod, lm);
+    limbsMul(p, u, la, v, lb, s);
+    if (lp >= lm) limbsDivRem(q, r, p, lp, mod, lm, s);
+    else
+    {
+        memcpy(r, p, lp*sizeof(arbLimb));
+        memset(r+lp, 0, (lm-lp)*sizeof(arbLimb));
+    }
+    sign = floorRemainder(r, mod, lm, sign, signM);
+    return storeLimbs(taskData, work, r-u, lm, sign);
+}
+
+// w = u*v mod m.  t has 2*lm limbs and q has lm+1 limbs.  w may be the same as u or v.
+static void limbsMulMod(arbLimb *w, const arbLimb *u, const arbLimb *v, const arbLimb *m, size_t lm,
+                        arbLimb *t, arbLimb *q, arbLimb *scratch)
+{
+    limbsMul(t, u, lm, v, lm, scratch);
+    limbsDivRem(q, w, t, 2*lm, m, lm, scratch);
+}
+
+static inline unsigned limbsBit(const arbLimb *u, size_t i)
+{
+    return (unsigned)(u[i / LIMB_BITS] >> (i % LIMB_BITS)) & 1;
+}
+
+// (b^e) mod m.  e must not be negative.
+static Handle powmod_arbitrary(TaskData *taskData, Handle b, Handle e, Handle m)
+{
+    size_t lb = limbsOf(b), le = limbsOf(e), lm = limbsOf(m);
+    if (lm == 0) raise_exception0(taskData, EXC_divide);
+    // Left-to-right exponentiation with a sliding window of up to "window" bits.
+    // The table holds the odd powers of the base up to 2^window-1.
+    size_t maxBits = le*LIMB_BITS;
+    unsigned window = maxBits > 1024 ? 5 : maxBits > 256 ? 4 : maxBits > 32 ? 3 : 1;
+    size_t tableSize = (size_t)1 << (window-1);
+    size_t lq = maxSize(lm+1, lb >= lm ? lb-lm+1 : 1);
+    size_t scratch = maxSize(limbsMulScratch(lm, lm), maxSize(limbsDivScratch(2*lm, lm), lb >= lm ? limbsDivScratch(lb, lm) : 0));
+    ArbWorkArea work(taskData, lb + le + lm + tableSize*lm + lm + lm + 2*lm + lq + scratch);
+
+    arbLimb *base = work.Address(), *exp = base+lb, *mod = exp+le, *table = mod+lm;
+    arbLimb *x2 = table+tableSize*lm, *r = x2+lm, *t = r+lm, *q = t+2*lm, *s = q+lq;
+    int signB = loadLimbs(b, base, lb);
+    (void)loadLimbs(e, exp, le);
+    int signM = loadLimbs(m, mod, lm);
+    // The result is negative before it is adjusted if b is negative and e is odd.
+    int sign = le != 0 && (exp[0] & 1) ? signB : 0;
+
+    // table[0] = abs b mod abs m.
+    if (lb >= lm) limbsDivRem(q, table, base, lb, mod, lm, s);
+    else
+    {
+        memcpy(table, base, lb*sizeof(arbLimb));
+        memset(table+lb, 0, (lm-lb)*sizeof(arbLimb));
+    }
+    if (tableSize > 1)
+    {
+        limbsMulMod(x2, table, table, mod, lm, t, q, s);
+        for (size_t i = 1; i < tableSize; i++)
+            limbsMulMod(table+i*lm, table+(i-1)*lm, x2, mod, lm, t, q, s);
+    }
+    // r = 1 mod abs m.
+    memset(r, 0, lm*sizeof(arbLimb));
+    r[0] = 1;
+    if (lm == 1 && mod[0] == 1) r[0] = 0;
+
+    size_t bits = maxBits;
+    while (bits > 0 && limbsBit(exp, bits-1) == 0) bits--;
+    bool first = true;
+    for (size_t i = bits; i > 0; )
+    {
+        if (limbsBit(exp, i-1) == 0)
+        {
+            limbsMulMod(r, r, r, mod, lm, t, q, s);
+            i--;
+            continue;
+        }
+        // Find the longest window ending in a one bit.
+        size_t low = i > window ? i-window : 0;
+        while (limbsBit(exp, low) == 0) low++;
+        size_t value = 0;
+        for (size_t j = i; j-- > low; )
+        {
+            value = value*2 + limbsBit(exp, j);
+            if (! first) limbsMulMod(r, r, r, mod, lm, t, q, s);
+        }
+        if (first) memcpy(r, table+(value/2)*lm, lm*sizeof(arbLimb));
+        else limbsMulMod(r, r, table+(value/2)*lm, mod, lm, t, q, s);
+        first = false;
+        i = low;
+    }
+    sign = floorRemainder(r, mod, lm, sign, signM);
+    return storeLimbs(taskData, work, r-base, lm, sign);
+}
+
+// a + b*c
+static Handle addmul_arbitrary(TaskData *taskData, Handle a, Handle b, Handle c)
+{
+    size_t la = limbsOf(a), lb = limbsOf(b), lc = limbsOf(c);
+    if (lb == 0 || lc == 0) return a;
+    size_t lp = lb+lc, lr = maxSize(la, lp)+1;
+    ArbWorkArea work(taskData, la + lb + lc + lp + lr + limbsMulScratch(lb, lc));
+
+    arbLimb *u = work.Address(), *v = u+la, *w = v+lb, *p = w+lc, *r = p+lp, *s = r+lr;
+    int signA = loadLimbs(a, u, la);
+    int signP = loadLimbs(b, v, lb) ^ loadLimbs(c, w, lc);
+    limbsMul(p, v, lb, w, lc, s);
+    lp = limbsLength(p, lp);
+    memset(r, 0, lr*sizeof(arbLimb));
+    int sign;
+    if (signA == signP)
+    {
+        sign = signA;
+        if (la >= lp) r[la] = limbsAdd(r, u, la, p, lp);
+        else r[lp] = limbsAdd(r, p, lp, u, la);
+    }
+    else if (limbsCompare(u, la, p, lp) >= 0)
+    {
+        sign = signA;
+        limbsSub(r, u, la, p, lp);
+    }
+    else
+    {
+        sign = signP;
+        limbsSub(r, p, lp, u, la);
+    }
+    return storeLimbs(taskData, work, r-u, lr, sign);
+}
+
+// The quotient rounded towards minus infinity and the remainder with the sign
+// of the divisor, as for "div" and "mod".
+static void divmod_arbitrary(TaskData *taskData, Handle x, Handle y, Handle &divHandle, Handle &modHandle)
+{
+    size_t lx = limbsOf(x), ly = limbsOf(y);
+    if (ly == 0) raise_exception0(taskData, EXC_divide);
+    // One extra limb in the quotient in case it is increased.
+    size_t lq = (lx >= ly ? lx-ly+1 : 1) + 1;
+    ArbWorkArea work(taskData, lx + ly + lq + ly + limbsDivScratch(lx, ly));
+
+    arbLimb *u = work.Address(), *v = u+lx, *q = v+ly, *r = q+lq, *s = r+ly;
+    int signX = loadLimbs(x, u, lx);
+    int signY = loadLimbs(y, v, ly);
+    memset(q, 0, lq*sizeof(arbLimb));
+    if (lx >= ly) limbsDivRem(q, r, u, lx, v, ly, s);
+    else
+    {
+        memcpy(r, u, lx*sizeof(arbLimb));
+        memset(r+lx, 0, (ly-lx)*sizeof(arbLimb));
+    }
+    int signR = floorRemainder(r, v, ly, signX, signY);
+    if (signR != signX)
+    {
+        // The remainder was adjusted so the magnitude of the (negative) quotient increases.
+        arbLimb one = 1;
+        limbsAdd(q, q, lq, &one, 1);
+    }
+    size_t offsetQ = q-u, offsetR = r-u;
+    divHandle = storeLimbs(taskData, work, offsetQ, lq, signX ^ signY);
+    modHandle = storeLimbs(taskData, work, offsetR, ly, signR);
+}
+
+/*
+Conversion to a string.  With GMP this uses mpn_get_str, which uses a
+sub-quadratic method for long numbers.  The fall-back code converts the number
+by dividing it by a power of the radix, with about half its length, and then
+converting the quotient and the remainder recursively.  Short numbers are
+converted by repeatedly dividing by the largest power of the radix that fits
+in a digit.  Power-of-two radices just extract the bits.
+*/
+static const char arbDigitChars[] = "0123456789ABCDEF";
+
+// Upper bound on the number of characters needed for n limbs.
+static size_t maxCharsForLimbs(size_t n, unsigned radix)
+{
+    size_t bits = n*LIMB_BITS;
+    switch (radix)
+    {
+    case 2: return bits;
+    case 8: return (bits+2)/3;
+    case 16: return (bits+3)/4;
+    default: return (size_t)((double)bits * 0.30103) + 2; // log10(2) rounded up
+    }
+}
+
+#ifndef USE_GMP
+#ifndef TOSTRING_THRESHOLD
+#define TOSTRING_THRESHOLD      30
+#endif
+
+// The powers big^(2^j) of the largest power of the radix that fits in a digit.
+#define TOSTRING_MAX_POWERS     (8*sizeof(size_t))
+
+typedef struct {
+    unsigned radix, chunkChars; // big = radix^chunkChars
+    arbDigit big;
+    arbDigit *power[TOSTRING_MAX_POWERS];
+    size_t length[TOSTRING_MAX_POWERS];
+    unsigned nPowers;
+} ToStringPowers;
+
+// The work area needed for the recursive conversion of a number of n digits.
+static size_t digitsToCharsScratch(size_t n)
+{
+    if (n < TOSTRING_THRESHOLD) return 0;
+    size_t divScratch = 3*n + 2 + maxSize(digitsReciprocalScratch(n), 2*n + 2 + digitsMulScratch(n+1, n+1));
+    return n + 1 + maxSize(divScratch, digitsToCharsScratch(3*n/4 + 2));
+}
+
+// Write exactly "width" characters for u, with leading zeros.  u is overwritten.
+static void digitsToCharsBasecase(char *out, size_t width, arbDigit *u, size_t lu, const ToStringPowers &pw)
+{
+    char *p = out + width;
+    lu = digitsLength(u, lu);
+    while (lu != 0 && p > out)
+    {
+        arbDigit r = digitsDivRem1(u, u, lu, pw.big);
+        lu = digitsLength(u, lu);
+        for (unsigned i = 0; i < pw.chunkChars && p > out; i++)
+        {
+            *--p = arbDigitChars[r % pw.radix];
+            r /= pw.radix;
+        }
+    }
+    memset(out, '0', p - out);
+}
+
+static void digitsToChars(char *out, size_t width, arbDigit *u, size_t lu, const ToStringPowers &pw, arbDigit *work)
+{
+    lu = digitsLength(u, lu);
+    if (lu < TOSTRING_THRESHOLD)
+    {
+        digitsToCharsBasecase(out, width, u, lu, pw);
+        return;
+    }
+    // Divide by the largest power with no more than half the digits.
+    unsigned j = 0;
+    while (j+1 < pw.nPowers && 2*pw.length[j+1] <= lu) j++;
+    size_t lp = pw.length[j], lq = lu-lp+1;
+    arbDigit *q = work, *r = q+lq, *next = r+lp;
+    digitsDivRem(q, r, u, lu, pw.power[j], lp, next);
+    size_t lowWidth = (size_t)pw.chunkChars << j;
+    digitsToChars(out+width-lowWidth, lowWidth, r, lp, pw, next);
+    digitsToChars(out, width-lowWidth, q, lq, pw, next);
+}
+
+// Bits in each character if the radix is a power of two, otherwise zero.
+static unsigned radixBits(unsigned radix)
+{
+    return radix == 2 ? 1 : radix == 8 ? 3 : radix == 16 ? 4 : 0;
+}
+
+// The work area needed to convert n limbs after the number itself.
+static size_t limbsToCharsScratch(size_t n, unsigned radix)
+{
+    if (radixBits(radix) != 0) return 0;
+    // The powers take at most 2n+TOSTRING_MAX_POWERS digits.  The scratch area is
+    // also used when they are computed.
+    return 2*n + TOSTRING_MAX_POWERS + maxSize(digitsToCharsScratch(n), digitsMulScratch(n, n));
+}
+
+// Write the characters for u into out which has space for width characters.
+// Returns the number of characters which are at the end of the area.
+static size_t limbsToChars(char *out, size_t width, arbDigit *u, size_t lu, unsigned radix, arbDigit *work)
+{
+    unsigned bits = radixBits(radix);
+    if (bits != 0)
+    {
+        size_t chars = (lu*DIGIT_BITS + bits - 1) / bits;
+        for (size_t i = 0; i < chars; i++)
+        {
+            size_t bit = i*bits, d = bit / DIGIT_BITS, s = bit % DIGIT_BITS;
+            arbDigit v = u[d] >> s;
+            if (s + bits > DIGIT_BITS && d+1 < lu) v |= u[d+1] << (DIGIT_BITS-s);
+            out[width-1-i] = arbDigitChars[v & (radix-1)];
+        }
+        return chars;
+    }
+    ToStringPowers pw;
+    pw.radix = radix;
+    pw.big = radix;
+    pw.chunkChars = 1;
+    while (pw.big <= ~(arbDigit)0 / radix) { pw.big *= radix; pw.chunkChars++; }
+    // Compute the powers while they are no more than half the length.
+    arbDigit *next = work;
+    pw.power[0] = next;
+    pw.length[0] = 1;
+    *next++ = pw.big;
+    pw.nPowers = 1;
+    while (pw.nPowers < TOSTRING_MAX_POWERS && 4*pw.length[pw.nPowers-1] <= lu)
+    {
+        const arbDigit *p = pw.power[pw.nPowers-1];
+        size_t lp = pw.length[pw.nPowers-1];
+        digitsMul(next, p, lp, p, lp, work + 2*lu + TOSTRING_MAX_POWERS);
+        pw.power[pw.nPowers] = next;
+        pw.length[pw.nPowers] = digitsLength(next, 2*lp);
+        next += pw.length[pw.nPowers];
+        pw.nPowers++;
+    }
+    digitsToChars(out, width, u, lu, pw, work + 2*lu + TOSTRING_MAX_POWERS);
+    return width;
+}
+#else
+static size_t limbsToCharsScratch(size_t, unsigned) { return 0; }
+
+static size_t limbsToChars(char *out, size_t width, mp_limb_t *u, size_t lu, unsigned radix, mp_limb_t *)
+{
+    // mpn_get_str produces the digit values which may have leading zeros.
+    unsigned char *start = (unsigned char *)out;
+    size_t chars = mpn_get_str(start, (int)radix, u, lu);
+    ASSERT(chars <= width);
+    memmove(out + width - chars, start, chars);
+    for (size_t i = width - chars; i < width; i++)
+        out[i] = arbDigitChars[(unsigned char)out[i]];
+    return chars;
+}
+#endif
+
+static Handle toString_arbitrary(TaskData *taskData, Handle radixHandle, Handle x)
+{
+    unsigned radix = get_C_unsigned(taskData, radixHandle->Word());
+    if (radix != 2 && radix != 8 && radix != 10 && radix != 16)
+        raise_exception0(taskData, EXC_size);
+    size_t n = limbsOf(x);
+    if (n == 0) return taskData->saveVec.push(C_string_to_Poly(taskData, "0"));
+    // mpn_get_str requires an extra character.  There is also space for the sign.
+    size_t width = maxCharsForLimbs(n, radix) + 1;
+    Handle result = taskData->saveVec.push(AllocatePolyString(taskData, width+1));
+    ArbWorkArea work(taskData, n + limbsToCharsScratch(n, radix));
+
+    arbLimb *u = work.Address();
+    int sign = loadLimbs(x, u, n);
+    PolyStringObject *str = (PolyStringObject *)DEREFHANDLE(result);
+    char *out = str->chars + 1;
+    size_t chars = limbsToChars(out, width, u, n, radix, u+n);
+    // Remove any leading zeros and add the sign.
+    char *start = out + width - chars;
+    while (*start == '0') start++;
+    size_t length = out + width - start;
+    if (sign < 0) str->chars[0] = '~';
+    memmove(str->chars + (sign < 0 ? 1 : 0), start, length);
+    TruncatePolyString(str, length + (sign < 0 ? 1 : 0));
+    return result;
+}
+
 #if defined(_WIN32)
 // Return a FILETIME from an arbitrary precision number.  On both 32-bit and 64-bit Windows
 // this is a pair of 32-bit values.
@@ -1903,6 +3064,135 @@ POLYUNSIGNED PolyLCMArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSI
     else return result->Word().AsUnsigned();
 }
 
+// Fused operations.  Only the result is allocated on the heap.
+POLYUNSIGNED PolyMultiplyModArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg1 = taskData->saveVec.push(arg1);
+    Handle pushedArg2 = taskData->saveVec.push(arg2);
+    Handle pushedArg3 = taskData->saveVec.push(arg3);
+    Handle result = 0;
+
+    if (profileMode == kProfileEmulation)
+        taskData->addProfileCount(1);
+
+    try {
+        result = mulmod_arbitrary(taskData, pushedArg1, pushedArg2, pushedArg3);
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset); // Ensure the save vec is reset
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+POLYUNSIGNED PolyPowModArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg1 = taskData->saveVec.push(arg1);
+    Handle pushedArg2 = taskData->saveVec.push(arg2);
+    Handle pushedArg3 = taskData->saveVec.push(arg3);
+    Handle result = 0;
+
+    if (profileMode == kProfileEmulation)
+        taskData->addProfileCount(1);
+
+    try {
+        // The exponent is checked in ML.
+        result = powmod_arbitrary(taskData, pushedArg1, pushedArg2, pushedArg3);
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset); // Ensure the save vec is reset
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+POLYUNSIGNED PolyAddMultiplyArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2, POLYUNSIGNED arg3)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg1 = taskData->saveVec.push(arg1);
+    Handle pushedArg2 = taskData->saveVec.push(arg2);
+    Handle pushedArg3 = taskData->saveVec.push(arg3);
+    Handle result = 0;
+
+    if (profileMode == kProfileEmulation)
+        taskData->addProfileCount(1);
+
+    try {
+        result = addmul_arbitrary(taskData, pushedArg1, pushedArg2, pushedArg3);
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset); // Ensure the save vec is reset
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Returns the pair of div and mod.
+POLYUNSIGNED PolyDivModArbitraryPair(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg1 = taskData->saveVec.push(arg1);
+    Handle pushedArg2 = taskData->saveVec.push(arg2);
+    Handle result = 0;
+
+    if (profileMode == kProfileEmulation)
+        taskData->addProfileCount(1);
+
+    try {
+        Handle divHandle, modHandle;
+        divmod_arbitrary(taskData, pushedArg1, pushedArg2, divHandle, modHandle);
+
+        result = alloc_and_save(taskData, 2);
+
+        result->WordP()->Set(0, divHandle->Word());
+        result->WordP()->Set(1, modHandle->Word());
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset); // Ensure the save vec is reset
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Convert to a string in the given radix.  arg1 is the radix.
+POLYUNSIGNED PolyFormatArbitrary(POLYUNSIGNED threadId, POLYUNSIGNED arg1, POLYUNSIGNED arg2)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg1 = taskData->saveVec.push(arg1);
+    Handle pushedArg2 = taskData->saveVec.push(arg2);
+    Handle result = 0;
+
+    if (profileMode == kProfileEmulation)
+        taskData->addProfileCount(1);
+
+    try {
+        result = toString_arbitrary(taskData, pushedArg1, pushedArg2);
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset); // Ensure the save vec is reset
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 // Extract the low order part of an arbitrary precision value as a boxed LargeWord.word
 // value.  If the value is negative it is treated as a twos complement value.
 // This is used Word.fromLargeInt and LargeWord.fromLargeInt with long-form
@@ -2260,6 +3550,11 @@ struct _entrypts arbitraryPrecisionEPT[] =
     { "PolyCompareArbitrary",           (polyRTSFunction)&PolyCompareArbitrary},
     { "PolyGCDArbitrary",               (polyRTSFunction)&PolyGCDArbitrary},
     { "PolyLCMArbitrary",               (polyRTSFunction)&PolyLCMArbitrary},
+    { "PolyMultiplyModArbitrary",       (polyRTSFunction)&PolyMultiplyModArbitrary},
+    { "PolyPowModArbitrary",            (polyRTSFunction)&PolyPowModArbitrary},
+    { "PolyAddMultiplyArbitrary",       (polyRTSFunction)&PolyAddMultiplyArbitrary},
+    { "PolyDivModArbitraryPair",        (polyRTSFunction)&PolyDivModArbitraryPair},
+    { "PolyFormatArbitrary",            (polyRTSFunction)&PolyFormatArbitrary},
     { "PolyGetLowOrderAsLargeWord",     (polyRTSFunction)&PolyGetLowOrderAsLargeWord},
     { "PolyOrArbitrary",                (polyRTSFunction)&PolyOrArbitrary},
     { "PolyAndArbitrary",               (polyRTSFunction)&PolyAndArbitrary},
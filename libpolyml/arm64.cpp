@@ -158,6 +158,8 @@ public:
 
     virtual void addProfileCount(POLYUNSIGNED words) { addSynchronousCount((POLYCODEPTR)assemblyInterface.entryPoint, words); }
 
+    virtual POLYCODEPTR GetProfileSite(stackItem*& sp) { sp = assemblyInterface.stackPtr; return (POLYCODEPTR)assemblyInterface.entryPoint; }
+
     // PreRTSCall: After calling from ML to the RTS we need to save the current heap pointer
     virtual void PreRTSCall(void) { TaskData::PreRTSCall();  SaveMemRegisters(); }
     // PostRTSCall: Before returning we need to restore the heap pointer.
@@ -817,6 +819,7 @@ void Arm64TaskData::SetMemRegisters()
         allocPointer -= allocWords; // Now allocate
         // Set the allocation register to this area. N.B.  This is an absolute address.
         assemblyInterface.registers[allocReg].codeAddr = (POLYCODEPTR)(allocPointer + 1); /* remember: it's off-by-one */
+        allocationSampleCheck(this, (PolyObject*)(allocPointer + 1), allocWords);
         allocWords = 0;
     }
 
@@ -829,7 +832,9 @@ void Arm64TaskData::SetMemRegisters()
     if (allocPointer == 0) allocPointer += MAX_OBJECT_SIZE;
     if (allocLimit == 0) allocLimit += MAX_OBJECT_SIZE;
 
-    assemblyInterface.localMbottom = allocLimit + 1;
+    // If we are sampling allocations the limit may be set so that we trap
+    // at the next sample.
+    assemblyInterface.localMbottom = allocationSampleLimit(this) + 1;
     assemblyInterface.localMpointer = allocPointer + 1;
     // If we are profiling store allocation we set mem_hl so that a trap
     // will be generated.
@@ -848,6 +853,7 @@ void Arm64TaskData::SaveMemRegisters()
         assemblyInterface.entryPoint = assemblyInterface.linkRegister;
         allocPointer = assemblyInterface.localMpointer - 1;
     }
+    allocationSampleAccount(this);
     allocWords = 0;
     assemblyInterface.exceptionPacket = TAGGED(0);
     saveRegisterMask = 0;
@@ -1007,7 +1013,7 @@ bool Arm64TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace* space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp);
             return true;
         }
     }
@@ -1019,7 +1025,7 @@ bool Arm64TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace* space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp+1);
             return true;
         }
     }
@@ -1034,7 +1040,7 @@ bool Arm64TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace* space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp+1);
             return true;
         }
     }
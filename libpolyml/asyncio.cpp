@@ -0,0 +1,686 @@
+/*
+    Title:      Asynchronous file IO.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/*
+This module allows reads and writes at explicit positions in a file to be
+started by one ML thread and collected later.  The normal IO functions in
+basicio.cpp block the calling ML thread until the operation is complete and
+regular files are always "ready" so waiting with poll or select does not help.
+
+On Linux, if the kernel supports it, requests are submitted to an io_uring
+and the results are collected by a separate thread.  Otherwise they are
+passed to a small pool of worker threads that use pread and pwrite.  In
+either case the data are transferred through a buffer allocated with malloc
+because the ML heap may be garbage-collected while the operation is in
+progress.  The request is returned to ML as a volatile word and remains
+allocated until the result has been collected with PolyAsyncIOWait.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_WIN32)
+#include "winconfig.h"
+#else
+#error "No configuration file"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#include "globals.h"
+#include "asyncio.h"
+#include "run_time.h"
+#include "arb.h"
+#include "processes.h"
+#include "polystring.h"
+#include "save_vec.h"
+#include "rts_module.h"
+#include "locking.h"
+#include "diagnostics.h"
+#include "rtsentry.h"
+
+#if (!defined(_WIN32))
+#include "io_internal.h"
+#endif
+
+// Use io_uring if we have the header and the system calls.  We use the
+// system calls directly rather than requiring liburing.
+#if (defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+     defined(HAVE_SYS_MMAN_H) && defined(__GNUC__))
+#define USE_IO_URING 1
+#endif
+
+extern "C" {
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAsyncIOStartRead(POLYUNSIGNED threadId, POLYUNSIGNED strm, POLYUNSIGNED pos, POLYUNSIGNED len);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAsyncIOStartWrite(POLYUNSIGNED threadId, POLYUNSIGNED strm, POLYUNSIGNED pos, POLYUNSIGNED args);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAsyncIOWait(POLYUNSIGNED threadId, POLYUNSIGNED token);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAsyncIOIsComplete(POLYUNSIGNED threadId, POLYUNSIGNED token);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyAsyncIOBackend(POLYUNSIGNED threadId);
+}
+
+#if (!defined(_WIN32))
+
+// Number of threads in the fall-back worker pool.  Requests are usually
+// to regular files so there is little to be gained by having many threads.
+#define ASYNC_WORKER_THREADS    4
+// Number of entries in the submission queue if we use io_uring.
+#define ASYNC_URING_ENTRIES     256
+
+class AsyncIORequest
+{
+public:
+    AsyncIORequest(): fd(-1), isWrite(false), offset(0), buffer(0), length(0),
+        result(0), error(0), complete(false), next(0) {}
+    ~AsyncIORequest() { free(buffer); }
+
+    int fd;
+    bool isWrite;
+    off_t offset;
+    byte *buffer;
+    size_t length;
+    struct iovec iov; // Used by io_uring.
+    ssize_t result;
+    int error;
+    bool complete;
+    PCondVar completed; // Signalled when complete is set.
+    AsyncIORequest *next; // Chains requests queued for the worker threads.
+};
+
+class AsyncIOModule: public RtsModule
+{
+public:
+    AsyncIOModule(): backend(backendNone), initialised(false), terminate(false), canUseWorkers(false),
+        queueHead(0), queueTail(0), workerCount(0) {}
+
+    virtual void Stop(void);
+    virtual void ForkChild(void);
+
+    void Submit(AsyncIORequest *req);
+    void Complete(AsyncIORequest *req, ssize_t result, int error);
+    bool IsComplete(AsyncIORequest *req);
+    void WaitFor(AsyncIORequest *req, unsigned maxMillisecs);
+
+    enum { backendNone = 0, backendThreads = 1, backendIoUring = 2 };
+    int Backend(void) { PLocker l(&ioLock); Initialise(); return backend; }
+
+private:
+    void Initialise(void);
+
+    void StartWorkers(void);
+    void WorkerThread(void);
+    static void *WorkerThreadFunction(void *parameter);
+
+    int backend;
+    bool initialised, terminate, canUseWorkers;
+    PLock ioLock; // Protects all the fields and the "complete" flags in the requests.
+
+    // Worker thread queue.
+    AsyncIORequest *queueHead, *queueTail;
+    PSemaphore workAvailable;
+    unsigned workerCount;
+
+#ifdef USE_IO_URING
+    bool InitUring(void);
+    bool SubmitUring(AsyncIORequest *req);
+    void CompletionThread(void);
+    static void *CompletionThreadFunction(void *parameter);
+
+    int ringFd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray, sqEntries;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+#endif
+};
+
+// Set up the backend the first time it's needed.  This avoids creating
+// threads in programs that do not use this.  Must be called with ioLock held.
+void AsyncIOModule::Initialise(void)
+{
+    if (initialised) return;
+    initialised = true;
+    // The worker threads are also used with io_uring if the submission queue is full.
+    canUseWorkers = workAvailable.Init(0, 0x7fffffff);
+#ifdef USE_IO_URING
+    if (InitUring())
+    {
+        backend = backendIoUring;
+        return;
+    }
+#endif
+    backend = canUseWorkers ? backendThreads : backendNone;
+}
+
+void AsyncIOModule::Submit(AsyncIORequest *req)
+{
+    PLocker l(&ioLock);
+    Initialise();
+#ifdef USE_IO_URING
+    // If the submission queue is full we use the worker threads for this request.
+    if (backend == backendIoUring && SubmitUring(req))
+        return;
+#endif
+    if (workerCount == 0 && canUseWorkers) StartWorkers();
+    if (workerCount == 0)
+    {
+        // No asynchronous support: do the operation now.
+        ssize_t res = req->isWrite ?
+            pwrite(req->fd, req->buffer, req->length, req->offset) :
+            pread(req->fd, req->buffer, req->length, req->offset);
+        req->result = res;
+        req->error = res < 0 ? errno : 0;
+        req->complete = true;
+        return;
+    }
+    if (queueTail == 0) queueHead = req; else queueTail->next = req;
+    queueTail = req;
+    workAvailable.Signal();
+}
+
+// Called by the worker or completion thread when the operation has finished.
+void AsyncIOModule::Complete(AsyncIORequest *req, ssize_t result, int error)
+{
+    PLocker l(&ioLock);
+    req->result = result;
+    req->error = error;
+    req->complete = true;
+    req->completed.Signal();
+}
+
+bool AsyncIOModule::IsComplete(AsyncIORequest *req)
+{
+    PLocker l(&ioLock);
+    return req->complete;
+}
+
+void AsyncIOModule::WaitFor(AsyncIORequest *req, unsigned maxMillisecs)
+{
+    PLocker l(&ioLock);
+    if (! req->complete)
+        req->completed.WaitFor(&ioLock, maxMillisecs);
+}
+
+void AsyncIOModule::StartWorkers(void)
+{
+    for (unsigned i = 0; i < ASYNC_WORKER_THREADS; i++)
+    {
+        // These threads are not joinable.  They are only stopped at the end.
+        pthread_t pthreadId;
+        pthread_attr_t attrs;
+        pthread_attr_init(&attrs);
+        pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+        bool isError = pthread_create(&pthreadId, &attrs, WorkerThreadFunction, this) != 0;
+        pthread_attr_destroy(&attrs);
+        if (isError) break;
+        workerCount++;
+    }
+    if (workerCount == 0)
+    {
+        canUseWorkers = false;
+        if (backend == backendThreads) backend = backendNone;
+    }
+}
+
+void *AsyncIOModule::WorkerThreadFunction(void *parameter)
+{
+    ((AsyncIOModule *)parameter)->WorkerThread();
+    return 0;
+}
+
+void AsyncIOModule::WorkerThread(void)
+{
+    while (true)
+    {
+        workAvailable.Wait();
+        AsyncIORequest *req;
+        {
+            PLocker l(&ioLock);
+            if (terminate) return;
+            req = queueHead;
+            if (req == 0) continue;
+            queueHead = req->next;
+            if (queueHead == 0) queueTail = 0;
+            req->next = 0;
+        }
+        ssize_t res;
+        do {
+            res = req->isWrite ?
+                pwrite(req->fd, req->buffer, req->length, req->offset) :
+                pread(req->fd, req->buffer, req->length, req->offset);
+        } while (res < 0 && errno == EINTR);
+        Complete(req, res, res < 0 ? errno : 0);
+    }
+}
+
+#ifdef USE_IO_URING
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+// Create the ring and the thread that collects the completions.
+// Returns false if io_uring is not available.
+bool AsyncIOModule::InitUring(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = io_uring_setup(ASYNC_URING_ENTRIES, &params);
+    if (ringFd < 0) return false; // Not supported or not permitted.
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && cqSize > sqSize) sqSize = cqSize;
+    byte *sqRing = (byte*)mmap(0, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) { close(ringFd); return false; }
+    byte *cqRing = sqRing;
+    if (! singleMap)
+    {
+        cqRing = (byte*)mmap(0, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { munmap(sqRing, sqSize); close(ringFd); return false; }
+    }
+    sqes = (struct io_uring_sqe *)mmap(0, params.sq_entries * sizeof(struct io_uring_sqe),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        if (! singleMap) munmap(cqRing, cqSize);
+        munmap(sqRing, sqSize); close(ringFd);
+        return false;
+    }
+    sqHead = (unsigned*)(sqRing + params.sq_off.head);
+    sqTail = (unsigned*)(sqRing + params.sq_off.tail);
+    sqMask = (unsigned*)(sqRing + params.sq_off.ring_mask);
+    sqArray = (unsigned*)(sqRing + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    cqHead = (unsigned*)(cqRing + params.cq_off.head);
+    cqTail = (unsigned*)(cqRing + params.cq_off.tail);
+    cqMask = (unsigned*)(cqRing + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)(cqRing + params.cq_off.cqes);
+
+    pthread_t pthreadId;
+    pthread_attr_t attrs;
+    pthread_attr_init(&attrs);
+    pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+    bool isError = pthread_create(&pthreadId, &attrs, CompletionThreadFunction, this) != 0;
+    pthread_attr_destroy(&attrs);
+    if (isError)
+    {
+        // We don't bother to unmap the rings.
+        close(ringFd);
+        return false;
+    }
+    return true;
+}
+
+// Add a request to the submission queue.  Must be called with ioLock held.
+// A null request is used as a NOP to stop the completion thread.
+bool AsyncIOModule::SubmitUring(AsyncIORequest *req)
+{
+    unsigned tail = *sqTail;
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= sqEntries)
+        return false; // Full
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    if (req == 0)
+        sqe->opcode = IORING_OP_NOP;
+    else
+    {
+        req->iov.iov_base = req->buffer;
+        req->iov.iov_len = req->length;
+        sqe->opcode = req->isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = req->fd;
+        sqe->off = req->offset;
+        sqe->addr = (uintptr_t)&req->iov;
+        sqe->len = 1;
+    }
+    sqe->user_data = (uintptr_t)req;
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    int res;
+    do {
+        res = io_uring_enter(ringFd, 1, 0, 0);
+    } while (res < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+    return true;
+}
+
+void *AsyncIOModule::CompletionThreadFunction(void *parameter)
+{
+    ((AsyncIOModule *)parameter)->CompletionThread();
+    return 0;
+}
+
+void AsyncIOModule::CompletionThread(void)
+{
+    while (true)
+    {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            // Nothing there - block until there is at least one completion.
+            (void)io_uring_enter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+            continue;
+        }
+        struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+        AsyncIORequest *req = (AsyncIORequest *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        if (req == 0) return; // Stop request.
+        if (res < 0) Complete(req, -1, -res);
+        else Complete(req, res, 0);
+    }
+}
+#endif
+
+void AsyncIOModule::Stop(void)
+{
+    PLocker l(&ioLock);
+    terminate = true;
+    for (unsigned i = 0; i < workerCount; i++)
+        workAvailable.Signal();
+#ifdef USE_IO_URING
+    if (initialised && backend == backendIoUring)
+        (void)SubmitUring(0);
+#endif
+}
+
+// The threads do not exist in the child so we have to start again if
+// it uses this.  Any outstanding requests are lost.
+void AsyncIOModule::ForkChild(void)
+{
+#ifdef USE_IO_URING
+    if (initialised && backend == backendIoUring)
+        close(ringFd);
+#endif
+    initialised = false;
+    canUseWorkers = false;
+    backend = backendNone;
+    queueHead = queueTail = 0;
+    workerCount = 0;
+}
+
+// Declare this.  It will be automatically added to the table.
+static AsyncIOModule asyncIOModule;
+
+// Wait until the request is complete.
+class WaitAsyncIO: public Waiter
+{
+public:
+    WaitAsyncIO(AsyncIORequest *req): m_req(req) {}
+    virtual void Wait(unsigned maxMillisecs) { asyncIOModule.WaitFor(m_req, maxMillisecs); }
+private:
+    AsyncIORequest *m_req;
+};
+
+// Create a request and return it as a volatile.
+static Handle startRequest(TaskData *taskData, AsyncIORequest *req)
+{
+    Handle token = MakeVolatileWord(taskData, req);
+    asyncIOModule.Submit(req);
+    return token;
+}
+
+static AsyncIORequest *getRequest(TaskData *taskData, Handle token)
+{
+    AsyncIORequest *req = *(AsyncIORequest**)(token->WordP()); // In a Volatile
+    // The token is cleared when the result has been collected and also if
+    // it has been saved and reloaded.
+    if (req == 0) raise_fail(taskData, "Asynchronous IO request no longer valid");
+    return req;
+}
+#endif
+
+// Start reading a block of data.  Returns a token for the request.
+POLYUNSIGNED PolyAsyncIOStartRead(POLYUNSIGNED threadId, POLYUNSIGNED strm, POLYUNSIGNED pos, POLYUNSIGNED len)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle stream = taskData->saveVec.push(strm);
+    Handle result = 0;
+
+    try {
+#if (defined(_WIN32))
+        raise_fail(taskData, "Asynchronous IO is not supported");
+#else
+        int fd = getStreamFileDescriptor(taskData, stream->Word());
+        off_t offset = getPolySigned(taskData, PolyWord::FromUnsigned(pos));
+        size_t length = getPolyUnsigned(taskData, PolyWord::FromUnsigned(len));
+        if (offset < 0) raise_syscall(taskData, "Invalid position", EINVAL);
+        AsyncIORequest *req = new AsyncIORequest;
+        req->fd = fd;
+        req->offset = offset;
+        req->length = length;
+        req->buffer = (byte*)malloc(length == 0 ? 1 : length);
+        if (req->buffer == 0)
+        {
+            delete(req);
+            raise_syscall(taskData, "Insufficient memory", ENOMEM);
+        }
+        result = startRequest(taskData, req);
+#endif
+    }
+    catch (KillException &) {
+        processes->ThreadExit(taskData); // TestAnyEvents may test for kill
+    }
+    catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Start writing a block of data.  The data are copied before this returns so the
+// ML vector or array may be modified immediately.
+// args is a triple of the base vector, the byte offset and the length.
+POLYUNSIGNED PolyAsyncIOStartWrite(POLYUNSIGNED threadId, POLYUNSIGNED strm, POLYUNSIGNED pos, POLYUNSIGNED args)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle stream = taskData->saveVec.push(strm);
+    Handle argsHandle = taskData->saveVec.push(args);
+    Handle result = 0;
+
+    try {
+#if (defined(_WIN32))
+        raise_fail(taskData, "Asynchronous IO is not supported");
+#else
+        int fd = getStreamFileDescriptor(taskData, stream->Word());
+        off_t offset = getPolySigned(taskData, PolyWord::FromUnsigned(pos));
+        POLYUNSIGNED dataOffset = getPolyUnsigned(taskData, DEREFHANDLE(argsHandle)->Get(1));
+        size_t length = getPolyUnsigned(taskData, DEREFHANDLE(argsHandle)->Get(2));
+        if (offset < 0) raise_syscall(taskData, "Invalid position", EINVAL);
+        AsyncIORequest *req = new AsyncIORequest;
+        req->fd = fd;
+        req->isWrite = true;
+        req->offset = offset;
+        req->length = length;
+        req->buffer = (byte*)malloc(length == 0 ? 1 : length);
+        if (req->buffer == 0)
+        {
+            delete(req);
+            raise_syscall(taskData, "Insufficient memory", ENOMEM);
+        }
+        memcpy(req->buffer, DEREFHANDLE(argsHandle)->Get(0).AsObjPtr()->AsBytePtr() + dataOffset, length);
+        result = startRequest(taskData, req);
+#endif
+    }
+    catch (KillException &) {
+        processes->ThreadExit(taskData); // TestAnyEvents may test for kill
+    }
+    catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Wait for a request to complete and return the result.  For a read this is
+// the data read as a vector and for a write it is the number of bytes written.
+// The request is freed and the token cleared so this may only be called once
+// for a request.  If the thread is interrupted while waiting the request
+// remains valid.
+POLYUNSIGNED PolyAsyncIOWait(POLYUNSIGNED threadId, POLYUNSIGNED token)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedToken = taskData->saveVec.push(token);
+    Handle result = 0;
+
+    try {
+#if (defined(_WIN32))
+        raise_fail(taskData, "Asynchronous IO is not supported");
+#else
+        AsyncIORequest *req = getRequest(taskData, pushedToken);
+        while (! asyncIOModule.IsComplete(req))
+        {
+            WaitAsyncIO waiter(req);
+            processes->ThreadPauseForIO(taskData, &waiter);
+        }
+        if (req->result < 0)
+        {
+            int err = req->error;
+            bool isWrite = req->isWrite;
+            *(AsyncIORequest**)(pushedToken->WordP()) = 0;
+            delete(req);
+            raise_syscall(taskData, isWrite ? "Error while writing" : "Error while reading", err);
+        }
+        if (req->isWrite)
+            result = Make_fixed_precision(taskData, req->result);
+        else
+        {
+            // Allocating the result may GC but the request buffer is not in the heap.
+            PolyStringObject *str = AllocatePolyString(taskData, req->result);
+            memcpy(str->chars, req->buffer, req->result);
+            result = taskData->saveVec.push(str);
+        }
+        *(AsyncIORequest**)(pushedToken->WordP()) = 0;
+        delete(req);
+#endif
+    }
+    catch (KillException &) {
+        processes->ThreadExit(taskData); // TestAnyEvents may test for kill
+    }
+    catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Test whether a request has completed without blocking.
+POLYUNSIGNED PolyAsyncIOIsComplete(POLYUNSIGNED threadId, POLYUNSIGNED token)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedToken = taskData->saveVec.push(token);
+    bool isComplete = false;
+
+    try {
+#if (defined(_WIN32))
+        raise_fail(taskData, "Asynchronous IO is not supported");
+#else
+        isComplete = asyncIOModule.IsComplete(getRequest(taskData, pushedToken));
+#endif
+    }
+    catch (KillException &) {
+        processes->ThreadExit(taskData); // TestAnyEvents may test for kill
+    }
+    catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(isComplete ? 1 : 0).AsUnsigned();
+}
+
+// Return the mechanism in use: 0 - none (requests are performed synchronously),
+// 1 - worker threads, 2 - io_uring.
+POLYUNSIGNED PolyAsyncIOBackend(POLYUNSIGNED threadId)
+{
+#if (defined(_WIN32))
+    return TAGGED(0).AsUnsigned();
+#else
+    return TAGGED(asyncIOModule.Backend()).AsUnsigned();
+#endif
+}
+
+struct _entrypts asyncIOEPT[] =
+{
+    { "PolyAsyncIOStartRead",           (polyRTSFunction)&PolyAsyncIOStartRead},
+    { "PolyAsyncIOStartWrite",          (polyRTSFunction)&PolyAsyncIOStartWrite},
+    { "PolyAsyncIOWait",                (polyRTSFunction)&PolyAsyncIOWait},
+    { "PolyAsyncIOIsComplete",          (polyRTSFunction)&PolyAsyncIOIsComplete},
+    { "PolyAsyncIOBackend",             (polyRTSFunction)&PolyAsyncIOBackend},
+
+    { NULL, NULL} // End of list.
+};
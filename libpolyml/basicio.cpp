@@ -89,6 +89,9 @@ DCJM May 2000.
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
 #endif
@@ -153,6 +156,17 @@ DCJM May 2000.
 #define O_ACCMODE   (O_RDONLY|O_RDWR|O_WRONLY)
 #endif
 
+// Maximum size of a single read into a string.
+#define MAX_READ_STRING (1024*1024)
+
+// Maximum number of slices passed to readv or writev.  If there are more
+// than this the call transfers only the first part.
+#ifdef IOV_MAX
+#define MAX_IO_VECTORS  IOV_MAX
+#else
+#define MAX_IO_VECTORS  16
+#endif
+
 #define SAVE(x) taskData->saveVec.push(x)
 
 #ifdef _MSC_VER
@@ -318,6 +332,9 @@ static Handle readString(TaskData *taskData, Handle stream, Handle args, bool/*i
     size_t length = getPolyUnsigned(taskData, DEREFWORD(args));
     // We should check for interrupts even if we're not going to block.
     processes->TestAnyEvents(taskData);
+    // Limit the size of a single read.  The data are read directly into
+    // the result string so this is space on the ML heap.
+    if (length > MAX_READ_STRING) length = MAX_READ_STRING;
 
     while (1) // Loop if interrupted.
     {
@@ -325,28 +342,61 @@ static Handle readString(TaskData *taskData, Handle stream, Handle args, bool/*i
         // These tests may result in a GC if another thread is running.
         waitForAvailableInput(taskData, stream);
 
-        // We can now try to read without blocking.
+        // Allocate the result and read into it.  Previously we read into a
+        // malloced buffer and then copied it into the string.  The allocation
+        // may result in a GC so we must not get the address until after it.
+        Handle result = SAVE(AllocatePolyString(taskData, length));
         int fd = getStreamFileDescriptor(taskData, stream->Word());
-        // We previously allocated the buffer on the stack but that caused
-        // problems with multi-threading at least on Mac OS X because of
-        // stack exhaustion.  We limit the space to 100k. */
-        if (length > 102400) length = 102400;
-        byte *buff = (byte*)malloc(length);
-        if (buff == 0) raise_syscall(taskData, "Unable to allocate buffer", NOMEMORY);
-        ssize_t haveRead = read(fd, buff, length);
+        PolyStringObject *str = (PolyStringObject *)result->WordP();
+        ssize_t haveRead = read(fd, str->chars, length);
         if (haveRead >= 0)
         {
-            Handle result = SAVE(C_string_to_Poly(taskData, (char*)buff, haveRead));
-            free(buff);
+            // Discard any part of the string we haven't used.
+            TruncatePolyString(str, haveRead);
             return result;
         }
-        free(buff);
         // If it failed because it was interrupted keep trying otherwise it's an error.
         if (errno != EINTR)
             raise_syscall(taskData, "Error while reading", ERRORNUMBER);
     }
 }
 
+// Read into a list of array slices with a single call.  Each entry in the list
+// is a triple of the array, the offset and the length as with readArray.
+// Returns the total number of bytes read.
+static Handle readArrayVector(TaskData *taskData, Handle stream, Handle args)
+{
+    processes->TestAnyEvents(taskData);
+
+    while (1) // Loop if interrupted.
+    {
+        waitForAvailableInput(taskData, stream);
+
+        // We can now build the vector.  As with readArray we must not
+        // compute the addresses until after any GC.
+        int fd = getStreamFileDescriptor(taskData, stream->Word());
+        unsigned nVecs = 0;
+        for (PolyWord p = args->Word(); !ML_Cons_Cell::IsNull(p); p = ((ML_Cons_Cell*)p.AsObjPtr())->t)
+            nVecs++;
+        if (nVecs > MAX_IO_VECTORS) nVecs = MAX_IO_VECTORS;
+        struct iovec *iov = (struct iovec *)alloca((nVecs == 0 ? 1 : nVecs) * sizeof(struct iovec));
+        PolyWord p = args->Word();
+        for (unsigned i = 0; i < nVecs; i++, p = ((ML_Cons_Cell*)p.AsObjPtr())->t)
+        {
+            PolyObject *triple = ((ML_Cons_Cell*)p.AsObjPtr())->h.AsObjPtr();
+            byte *base = triple->Get(0).AsObjPtr()->AsBytePtr();
+            POLYUNSIGNED offset = getPolyUnsigned(taskData, triple->Get(1));
+            iov[i].iov_base = base + offset;
+            iov[i].iov_len = getPolyUnsigned(taskData, triple->Get(2));
+        }
+        ssize_t haveRead = readv(fd, iov, nVecs);
+        if (haveRead >= 0)
+            return Make_fixed_precision(taskData, haveRead); // Success.
+        if (errno != EINTR)
+            raise_syscall(taskData, "Error while reading", ERRORNUMBER);
+    }
+}
+
 static Handle writeArray(TaskData *taskData, Handle stream, Handle args, bool/*isText*/)
 {
     /* The isText argument is ignored in both Unix and Windows but
@@ -365,6 +415,31 @@ static Handle writeArray(TaskData *taskData, Handle stream, Handle args, bool/*i
     return Make_fixed_precision(taskData, haveWritten);
 }
 
+// Write from a list of slices with a single call.  Each entry is a triple of
+// the base, offset and length as with writeArray.
+static Handle writeArrayVector(TaskData *taskData, Handle stream, Handle args)
+{
+    int fd = getStreamFileDescriptor(taskData, stream->Word());
+    unsigned nVecs = 0;
+    for (PolyWord p = args->Word(); !ML_Cons_Cell::IsNull(p); p = ((ML_Cons_Cell*)p.AsObjPtr())->t)
+        nVecs++;
+    if (nVecs > MAX_IO_VECTORS) nVecs = MAX_IO_VECTORS;
+    struct iovec *iov = (struct iovec *)alloca((nVecs == 0 ? 1 : nVecs) * sizeof(struct iovec));
+    PolyWord p = args->Word();
+    for (unsigned i = 0; i < nVecs; i++, p = ((ML_Cons_Cell*)p.AsObjPtr())->t)
+    {
+        PolyObject *triple = ((ML_Cons_Cell*)p.AsObjPtr())->h.AsObjPtr();
+        byte *base = triple->Get(0).AsObjPtr()->AsBytePtr();
+        POLYUNSIGNED offset = getPolyUnsigned(taskData, triple->Get(1));
+        iov[i].iov_base = base + offset;
+        iov[i].iov_len = getPolyUnsigned(taskData, triple->Get(2));
+    }
+    ssize_t haveWritten = writev(fd, iov, nVecs);
+    if (haveWritten < 0) raise_syscall(taskData, "Error while writing", ERRORNUMBER);
+
+    return Make_fixed_precision(taskData, haveWritten);
+}
+
 // Test whether we can write without blocking.  Returns false if it will block,
 // true if it will not.
 static bool canOutput(TaskData *taskData, Handle stream)
@@ -885,6 +960,12 @@ static Handle IO_dispatch_c(TaskData *taskData, Handle args, Handle strm, Handle
             return wrapFileDescriptor(taskData, ioDesc);
         }
 
+    case 32: /* Read binary into a list of array slices. */
+        return readArrayVector(taskData, strm, args);
+
+    case 33: /* Write from a list of array or vector slices. */
+        return writeArrayVector(taskData, strm, args);
+
 
     /* Directory functions. */
     case 50: /* Open a directory. */
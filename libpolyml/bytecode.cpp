@@ -74,6 +74,7 @@
 #include "scanaddrs.h"
 #include "rtsentry.h"
 #include "bytecode.h"
+#include "bytecodejit.h"
 
 #if (SIZEOF_VOIDP == 8 && !defined(POLYML32IN64))
 #define IS64BITS 1
@@ -83,6 +84,52 @@
 #define arg1    (pc[0] + pc[1]*256)
 #define arg2    (pc[2] + pc[3]*256)
 
+// With GCC and Clang the instructions are dispatched through a table of label
+// addresses ("labels as values") and each instruction jumps directly to the next
+// rather than returning to the switch.  That gives each instruction its own
+// indirect branch which is much easier for the processor to predict.  Other
+// compilers use the switch.  The switch is also used if we are profiling the
+// instructions.
+#if (defined(__GNUC__) && !defined(PROFILEOPCODES) && !defined(NO_THREADED_DISPATCH))
+#define THREADED_DISPATCH 1
+#define CASE(op)        case op: LABEL_##op
+#define DEFAULT_CASE    default: LABEL_unknown
+#define NEXT_INSTR      goto *dispatchTable[*pc++]
+#else
+#define CASE(op)        case op
+#define DEFAULT_CASE    default
+#define NEXT_INSTR      break
+#endif
+
+// The item on the top of the ML stack is held in the local variable "tos" and
+// sp points at the second item.  That saves a load and store on most instructions.
+// Instructions that call into the RTS, allocate memory or transfer control work
+// on the stack in memory.  They save the cached item first with SPILL_TOS and
+// reload it at the end with RELOAD_TOS.  The state in memory must be complete
+// whenever SaveInterpreterState is called.
+#define SPILL_TOS       (*(--sp) = tos)
+#define RELOAD_TOS      (tos = *sp++)
+
+// Enter the native code for pc if it has been compiled.  Function entries and
+// loop heads are counted and compiled once they pass the threshold.  The other
+// places where this is used are the points at which native code returns to the
+// interpreter to execute an instruction that has no template.  See bytecodejit.h.
+#define JIT_ENTER(count) \
+    if (jit != 0) \
+    { \
+        void *native = jit->Lookup(pc, count); \
+        if (native != 0) \
+        { \
+            ByteCodeJitState jitState; \
+            jitState.sp = sp; \
+            jitState.tos = tos; \
+            jitState.stackLimit = stackLimitAddress; \
+            pc = jit->Run(native, &jitState); \
+            sp = jitState.sp; \
+            tos = jitState.tos; \
+        } \
+    }
+
 const PolyWord True = TAGGED(1);
 const PolyWord False = TAGGED(0);
 const PolyWord Zero = TAGGED(0);
@@ -103,7 +150,7 @@ union realdb { double dble; POLYUNSIGNED puns[DOUBLESIZE]; };
 union flt { float fl; int32_t i; };
 
 ByteCodeInterpreter::ByteCodeInterpreter(stackItem** spAddr, stackItem** slAddr) : mixedCode(false),
-    stackPointerAddress(spAddr), stackLimitAddress(slAddr), overflowPacket(0), dividePacket(0)
+    stackPointerAddress(spAddr), stackLimitAddress(slAddr), byteCodeJit(0), overflowPacket(0), dividePacket(0)
 {
 #ifdef PROFILEOPCODES
     memset(frequency, 0, sizeof(frequency));
@@ -114,6 +161,7 @@ ByteCodeInterpreter::ByteCodeInterpreter(stackItem** spAddr, stackItem** slAddr)
 
 ByteCodeInterpreter::~ByteCodeInterpreter()
 {
+    delete byteCodeJit;
 #ifdef PROFILEOPCODES
     OutputDebugStringA("Frequency\n");
     for (unsigned i = 0; i < 256; i++)
@@ -260,6 +308,38 @@ float ByteCodeInterpreter::unboxFloat(PolyWord p)
 
 #endif
 
+// Real arithmetic and comparisons that can be applied to a result that has
+// not yet been put into a box.
+static inline bool isUnboxedRealOperation(byte instr)
+{
+    switch (instr)
+    {
+    case EXTINSTR_realAdd: case EXTINSTR_realSub: case EXTINSTR_realMult: case EXTINSTR_realDiv:
+    case EXTINSTR_realEqual: case EXTINSTR_realLess: case EXTINSTR_realLessEq:
+    case EXTINSTR_realGreater: case EXTINSTR_realGreaterEq:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Apply one of these to v and u.  Returns true if the result is a real,
+// which is put into "real", and false if it is a boolean.
+static inline bool unboxedRealOperation(byte instr, double v, double u, double &real, PolyWord &boolean)
+{
+    switch (instr)
+    {
+    case EXTINSTR_realAdd: real = v + u; return true;
+    case EXTINSTR_realSub: real = v - u; return true;
+    case EXTINSTR_realMult: real = v * u; return true;
+    case EXTINSTR_realDiv: real = v / u; return true;
+    case EXTINSTR_realEqual: boolean = v == u ? True : False; return false;
+    case EXTINSTR_realLess: boolean = v < u ? True : False; return false;
+    case EXTINSTR_realLessEq: boolean = v <= u ? True : False; return false;
+    case EXTINSTR_realGreater: boolean = v > u ? True : False; return false;
+    default: boolean = v >= u ? True : False; return false; // EXTINSTR_realGreaterEq
+    }
+}
 
 static PLock mutexLock;
 
@@ -276,8 +356,83 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
     // it is important that access should be fast.
     POLYCODEPTR     pc;
     stackItem*sp;
+    stackItem       tos; // Cached top of the stack.  See SPILL_TOS.
+    ByteCodeJit     *jit = byteCodeJit;
+
+#ifdef THREADED_DISPATCH
+    // The entries are in opcode order.  This must be updated when an
+    // instruction is added to int_opcodes.h.
+    static const void * const dispatchTable[256] =
+    {
+        /* 00 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_INSTR_jump8, &&LABEL_INSTR_jump8false,
+        /* 04 */ &&LABEL_INSTR_loadMLWord, &&LABEL_INSTR_storeMLWord, &&LABEL_INSTR_alloc_ref, &&LABEL_INSTR_blockMoveWord,
+        /* 08 */ &&LABEL_INSTR_loadUntagged, &&LABEL_INSTR_storeUntagged, &&LABEL_INSTR_case16, &&LABEL_unknown,
+        /* 0c */ &&LABEL_INSTR_call_closure, &&LABEL_INSTR_return_w, &&LABEL_INSTR_stack_containerB, &&LABEL_unknown,
+        /* 10 */ &&LABEL_INSTR_raise_ex, &&LABEL_INSTR_callConstAddr16, &&LABEL_INSTR_callConstAddr8, &&LABEL_INSTR_local_w,
+        /* 14 */ &&LABEL_INSTR_constAddr16_8, &&LABEL_INSTR_constAddr8_8, &&LABEL_INSTR_callLocalB, &&LABEL_INSTR_callConstAddr8_8,
+        /* 18 */ &&LABEL_INSTR_callConstAddr16_8, &&LABEL_INSTR_local_b_b, &&LABEL_INSTR_constAddr16, &&LABEL_INSTR_const_int_w,
+        /* 1c */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_INSTR_jump_back8, &&LABEL_INSTR_return_b,
+        /* 20 */ &&LABEL_INSTR_jump_back16, &&LABEL_INSTR_indirectLocalBB, &&LABEL_INSTR_local_b, &&LABEL_INSTR_indirect_b,
+        /* 24 */ &&LABEL_INSTR_moveToContainerB, &&LABEL_INSTR_set_stack_val_b, &&LABEL_INSTR_reset_b, &&LABEL_INSTR_reset_r_b,
+        /* 28 */ &&LABEL_INSTR_const_int_b, &&LABEL_INSTR_local_0, &&LABEL_INSTR_local_1, &&LABEL_INSTR_local_2,
+        /* 2c */ &&LABEL_INSTR_local_3, &&LABEL_INSTR_local_4, &&LABEL_INSTR_local_5, &&LABEL_INSTR_local_6,
+        /* 30 */ &&LABEL_INSTR_local_7, &&LABEL_INSTR_local_8, &&LABEL_INSTR_local_9, &&LABEL_INSTR_local_10,
+        /* 34 */ &&LABEL_INSTR_local_11, &&LABEL_INSTR_indirect_0, &&LABEL_INSTR_indirect_1, &&LABEL_INSTR_indirect_2,
+        /* 38 */ &&LABEL_INSTR_indirect_3, &&LABEL_INSTR_indirect_4, &&LABEL_INSTR_indirect_5, &&LABEL_INSTR_const_0,
+        /* 3c */ &&LABEL_INSTR_const_1, &&LABEL_INSTR_const_2, &&LABEL_INSTR_const_3, &&LABEL_INSTR_const_4,
+        /* 40 */ &&LABEL_INSTR_const_10, &&LABEL_unknown, &&LABEL_INSTR_return_1, &&LABEL_INSTR_return_2,
+        /* 44 */ &&LABEL_INSTR_return_3, &&LABEL_INSTR_local_12, &&LABEL_INSTR_jump8True, &&LABEL_INSTR_jump16True,
+        /* 48 */ &&LABEL_unknown, &&LABEL_INSTR_local_13, &&LABEL_INSTR_local_14, &&LABEL_INSTR_local_15,
+        /* 4c */ &&LABEL_INSTR_arbAdd, &&LABEL_INSTR_arbSubtract, &&LABEL_INSTR_arbMultiply, &&LABEL_unknown,
+        /* 50 */ &&LABEL_INSTR_reset_1, &&LABEL_INSTR_reset_2, &&LABEL_INSTR_no_op, &&LABEL_unknown,
+        /* 54 */ &&LABEL_INSTR_indirectClosureBB, &&LABEL_INSTR_constAddr8_0, &&LABEL_INSTR_constAddr8_1, &&LABEL_INSTR_callConstAddr8_0,
+        /* 58 */ &&LABEL_INSTR_callConstAddr8_1, &&LABEL_INSTR_jumpNotEqualWord, &&LABEL_INSTR_jumpNotLessSigned, &&LABEL_INSTR_jumpNotLessUnsigned,
+        /* 5c */ &&LABEL_INSTR_jumpNotLessEqSigned, &&LABEL_INSTR_jumpNotLessEqUnsigned, &&LABEL_INSTR_jumpNotGreaterSigned, &&LABEL_INSTR_jumpNotGreaterUnsigned,
+        /* 60 */ &&LABEL_INSTR_jumpNotGreaterEqSigned, &&LABEL_INSTR_jumpNotGreaterEqUnsigned, &&LABEL_INSTR_wordAddConstB, &&LABEL_INSTR_wordSubConstB,
+        /* 64 */ &&LABEL_INSTR_reset_r_1, &&LABEL_INSTR_reset_r_2, &&LABEL_INSTR_reset_r_3, &&LABEL_unknown,
+        /* 68 */ &&LABEL_INSTR_tuple_b, &&LABEL_INSTR_tuple_2, &&LABEL_INSTR_tuple_3, &&LABEL_INSTR_tuple_4,
+        /* 6c */ &&LABEL_INSTR_lock, &&LABEL_INSTR_ldexc, &&LABEL_unknown, &&LABEL_unknown,
+        /* 70 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* 74 */ &&LABEL_INSTR_indirectContainerB, &&LABEL_INSTR_moveToMutClosureB, &&LABEL_INSTR_allocMutClosureB, &&LABEL_INSTR_indirectClosureB0,
+        /* 78 */ &&LABEL_INSTR_push_handler, &&LABEL_unknown, &&LABEL_INSTR_indirectClosureB1, &&LABEL_INSTR_tail_b_b,
+        /* 7c */ &&LABEL_INSTR_indirectClosureB2, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* 80 */ &&LABEL_unknown, &&LABEL_INSTR_setHandler8, &&LABEL_unknown, &&LABEL_INSTR_callFastRTS0,
+        /* 84 */ &&LABEL_INSTR_callFastRTS1, &&LABEL_INSTR_callFastRTS2, &&LABEL_INSTR_callFastRTS3, &&LABEL_INSTR_callFastRTS4,
+        /* 88 */ &&LABEL_INSTR_callFastRTS5, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* 8c */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* 90 */ &&LABEL_unknown, &&LABEL_INSTR_notBoolean, &&LABEL_INSTR_isTagged, &&LABEL_INSTR_cellLength,
+        /* 94 */ &&LABEL_INSTR_cellFlags, &&LABEL_INSTR_clearMutable, &&LABEL_unknown, &&LABEL_INSTR_atomicIncr,
+        /* 98 */ &&LABEL_INSTR_atomicDecr, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* 9c */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* a0 */ &&LABEL_INSTR_equalWord, &&LABEL_unknown, &&LABEL_INSTR_lessSigned, &&LABEL_INSTR_lessUnsigned,
+        /* a4 */ &&LABEL_INSTR_lessEqSigned, &&LABEL_INSTR_lessEqUnsigned, &&LABEL_INSTR_greaterSigned, &&LABEL_INSTR_greaterUnsigned,
+        /* a8 */ &&LABEL_INSTR_greaterEqSigned, &&LABEL_INSTR_greaterEqUnsigned, &&LABEL_INSTR_fixedAdd, &&LABEL_INSTR_fixedSub,
+        /* ac */ &&LABEL_INSTR_fixedMult, &&LABEL_INSTR_fixedQuot, &&LABEL_INSTR_fixedRem, &&LABEL_unknown,
+        /* b0 */ &&LABEL_unknown, &&LABEL_INSTR_wordAdd, &&LABEL_INSTR_wordSub, &&LABEL_INSTR_wordMult,
+        /* b4 */ &&LABEL_INSTR_wordDiv, &&LABEL_INSTR_wordMod, &&LABEL_unknown, &&LABEL_INSTR_wordAnd,
+        /* b8 */ &&LABEL_INSTR_wordOr, &&LABEL_INSTR_wordXor, &&LABEL_INSTR_wordShiftLeft, &&LABEL_INSTR_wordShiftRLog,
+        /* bc */ &&LABEL_unknown, &&LABEL_INSTR_allocByteMem, &&LABEL_unknown, &&LABEL_unknown,
+        /* c0 */ &&LABEL_unknown, &&LABEL_INSTR_indirectLocalB1, &&LABEL_INSTR_isTaggedLocalB, &&LABEL_INSTR_jumpNEqLocalInd,
+        /* c4 */ &&LABEL_INSTR_jumpTaggedLocal, &&LABEL_INSTR_jumpNEqLocal, &&LABEL_INSTR_indirect0Local0, &&LABEL_INSTR_indirectLocalB0,
+        /* c8 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* cc */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* d0 */ &&LABEL_INSTR_closureB, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* d4 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* d8 */ &&LABEL_unknown, &&LABEL_INSTR_getThreadId, &&LABEL_INSTR_allocWordMemory, &&LABEL_unknown,
+        /* dc */ &&LABEL_INSTR_loadMLByte, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* e0 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* e4 */ &&LABEL_INSTR_storeMLByte, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown,
+        /* e8 */ &&LABEL_unknown, &&LABEL_INSTR_enterIntArm64, &&LABEL_unknown, &&LABEL_unknown,
+        /* ec */ &&LABEL_INSTR_blockMoveByte, &&LABEL_INSTR_blockEqualByte, &&LABEL_INSTR_blockCompareByte, &&LABEL_unknown,
+        /* f0 */ &&LABEL_unknown, &&LABEL_INSTR_deleteHandler, &&LABEL_unknown, &&LABEL_unknown,
+        /* f4 */ &&LABEL_unknown, &&LABEL_unknown, &&LABEL_unknown, &&LABEL_INSTR_jump16,
+        /* f8 */ &&LABEL_INSTR_jump16false, &&LABEL_INSTR_setHandler16, &&LABEL_INSTR_constAddr8, &&LABEL_unknown,
+        /* fc */ &&LABEL_INSTR_stackSize16, &&LABEL_unknown, &&LABEL_INSTR_escape, &&LABEL_INSTR_enterIntX86
+    };
+#endif
 
     LoadInterpreterState(pc, sp);
+    tos = *sp++;
 
     // We may have taken an interrupt which has set an exception.
     if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
@@ -285,7 +440,7 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
     for(;;){ /* Each instruction */
 #if (0)
         char buff[1000];
-        sprintf(buff, "addr = %p sp=%p instr=%02x *sp=%p\n", pc, sp, *pc, (*sp).stackAddr);
+        sprintf(buff, "addr = %p sp=%p instr=%02x tos=%p\n", pc, sp, *pc, tos.stackAddr);
         OutputDebugStringA(buff);
 #endif
         // These are temporary values used where one instruction jumps to
@@ -300,95 +455,108 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
 
 #ifdef PROFILEOPCODES
         frequency[*pc]++;
+#endif
+#ifdef THREADED_DISPATCH
+        NEXT_INSTR;
 #endif
         switch(*pc++) {
 
-        case INSTR_jump8false:
+        CASE(INSTR_jump8false):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            RELOAD_TOS;
             if (u == True) pc += 1;
             else pc += *pc + 1;
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_jump8: pc += *pc + 1; break;
+        CASE(INSTR_jump8): pc += *pc + 1; NEXT_INSTR;
 
-        case INSTR_jump8True:
+        CASE(INSTR_jump8True):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            RELOAD_TOS;
             if (u == False) pc += 1;
             else pc += *pc + 1;
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_jump16True:
+        CASE(INSTR_jump16True):
             // Invert the sense of the test and fall through.
-            *sp = ((*sp).w() == True) ? False : True;
+            tos = (tos.w() == True) ? False : True;
 
-        case INSTR_jump16false:
+        CASE(INSTR_jump16false):
         {
-            PolyWord u = *sp++; /* Pop argument */
-            if (u == True) { pc += 2; break; }
+            PolyWord u = tos; /* Pop argument */
+            RELOAD_TOS;
+            if (u == True) { pc += 2; NEXT_INSTR; }
             /* else - false - take the jump */
         }
 
-        case INSTR_jump16:
-            pc += arg1 + 2; break;
+        CASE(INSTR_jump16):
+            pc += arg1 + 2; NEXT_INSTR;
 
-        case INSTR_push_handler: /* Save the old handler value. */
-            (*(--sp)).stackAddr = GetHandlerRegister(); /* Push old handler */
-            break;
+        CASE(INSTR_push_handler): /* Save the old handler value. */
+            SPILL_TOS;
+            tos.stackAddr = GetHandlerRegister(); /* Push old handler */
+            goto JIT_CONTINUE;
 
-        case INSTR_setHandler8: /* Set up a handler */
+        CASE(INSTR_setHandler8): /* Set up a handler */
         {
             POLYCODEPTR entry = pc + *pc + 1; // Address of handler
             // This needs to be aligned for the ARM.  This is only during development.
             while (((uintptr_t)entry & 3) && entry[0] == INSTR_no_op)
                 entry++;
+            // The handler register points into the stack so the entry must be in memory.
+            SPILL_TOS;
             (--sp)->codeAddr = entry;
             SetHandlerRegister(sp);
+            RELOAD_TOS;
             pc += 1;
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_setHandler16: /* Set up a handler */
+        CASE(INSTR_setHandler16): /* Set up a handler */
         {
             POLYCODEPTR entry = pc + arg1 + 2;
             // This needs to be aligned for the ARM.  This is only during development.
             while (((uintptr_t)entry & 3) && entry[0] == INSTR_no_op)
                 entry++;
+            SPILL_TOS;
             (--sp)->codeAddr = entry;
             SetHandlerRegister(sp);
+            RELOAD_TOS;
             pc += 2;
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_deleteHandler: /* Delete handler retaining the result. */
+        CASE(INSTR_deleteHandler): /* Delete handler retaining the result. */
         {
-            stackItem u = *sp++;
             sp = GetHandlerRegister();
             sp++; // Remove handler entry point
-            SetHandlerRegister((*sp).stackAddr); // Restore old handler
-            *sp = u; // Put back the result
-            break;
+            SetHandlerRegister((*sp++).stackAddr); // Restore old handler
+            // The result in tos replaces the old handler.
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_case16:
+        CASE(INSTR_case16):
             {
                 // arg1 is the largest value that is in the range
-                POLYSIGNED u = UNTAGGED(*sp++); /* Get the value */
+                POLYSIGNED u = UNTAGGED(tos); /* Get the value */
+                RELOAD_TOS;
                 if (u >= arg1 || u < 0) pc += 2 + arg1*2; /* Out of range */
                 else {
                     pc += 2;
                     pc += /* Index */pc[u*2]+pc[u*2 + 1]*256; }
-                break;
+                NEXT_INSTR;
             }
 
-        case INSTR_tail_b_b:
+        CASE(INSTR_tail_b_b):
+           SPILL_TOS;
            tailCount = *pc;
            tailPtr = sp + tailCount;
            sp = tailPtr + pc[1];
-       TAIL_CALL: /* For general case. */
+       TAIL_CALL: /* For general case.  The stack is in memory. */
            if (tailCount < 2) Crash("Invalid argument\n");
            numTailArguments = (unsigned)(tailCount - 2);
            for (; tailCount > 0; tailCount--) *(--sp) = *(--tailPtr);
@@ -406,10 +574,10 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
            }
            goto CALL_CLOSURE; /* And drop through. */
 
-        case INSTR_call_closure: /* Closure call. */
+        CASE(INSTR_call_closure): /* Closure call. */
         {
-            closure = (*sp++).w().AsObjPtr();
-            CALL_CLOSURE:
+            closure = tos.w().AsObjPtr();
+            CALL_CLOSURE: /* The stack is in memory. */
             (--sp)->codeAddr = pc; /* Save return address. */
             *(--sp) = (PolyWord)closure;
             if (mixedCode)
@@ -424,55 +592,65 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             goto STACKCHECK;
         }
 
-        case INSTR_callConstAddr8:
+        CASE(INSTR_callConstAddr8):
+            SPILL_TOS;
             closure = (*(PolyWord*)(pc + pc[0] + 1)).AsObjPtr(); pc += 1; goto CALL_CLOSURE;
 
-        case INSTR_callConstAddr16:
+        CASE(INSTR_callConstAddr16):
+            SPILL_TOS;
             closure = (*(PolyWord*)(pc + arg1 + 2)).AsObjPtr(); pc += 2; goto CALL_CLOSURE;
 
-        case INSTR_callConstAddr8_8:
+        CASE(INSTR_callConstAddr8_8):
+            SPILL_TOS;
             closure = ((PolyWord*)(pc + pc[0] + 2))[pc[1] + 3].AsObjPtr(); pc += 2; goto CALL_CLOSURE;
 
-        case INSTR_callConstAddr8_0:
+        CASE(INSTR_callConstAddr8_0):
+            SPILL_TOS;
             closure = ((PolyWord*)(pc + pc[0] + 1))[3].AsObjPtr(); pc += 1; goto CALL_CLOSURE;
 
-        case INSTR_callConstAddr8_1:
+        CASE(INSTR_callConstAddr8_1):
+            SPILL_TOS;
             closure = ((PolyWord*)(pc + pc[0] + 1))[4].AsObjPtr(); pc += 1; goto CALL_CLOSURE;
 
-        case INSTR_callConstAddr16_8:
+        CASE(INSTR_callConstAddr16_8):
+            SPILL_TOS;
             closure = ((PolyWord*)(pc + arg1 + 3))[pc[2] + 3].AsObjPtr(); pc += 3; goto CALL_CLOSURE;
 
-        case INSTR_callLocalB:
+        CASE(INSTR_callLocalB):
         {
+            SPILL_TOS;
             closure = (sp[*pc++]).w().AsObjPtr();
             goto CALL_CLOSURE;
         }
 
-        case INSTR_return_w:
+        CASE(INSTR_return_w):
             returnCount = arg1; /* Get no. of args to remove. */
 
-            RETURN: /* Common code for return. */
+            RETURN: /* Common code for return.  The result is in tos. */
             {
-                stackItem result = *sp++; /* Result */
                 sp++; /* Remove the link/closure */
                 pc = (*sp++).codeAddr; /* Return address */
                 sp += returnCount; /* Add on number of args. */
-                *(--sp) = result; /* Result */
-                SaveInterpreterState(pc, sp); // Update in case we're profiling or if returning
                 if (mixedCode)
+                {
+                    SPILL_TOS;
+                    SaveInterpreterState(pc, sp);
                     return ReturnReturn;
+                }
+                SaveInterpreterState(pc, sp); // Update in case we're profiling
             }
-            break;
+            goto JIT_CONTINUE;
 
-        case INSTR_return_b: returnCount = *pc; goto RETURN;
-        case INSTR_return_1: returnCount = 1; goto RETURN;
-        case INSTR_return_2: returnCount = 2; goto RETURN;
-        case INSTR_return_3: returnCount = 3; goto RETURN;
+        CASE(INSTR_return_b): returnCount = *pc; goto RETURN;
+        CASE(INSTR_return_1): returnCount = 1; goto RETURN;
+        CASE(INSTR_return_2): returnCount = 2; goto RETURN;
+        CASE(INSTR_return_3): returnCount = 3; goto RETURN;
 
-        case INSTR_stackSize16:
+        CASE(INSTR_stackSize16):
         {
+            SPILL_TOS;
             stackCheck = arg1; pc += 2;
-        STACKCHECK:
+        STACKCHECK: /* The stack is in memory. */
             // Check stack space.  This is combined with interrupts on the native code version.
             if (sp - stackCheck < *stackLimitAddress)
             {
@@ -480,249 +658,296 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 HandleStackOverflow(stackCheck);
                 LoadInterpreterState(pc, sp);
             }
-            break;
+            RELOAD_TOS;
+            JIT_ENTER(true);
+            NEXT_INSTR;
         }
 
-        case INSTR_raise_ex:
+        CASE(INSTR_raise_ex):
         {
             {
-                PolyException *exn = (PolyException*)((*sp).w().AsObjPtr());
+                PolyException *exn = (PolyException*)(tos.w().AsObjPtr());
                 taskData->SetException(exn);
             }
         RAISE_EXCEPTION:
+            // This discards the current stack so tos does not need to be saved.
             sp = GetHandlerRegister();
             pc = (*sp++).codeAddr;
             // It is possible we could raise an exception to be
             // handled by native code but that does not currently happen
             // during the bootstrap.
             SetHandlerRegister((*sp++).stackAddr);
-            break;
+            RELOAD_TOS;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_tuple_2: storeWords = 2; goto TUPLE;
-        case INSTR_tuple_3: storeWords = 3; goto TUPLE;
-        case INSTR_tuple_4: storeWords = 4; goto TUPLE;
-        case INSTR_tuple_b: storeWords = *pc; pc++; goto TUPLE;
+        CASE(INSTR_tuple_2): storeWords = 2; SPILL_TOS; goto TUPLE;
+        CASE(INSTR_tuple_3): storeWords = 3; SPILL_TOS; goto TUPLE;
+        CASE(INSTR_tuple_4): storeWords = 4; SPILL_TOS; goto TUPLE;
+        CASE(INSTR_tuple_b):
+        {
+            storeWords = *pc; pc++;
+            SPILL_TOS;
+        TUPLE: /* Common code for tupling.  The stack is in memory. */
+            PolyObject* p = this->allocateMemory(taskData, storeWords, pc, sp);
+            if (p == 0) goto RAISE_EXCEPTION; // Exception
+            p->SetLengthWord(storeWords, 0);
+            for (; storeWords > 0; ) p->Set(--storeWords, *sp++);
+            tos = (PolyWord)p;
+            goto JIT_CONTINUE;
+        }
 
-        case INSTR_closureB:
+        CASE(INSTR_closureB):
+        {
             storeWords = *pc++;
-            goto CREATE_CLOSURE;
-            break;
+            SPILL_TOS;
+        CREATE_CLOSURE: /* The stack is in memory. */
+            // Allocate a closure.  storeWords is the number of non-locals.
+            POLYUNSIGNED length = storeWords + sizeof(uintptr_t) / sizeof(PolyWord);
+            PolyObject* t = this->allocateMemory(taskData, length, pc, sp);
+            if (t == 0) goto RAISE_EXCEPTION;
+            t->SetLengthWord(length, F_CLOSURE_OBJ);
+            for (; storeWords > 0; ) t->Set(--storeWords + sizeof(uintptr_t) / sizeof(PolyWord), *sp++);
+            PolyObject* srcClosure = (*sp++).w().AsObjPtr();
+            *(uintptr_t*)t = *(uintptr_t*)srcClosure;
+            tos = (PolyWord)t;
+            goto JIT_CONTINUE;
+        }
 
-        case INSTR_local_w:
+        CASE(INSTR_local_w):
             {
-                stackItem u = sp[arg1];
-                *(--sp) = u;
+                SPILL_TOS;
+                tos = sp[arg1];
                 pc += 2;
-                break;
+                NEXT_INSTR;
             }
 
-        case INSTR_constAddr8:
-            *(--sp) = *(PolyWord*)(pc + pc[0] + 1); pc += 1; break;
+        CASE(INSTR_constAddr8):
+            SPILL_TOS; tos = *(PolyWord*)(pc + pc[0] + 1); pc += 1; NEXT_INSTR;
 
-        case INSTR_constAddr16:
-            *(--sp) = *(PolyWord*)(pc + arg1 + 2); pc += 2; break;
+        CASE(INSTR_constAddr16):
+            SPILL_TOS; tos = *(PolyWord*)(pc + arg1 + 2); pc += 2; NEXT_INSTR;
 
-        case INSTR_constAddr8_8:
-            *(--sp) = ((PolyWord*)(pc + pc[0]+ 2))[pc[1] + 3]; pc += 2; break;
+        CASE(INSTR_constAddr8_8):
+            SPILL_TOS; tos = ((PolyWord*)(pc + pc[0]+ 2))[pc[1] + 3]; pc += 2; NEXT_INSTR;
 
-        case INSTR_constAddr8_0:
-            *(--sp) = ((PolyWord*)(pc + pc[0] + 1))[3]; pc += 1; break;
+        CASE(INSTR_constAddr8_0):
+            SPILL_TOS; tos = ((PolyWord*)(pc + pc[0] + 1))[3]; pc += 1; NEXT_INSTR;
 
-        case INSTR_constAddr8_1:
-            *(--sp) = ((PolyWord*)(pc + pc[0] + 1))[4]; pc += 1; break;
+        CASE(INSTR_constAddr8_1):
+            SPILL_TOS; tos = ((PolyWord*)(pc + pc[0] + 1))[4]; pc += 1; NEXT_INSTR;
 
-        case INSTR_constAddr16_8:
-            *(--sp) = ((PolyWord*)(pc + arg1 + 3))[pc[2] + 3]; pc += 3; break;
+        CASE(INSTR_constAddr16_8):
+            SPILL_TOS; tos = ((PolyWord*)(pc + arg1 + 3))[pc[2] + 3]; pc += 3; NEXT_INSTR;
 
-        case INSTR_const_int_w: *(--sp) = TAGGED(arg1); pc += 2; break;
+        CASE(INSTR_const_int_w): SPILL_TOS; tos = TAGGED(arg1); pc += 2; NEXT_INSTR;
 
-        case INSTR_jump_back8:
+        CASE(INSTR_jump_back8):
             pc -= *pc + 1;
             // Check for interrupt in case we're in a loop
             if (sp < *stackLimitAddress)
             {
+                SPILL_TOS;
                 SaveInterpreterState(pc, sp);
                 HandleStackOverflow(0);
                 LoadInterpreterState(pc, sp);
+                RELOAD_TOS;
             }
-            break;
+            JIT_ENTER(true);
+            NEXT_INSTR;
 
-        case INSTR_jump_back16:
+        CASE(INSTR_jump_back16):
             pc -= arg1 + 1;
             // Check for interrupt in case we're in a loop
             if (sp < *stackLimitAddress)
             {
+                SPILL_TOS;
                 SaveInterpreterState(pc, sp);
                 HandleStackOverflow(0);
                 LoadInterpreterState(pc, sp);
+                RELOAD_TOS;
             }
-            break;
+            JIT_ENTER(true);
+            NEXT_INSTR;
 
-        case INSTR_lock:
+        CASE(INSTR_lock):
             {
-                PolyObject *obj = (*sp).w().AsObjPtr();
+                PolyObject *obj = tos.w().AsObjPtr();
                 obj->SetLengthWord(obj->LengthWord() & ~_OBJ_MUTABLE_BIT);
-                break;
+                NEXT_INSTR;
             }
 
-        case INSTR_ldexc: *(--sp) = GetExceptionPacket(); break;
+        CASE(INSTR_ldexc): SPILL_TOS; tos = GetExceptionPacket(); goto JIT_CONTINUE;
 
-        case INSTR_local_b: { stackItem u = sp[*pc]; *(--sp) = u; pc += 1; break; }
+        // Pushing a local saves tos first and then the offset is the same as
+        // it would be if the whole stack were in memory.
+        CASE(INSTR_local_b): { SPILL_TOS; tos = sp[*pc]; pc += 1; NEXT_INSTR; }
 
-        case INSTR_indirect_b:
-            *sp = (*sp).w().AsObjPtr()->Get(*pc); pc += 1; break;
+        CASE(INSTR_local_b_b):
+        {
+            // Push two locals.  The second offset is relative to the stack after the first push.
+            SPILL_TOS; tos = sp[pc[0]];
+            SPILL_TOS; tos = sp[pc[1]];
+            pc += 2;
+            NEXT_INSTR;
+        }
 
-        case INSTR_indirectLocalBB:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(*pc++); break; }
+        CASE(INSTR_indirect_b):
+            tos = tos.w().AsObjPtr()->Get(*pc); pc += 1; NEXT_INSTR;
 
-        case INSTR_indirectLocalB0:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(0); break; }
+        CASE(INSTR_indirectLocalBB):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(*pc++); NEXT_INSTR; }
 
-        case INSTR_indirect0Local0:
-        { PolyWord u = sp[0]; *(--sp) = u.AsObjPtr()->Get(0); break; }
+        CASE(INSTR_indirectLocalB0):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(0); NEXT_INSTR; }
 
-        case INSTR_indirectLocalB1:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(1); break; }
+        CASE(INSTR_indirect0Local0):
+        { SPILL_TOS; tos = tos.w().AsObjPtr()->Get(0); NEXT_INSTR; }
 
-        case INSTR_moveToContainerB:
-            { PolyWord u = *sp++; (*sp).stackAddr[*pc] = u; pc += 1; break; }
+        CASE(INSTR_indirectLocalB1):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(1); NEXT_INSTR; }
 
-        case INSTR_moveToMutClosureB:
+        CASE(INSTR_moveToContainerB):
+            { PolyWord u = tos; RELOAD_TOS; tos.stackAddr[*pc] = u; pc += 1; NEXT_INSTR; }
+
+        CASE(INSTR_moveToMutClosureB):
         {
-            PolyWord u = *sp++;
-            (*sp).w().AsObjPtr()->Set(*pc++ + sizeof(uintptr_t) / sizeof(PolyWord), u);
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos.w().AsObjPtr()->Set(*pc++ + sizeof(uintptr_t) / sizeof(PolyWord), u);
+            NEXT_INSTR;
         }
 
-        case INSTR_indirectContainerB:
-            *sp = (*sp).stackAddr[*pc]; pc += 1; break;
+        CASE(INSTR_indirectContainerB):
+            tos = tos.stackAddr[*pc]; pc += 1; NEXT_INSTR;
 
-        case INSTR_indirectClosureBB:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(*pc++ + sizeof(uintptr_t) / sizeof(PolyWord)); break; }
+        CASE(INSTR_indirectClosureBB):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(*pc++ + sizeof(uintptr_t) / sizeof(PolyWord)); NEXT_INSTR; }
 
-        case INSTR_indirectClosureB0:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord)); break; }
+        CASE(INSTR_indirectClosureB0):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord)); NEXT_INSTR; }
 
-        case INSTR_indirectClosureB1:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord) + 1); break; }
+        CASE(INSTR_indirectClosureB1):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord) + 1); NEXT_INSTR; }
 
-        case INSTR_indirectClosureB2:
-        { PolyWord u = sp[*pc++]; *(--sp) = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord) + 2); break; }
+        CASE(INSTR_indirectClosureB2):
+        { SPILL_TOS; PolyWord u = sp[*pc++]; tos = u.AsObjPtr()->Get(sizeof(uintptr_t) / sizeof(PolyWord) + 2); NEXT_INSTR; }
 
-        case INSTR_set_stack_val_b:
-            { PolyWord u = *sp++; sp[*pc-1] = u; pc += 1; break; }
+        CASE(INSTR_set_stack_val_b):
+            // The offset is at least one so the destination is in memory.
+            { sp[*pc-1] = tos; RELOAD_TOS; pc += 1; NEXT_INSTR; }
 
-        case INSTR_reset_b: sp += *pc; pc += 1; break;
+        // The reset counts are always at least one.
+        CASE(INSTR_reset_b): tos = sp[*pc-1]; sp += *pc; pc += 1; NEXT_INSTR;
 
-        case INSTR_reset_r_b:
-            { PolyWord u = *sp; sp += *pc; *sp = u; pc += 1; break; }
+        CASE(INSTR_reset_r_b): sp += *pc; pc += 1; NEXT_INSTR;
 
-        case INSTR_const_int_b: *(--sp) = TAGGED(*pc); pc += 1; break;
+        CASE(INSTR_const_int_b): SPILL_TOS; tos = TAGGED(*pc); pc += 1; NEXT_INSTR;
 
-        case INSTR_local_0: { stackItem u = sp[0]; *(--sp) = u; break; }
-        case INSTR_local_1: { stackItem u = sp[1]; *(--sp) = u; break; }
-        case INSTR_local_2: { stackItem u = sp[2]; *(--sp) = u; break; }
-        case INSTR_local_3: { stackItem u = sp[3]; *(--sp) = u; break; }
-        case INSTR_local_4: { stackItem u = sp[4]; *(--sp) = u; break; }
-        case INSTR_local_5: { stackItem u = sp[5]; *(--sp) = u; break; }
-        case INSTR_local_6: { stackItem u = sp[6]; *(--sp) = u; break; }
-        case INSTR_local_7: { stackItem u = sp[7]; *(--sp) = u; break; }
-        case INSTR_local_8: { stackItem u = sp[8]; *(--sp) = u; break; }
-        case INSTR_local_9: { stackItem u = sp[9]; *(--sp) = u; break; }
-        case INSTR_local_10: { stackItem u = sp[10]; *(--sp) = u; break; }
-        case INSTR_local_11: { stackItem u = sp[11]; *(--sp) = u; break; }
-        case INSTR_local_12: { stackItem u = sp[12]; *(--sp) = u; break; }
-        case INSTR_local_13: { stackItem u = sp[13]; *(--sp) = u; break; }
-        case INSTR_local_14: { stackItem u = sp[14]; *(--sp) = u; break; }
-        case INSTR_local_15: { stackItem u = sp[15]; *(--sp) = u; break; }
+        CASE(INSTR_local_0): { SPILL_TOS; NEXT_INSTR; }
+        CASE(INSTR_local_1): { SPILL_TOS; tos = sp[1]; NEXT_INSTR; }
+        CASE(INSTR_local_2): { SPILL_TOS; tos = sp[2]; NEXT_INSTR; }
+        CASE(INSTR_local_3): { SPILL_TOS; tos = sp[3]; NEXT_INSTR; }
+        CASE(INSTR_local_4): { SPILL_TOS; tos = sp[4]; NEXT_INSTR; }
+        CASE(INSTR_local_5): { SPILL_TOS; tos = sp[5]; NEXT_INSTR; }
+        CASE(INSTR_local_6): { SPILL_TOS; tos = sp[6]; NEXT_INSTR; }
+        CASE(INSTR_local_7): { SPILL_TOS; tos = sp[7]; NEXT_INSTR; }
+        CASE(INSTR_local_8): { SPILL_TOS; tos = sp[8]; NEXT_INSTR; }
+        CASE(INSTR_local_9): { SPILL_TOS; tos = sp[9]; NEXT_INSTR; }
+        CASE(INSTR_local_10): { SPILL_TOS; tos = sp[10]; NEXT_INSTR; }
+        CASE(INSTR_local_11): { SPILL_TOS; tos = sp[11]; NEXT_INSTR; }
+        CASE(INSTR_local_12): { SPILL_TOS; tos = sp[12]; NEXT_INSTR; }
+        CASE(INSTR_local_13): { SPILL_TOS; tos = sp[13]; NEXT_INSTR; }
+        CASE(INSTR_local_14): { SPILL_TOS; tos = sp[14]; NEXT_INSTR; }
+        CASE(INSTR_local_15): { SPILL_TOS; tos = sp[15]; NEXT_INSTR; }
 
-        case INSTR_indirect_0:
-            *sp = (*sp).w().AsObjPtr()->Get(0); break;
+        CASE(INSTR_indirect_0):
+            tos = tos.w().AsObjPtr()->Get(0); NEXT_INSTR;
 
-        case INSTR_indirect_1:
-            *sp = (*sp).w().AsObjPtr()->Get(1); break;
+        CASE(INSTR_indirect_1):
+            tos = tos.w().AsObjPtr()->Get(1); NEXT_INSTR;
 
-        case INSTR_indirect_2:
-            *sp = (*sp).w().AsObjPtr()->Get(2); break;
+        CASE(INSTR_indirect_2):
+            tos = tos.w().AsObjPtr()->Get(2); NEXT_INSTR;
 
-        case INSTR_indirect_3:
-            *sp = (*sp).w().AsObjPtr()->Get(3); break;
+        CASE(INSTR_indirect_3):
+            tos = tos.w().AsObjPtr()->Get(3); NEXT_INSTR;
 
-        case INSTR_indirect_4:
-            *sp = (*sp).w().AsObjPtr()->Get(4); break;
+        CASE(INSTR_indirect_4):
+            tos = tos.w().AsObjPtr()->Get(4); NEXT_INSTR;
 
-        case INSTR_indirect_5:
-            *sp = (*sp).w().AsObjPtr()->Get(5); break;
+        CASE(INSTR_indirect_5):
+            tos = tos.w().AsObjPtr()->Get(5); NEXT_INSTR;
 
-        case INSTR_const_0: *(--sp) = Zero; break;
-        case INSTR_const_1: *(--sp) = TAGGED(1); break;
-        case INSTR_const_2: *(--sp) = TAGGED(2); break;
-        case INSTR_const_3: *(--sp) = TAGGED(3); break;
-        case INSTR_const_4: *(--sp) = TAGGED(4); break;
-        case INSTR_const_10: *(--sp) = TAGGED(10); break;
+        CASE(INSTR_const_0): SPILL_TOS; tos = Zero; NEXT_INSTR;
+        CASE(INSTR_const_1): SPILL_TOS; tos = TAGGED(1); NEXT_INSTR;
+        CASE(INSTR_const_2): SPILL_TOS; tos = TAGGED(2); NEXT_INSTR;
+        CASE(INSTR_const_3): SPILL_TOS; tos = TAGGED(3); NEXT_INSTR;
+        CASE(INSTR_const_4): SPILL_TOS; tos = TAGGED(4); NEXT_INSTR;
+        CASE(INSTR_const_10): SPILL_TOS; tos = TAGGED(10); NEXT_INSTR;
 
-        case INSTR_reset_r_1: { PolyWord u = *sp; sp += 1; *sp = u; break; }
-        case INSTR_reset_r_2: { PolyWord u = *sp; sp += 2; *sp = u; break; }
-        case INSTR_reset_r_3: { PolyWord u = *sp; sp += 3; *sp = u; break; }
+        CASE(INSTR_reset_r_1): sp += 1; NEXT_INSTR;
+        CASE(INSTR_reset_r_2): sp += 2; NEXT_INSTR;
+        CASE(INSTR_reset_r_3): sp += 3; NEXT_INSTR;
 
-        case INSTR_reset_1: sp += 1; break;
-        case INSTR_reset_2: sp += 2; break;
+        CASE(INSTR_reset_1): RELOAD_TOS; NEXT_INSTR;
+        CASE(INSTR_reset_2): tos = sp[1]; sp += 2; NEXT_INSTR;
 
-        case INSTR_stack_containerB:
+        CASE(INSTR_stack_containerB):
         {
             POLYUNSIGNED words = *pc++;
+            SPILL_TOS;
             while (words-- > 0) *(--sp) = Zero;
-            sp--;
-            (*sp).stackAddr = sp + 1;
-            break;
+            // The container itself is in memory and tos points to it.
+            tos.stackAddr = sp;
+            NEXT_INSTR;
         }
 
-        case INSTR_callFastRTS0:
+        CASE(INSTR_callFastRTS0):
             {
-                callFastRts0 doCall = *(callFastRts0*)(*sp++).w().AsObjPtr();
+                callFastRts0 doCall = *(callFastRts0*)tos.w().AsObjPtr();
                 ClearExceptionPacket();
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall();
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_callFastRTS1:
+        CASE(INSTR_callFastRTS1):
             {
-                callFastRts1 doCall = *(callFastRts1*)(*sp++).w().AsObjPtr();
+                callFastRts1 doCall = *(callFastRts1*)tos.w().AsObjPtr();
                 POLYUNSIGNED rtsArg1 = (*sp++).w().AsUnsigned();
                 ClearExceptionPacket();
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall(rtsArg1);
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_callFastRTS2:
+        CASE(INSTR_callFastRTS2):
             {
-                callFastRts2 doCall = *(callFastRts2*)(*sp++).w().AsObjPtr();
+                callFastRts2 doCall = *(callFastRts2*)tos.w().AsObjPtr();
                 POLYUNSIGNED rtsArg2 = (*sp++).w().AsUnsigned(); // Pop off the args, last arg first.
                 POLYUNSIGNED rtsArg1 = (*sp++).w().AsUnsigned();
                 ClearExceptionPacket();
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall(rtsArg1, rtsArg2);
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_callFastRTS3:
+        CASE(INSTR_callFastRTS3):
             {
-                callFastRts3 doCall = *(callFastRts3*)(*sp++).w().AsObjPtr();
+                callFastRts3 doCall = *(callFastRts3*)tos.w().AsObjPtr();
                 POLYUNSIGNED rtsArg3 = (*sp++).w().AsUnsigned(); // Pop off the args, last arg first.
                 POLYUNSIGNED rtsArg2 = (*sp++).w().AsUnsigned();
                 POLYUNSIGNED rtsArg1 = (*sp++).w().AsUnsigned();
@@ -730,15 +955,15 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall(rtsArg1, rtsArg2, rtsArg3);
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_callFastRTS4:
+        CASE(INSTR_callFastRTS4):
             {
-                callFastRts4 doCall = *(callFastRts4*)(*sp++).w().AsObjPtr();
+                callFastRts4 doCall = *(callFastRts4*)tos.w().AsObjPtr();
                 POLYUNSIGNED rtsArg4 = (*sp++).w().AsUnsigned(); // Pop off the args, last arg first.
                 POLYUNSIGNED rtsArg3 = (*sp++).w().AsUnsigned();
                 POLYUNSIGNED rtsArg2 = (*sp++).w().AsUnsigned();
@@ -747,15 +972,15 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall(rtsArg1, rtsArg2, rtsArg3, rtsArg4);
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_callFastRTS5:
+        CASE(INSTR_callFastRTS5):
             {
-                callFastRts5 doCall = *(callFastRts5*)(*sp++).w().AsObjPtr();
+                callFastRts5 doCall = *(callFastRts5*)tos.w().AsObjPtr();
                 POLYUNSIGNED rtsArg5 = (*sp++).w().AsUnsigned(); // Pop off the args, last arg first.
                 POLYUNSIGNED rtsArg4 = (*sp++).w().AsUnsigned();
                 POLYUNSIGNED rtsArg3 = (*sp++).w().AsUnsigned();
@@ -765,209 +990,226 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 SaveInterpreterState(pc, sp);
                 POLYUNSIGNED result = doCall(rtsArg1, rtsArg2, rtsArg3, rtsArg4, rtsArg5);
                 LoadInterpreterState(pc, sp);
-                // If this raised an exception 
+                // If this raised an exception
                 if (GetExceptionPacket().IsDataPtr()) goto RAISE_EXCEPTION;
-                *(--sp) = PolyWord::FromUnsigned(result);
-                break;
+                tos = PolyWord::FromUnsigned(result);
+                goto JIT_CONTINUE;
             }
 
-        case INSTR_notBoolean:
-            *sp = ((*sp).w() == True) ? False : True; break;
+        CASE(INSTR_notBoolean):
+            tos = (tos.w() == True) ? False : True; NEXT_INSTR;
 
-        case INSTR_isTagged:
-            *sp = (*sp).w().IsTagged() ? True : False; break;
+        CASE(INSTR_isTagged):
+            tos = tos.w().IsTagged() ? True : False; NEXT_INSTR;
 
-        case INSTR_cellLength:
+        CASE(INSTR_cellLength):
             /* Return the length word. */
-            *sp = TAGGED((*sp).w().AsObjPtr()->Length());
-            break;
+            tos = TAGGED(tos.w().AsObjPtr()->Length());
+            NEXT_INSTR;
 
-        case INSTR_cellFlags:
+        CASE(INSTR_cellFlags):
         {
-            PolyObject *p = (*sp).w().AsObjPtr();
+            PolyObject *p = tos.w().AsObjPtr();
             POLYUNSIGNED f = (p->LengthWord()) >> OBJ_PRIVATE_FLAGS_SHIFT;
-            *sp = TAGGED(f);
-            break;
+            tos = TAGGED(f);
+            NEXT_INSTR;
         }
 
-        case INSTR_clearMutable:
+        CASE(INSTR_clearMutable):
         {
-            PolyObject *obj = (*sp).w().AsObjPtr();
+            PolyObject *obj = tos.w().AsObjPtr();
             POLYUNSIGNED lengthW = obj->LengthWord();
             /* Clear the mutable bit. */
             obj->SetLengthWord(lengthW & ~_OBJ_MUTABLE_BIT);
-            *sp = Zero;
-            break;
+            tos = Zero;
+            NEXT_INSTR;
         }
 
-        case INSTR_atomicIncr:
+        CASE(INSTR_atomicIncr):
         {
             // This is legacy code.  Returns the result after the increment.
-            PolyObject* p = (*sp).w().AsObjPtr();
+            PolyObject* p = tos.w().AsObjPtr();
             PLocker pl(&mutexLock);
             POLYUNSIGNED newValue = p->Get(0).AsUnsigned() + 2; // Add tagged 1 with the tag removed.
             p->Set(0, PolyWord::FromUnsigned(newValue));
-            *sp = PolyWord::FromUnsigned(newValue);
-            break;
+            tos = PolyWord::FromUnsigned(newValue);
+            NEXT_INSTR;
         }
 
-        case INSTR_atomicDecr:
+        CASE(INSTR_atomicDecr):
         {
             // This is legacy code.  Returns the result after the increment.
-            PolyObject* p = (*sp).w().AsObjPtr();
+            PolyObject* p = tos.w().AsObjPtr();
             PLocker pl(&mutexLock);
             POLYUNSIGNED newValue = p->Get(0).AsUnsigned() - 2; // Subtract tagged 1 with the tag removed.
             p->Set(0, PolyWord::FromUnsigned(newValue));
-            *sp = PolyWord::FromUnsigned(newValue);
-            break;
+            tos = PolyWord::FromUnsigned(newValue);
+            NEXT_INSTR;
         }
 
-        case INSTR_equalWord:
+        CASE(INSTR_equalWord):
         {
-            PolyWord u = *sp++;
-            *sp = u == (*sp) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = u == tos.w() ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_jumpNEqLocal:
+        // These test a local without pushing it.  Storing tos below sp means
+        // that the offset can be used without checking for zero.
+        CASE(INSTR_jumpNEqLocal):
         {
             // Compare a local with a constant and jump if not equal.
-            PolyWord u = sp[pc[0]];
+            sp[-1] = tos;
+            PolyWord u = sp[pc[0]-1];
             if (u.IsTagged() && u.UnTagged() == pc[1])
                 pc += 3;
             else pc += pc[2] + 3;
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_jumpNEqLocalInd:
+        CASE(INSTR_jumpNEqLocalInd):
         {
             // Test the union tag value in the first word of a tuple.
-            PolyWord u = sp[pc[0]];
+            sp[-1] = tos;
+            PolyWord u = sp[pc[0]-1];
             u = u.AsObjPtr()->Get(0);
             if (u.IsTagged() && u.UnTagged() == pc[1])
                 pc += 3;
             else pc += pc[2] + 3;
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_isTaggedLocalB:
+        CASE(INSTR_isTaggedLocalB):
         {
+            SPILL_TOS;
             PolyWord u = sp[*pc++];
-            *(--sp) = u.IsTagged() ? True : False;
-            break;
+            tos = u.IsTagged() ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_jumpTaggedLocal:
+        CASE(INSTR_jumpTaggedLocal):
         {
-            PolyWord u = sp[*pc];
+            sp[-1] = tos;
+            PolyWord u = sp[*pc-1];
             // Jump if the value is tagged.
             if (u.IsTagged())
                 pc += pc[1] + 2;
             else pc += 2;
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_lessSigned:
+        CASE(INSTR_lessSigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsSigned() < u.AsSigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsSigned() < u.AsSigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_lessUnsigned:
+        CASE(INSTR_lessUnsigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsUnsigned() < u.AsUnsigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsUnsigned() < u.AsUnsigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_lessEqSigned:
+        CASE(INSTR_lessEqSigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsSigned() <= u.AsSigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsSigned() <= u.AsSigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_lessEqUnsigned:
+        CASE(INSTR_lessEqUnsigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsUnsigned() <= u.AsUnsigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsUnsigned() <= u.AsUnsigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_greaterSigned:
+        CASE(INSTR_greaterSigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsSigned() > u.AsSigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsSigned() > u.AsSigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_greaterUnsigned:
+        CASE(INSTR_greaterUnsigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsUnsigned() > u.AsUnsigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsUnsigned() > u.AsUnsigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_greaterEqSigned:
+        CASE(INSTR_greaterEqSigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsSigned() >= u.AsSigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsSigned() >= u.AsSigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_greaterEqUnsigned:
+        CASE(INSTR_greaterEqUnsigned):
         {
-            PolyWord u = *sp++;
-            *sp = ((*sp).w().AsUnsigned() >= u.AsUnsigned()) ? True : False;
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = (tos.w().AsUnsigned() >= u.AsUnsigned()) ? True : False;
+            NEXT_INSTR;
         }
 
-        case INSTR_fixedAdd:
+        CASE(INSTR_fixedAdd):
         {
-            PolyWord x = *sp++;
-            PolyWord y = (*sp);
+            PolyWord x = tos;
+            PolyWord y = *sp++;
             POLYSIGNED t = UNTAGGED(x) + UNTAGGED(y);
             if (t <= MAXTAGGED && t >= -MAXTAGGED-1)
-                *sp = TAGGED(t);
+                tos = TAGGED(t);
             else
             {
                 taskData->SetException((poly_exn*)overflowPacket);
                 goto RAISE_EXCEPTION;
             }
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_fixedSub:
+        CASE(INSTR_fixedSub):
         {
-            PolyWord x = *sp++;
-            PolyWord y = (*sp);
+            PolyWord x = tos;
+            PolyWord y = *sp++;
             POLYSIGNED t = UNTAGGED(y) - UNTAGGED(x);
             if (t <= MAXTAGGED && t >= -MAXTAGGED-1)
-                *sp = TAGGED(t);
+                tos = TAGGED(t);
             else
             {
                 taskData->SetException((poly_exn*)overflowPacket);
                 goto RAISE_EXCEPTION;
             }
-            break;
+            NEXT_INSTR;
         }
 
-        case INSTR_fixedMult:
+        CASE(INSTR_fixedMult):
         {
             // There's no simple way to detect signed overflow in multiplication.
             // Unsigned multiplication is defined to wrap but signed is not and
             // GCC optimised away the previous test we had here.
-            PolyWord x = *sp++;
+            // After popping x the stack in memory is complete.
+            PolyWord x = tos;
             PolyWord y = (*sp);
             try {
                 Handle mark = taskData->saveVec.mark();
                 SaveInterpreterState(pc, sp);
                 Handle result = mult_longc(taskData, taskData->saveVec.push(x), taskData->saveVec.push(y));
                 LoadInterpreterState(pc, sp);
-                *sp = result->Word();
+                RELOAD_TOS;
+                tos = result->Word();
                 taskData->saveVec.reset(mark);
-                if ((*sp).w().IsDataPtr())
+                if (tos.w().IsDataPtr())
                 {
                     taskData->SetException((poly_exn*)overflowPacket);
                     goto RAISE_EXCEPTION;
@@ -977,143 +1219,250 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 // We could run out of store
                 goto RAISE_EXCEPTION;
             }
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_fixedQuot:
+        CASE(INSTR_fixedQuot):
         {
             // Zero and overflow are checked for in ML.
-            POLYSIGNED u = UNTAGGED(*sp++);
-            PolyWord y = (*sp);
-            *sp = TAGGED(UNTAGGED(y) / u);
-            break;
+            POLYSIGNED u = UNTAGGED(tos);
+            PolyWord y = *sp++;
+            tos = TAGGED(UNTAGGED(y) / u);
+            NEXT_INSTR;
         }
 
-        case INSTR_fixedRem:
+        CASE(INSTR_fixedRem):
         {
             // Zero and overflow are checked for in ML.
-            POLYSIGNED u = UNTAGGED(*sp++);
-            PolyWord y = (*sp);
-            *sp = TAGGED(UNTAGGED(y) % u);
-            break;
+            POLYSIGNED u = UNTAGGED(tos);
+            PolyWord y = *sp++;
+            tos = TAGGED(UNTAGGED(y) % u);
+            NEXT_INSTR;
+        }
+
+        // Comparisons followed by jump8false.  These pop both arguments and
+        // jump if the comparison is false.
+        CASE(INSTR_jumpNotEqualWord):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v == u) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotLessSigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsSigned() < u.AsSigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotLessUnsigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsUnsigned() < u.AsUnsigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotLessEqSigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsSigned() <= u.AsSigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
         }
 
-        case INSTR_wordAdd:
+        CASE(INSTR_jumpNotLessEqUnsigned):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsUnsigned() <= u.AsUnsigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotGreaterSigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsSigned() > u.AsSigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotGreaterUnsigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsUnsigned() > u.AsUnsigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotGreaterEqSigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsSigned() >= u.AsSigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_jumpNotGreaterEqUnsigned):
+        {
+            PolyWord u = tos;
+            PolyWord v = *sp++;
+            RELOAD_TOS;
+            if (v.AsUnsigned() >= u.AsUnsigned()) pc += 1; else pc += *pc + 1;
+            NEXT_INSTR;
+        }
+
+        CASE(INSTR_wordAdd):
+        {
+            PolyWord u = tos;
+            RELOAD_TOS;
             // Because we're not concerned with overflow we can just add the values and subtract the tag.
-            *sp = PolyWord::FromUnsigned((*sp).w().AsUnsigned() + u.AsUnsigned() - TAGGED(0).AsUnsigned());
-            break;
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() + u.AsUnsigned() - TAGGED(0).AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_wordSub:
+        CASE(INSTR_wordSub):
         {
-            PolyWord u = *sp++;
-            *sp = PolyWord::FromUnsigned((*sp).w().AsUnsigned() - u.AsUnsigned() + TAGGED(0).AsUnsigned());
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() - u.AsUnsigned() + TAGGED(0).AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_wordMult:
+        CASE(INSTR_wordAddConstB):
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() + TAGGED(*pc).AsUnsigned() - TAGGED(0).AsUnsigned());
+            pc += 1;
+            NEXT_INSTR;
+
+        CASE(INSTR_wordSubConstB):
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() - TAGGED(*pc).AsUnsigned() + TAGGED(0).AsUnsigned());
+            pc += 1;
+            NEXT_INSTR;
+
+        CASE(INSTR_wordMult):
         {
-            PolyWord u = *sp++;
-            *sp = TAGGED(UNTAGGED_UNSIGNED(*sp) * UNTAGGED_UNSIGNED(u));
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = TAGGED(UNTAGGED_UNSIGNED(tos) * UNTAGGED_UNSIGNED(u));
+            NEXT_INSTR;
         }
 
-        case INSTR_wordDiv:
+        CASE(INSTR_wordDiv):
         {
-            POLYUNSIGNED u = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED u = UNTAGGED_UNSIGNED(tos);
+            RELOAD_TOS;
             // Detection of zero is done in ML
-            *sp = TAGGED(UNTAGGED_UNSIGNED(*sp) / u); break;
+            tos = TAGGED(UNTAGGED_UNSIGNED(tos) / u); NEXT_INSTR;
         }
 
-        case INSTR_wordMod:
+        CASE(INSTR_wordMod):
         {
-            POLYUNSIGNED u = UNTAGGED_UNSIGNED(*sp++);
-            *sp = TAGGED(UNTAGGED_UNSIGNED(*sp) % u);
-            break;
+            POLYUNSIGNED u = UNTAGGED_UNSIGNED(tos);
+            RELOAD_TOS;
+            tos = TAGGED(UNTAGGED_UNSIGNED(tos) % u);
+            NEXT_INSTR;
         }
 
-        case INSTR_wordAnd:
+        CASE(INSTR_wordAnd):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            RELOAD_TOS;
             // Since both of these should be tagged the tag bit will be preserved.
-            *sp = PolyWord::FromUnsigned((*sp).w().AsUnsigned() & u.AsUnsigned());
-            break;
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() & u.AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_wordOr:
+        CASE(INSTR_wordOr):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            RELOAD_TOS;
             // Since both of these should be tagged the tag bit will be preserved.
-            *sp = PolyWord::FromUnsigned((*sp).w().AsUnsigned() | u.AsUnsigned());
-            break;
+            tos = PolyWord::FromUnsigned(tos.w().AsUnsigned() | u.AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_wordXor:
+        CASE(INSTR_wordXor):
         {
-            PolyWord u = *sp++;
+            PolyWord u = tos;
+            RELOAD_TOS;
             // This will remove the tag bit so it has to be reinstated.
-            *sp = PolyWord::FromUnsigned(((*sp).w().AsUnsigned() ^ u.AsUnsigned()) | TAGGED(0).AsUnsigned());
-            break;
+            tos = PolyWord::FromUnsigned((tos.w().AsUnsigned() ^ u.AsUnsigned()) | TAGGED(0).AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_wordShiftLeft:
+        CASE(INSTR_wordShiftLeft):
         {
-            // ML requires shifts greater than a word to return zero. 
+            // ML requires shifts greater than a word to return zero.
             // That's dealt with at the higher level.
-            PolyWord u = *sp++;
-            *sp = TAGGED(UNTAGGED_UNSIGNED(*sp) << UNTAGGED_UNSIGNED(u));
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = TAGGED(UNTAGGED_UNSIGNED(tos) << UNTAGGED_UNSIGNED(u));
+            NEXT_INSTR;
         }
 
-        case INSTR_wordShiftRLog:
+        CASE(INSTR_wordShiftRLog):
         {
-            PolyWord u = *sp++;
-            *sp = TAGGED(UNTAGGED_UNSIGNED(*sp) >> UNTAGGED_UNSIGNED(u));
-            break;
+            PolyWord u = tos;
+            RELOAD_TOS;
+            tos = TAGGED(UNTAGGED_UNSIGNED(tos) >> UNTAGGED_UNSIGNED(u));
+            NEXT_INSTR;
         }
 
-        case INSTR_arbAdd:
+        CASE(INSTR_arbAdd):
         {
-            PolyWord x = *sp++;
+            PolyWord x = tos;
             PolyWord y = (*sp);
             if (x.IsTagged() && y.IsTagged())
             {
                 POLYSIGNED t = UNTAGGED(x) + UNTAGGED(y);
                 if (t <= MAXTAGGED && t >= -MAXTAGGED - 1)
                 {
-                    *sp = TAGGED(t);
-                    break;
+                    sp++;
+                    tos = TAGGED(t);
+                    NEXT_INSTR;
                 }
             }
-            // One argument was untagged or there was an overflow
+            // One argument was untagged or there was an overflow.
+            // After popping x the stack in memory is complete.
             try {
                 Handle mark = taskData->saveVec.mark();
                 SaveInterpreterState(pc, sp);
                 Handle result = add_longc(taskData, taskData->saveVec.push(x), taskData->saveVec.push(y));
                 LoadInterpreterState(pc, sp);
-                *sp = result->Word();
+                RELOAD_TOS;
+                tos = result->Word();
                 taskData->saveVec.reset(mark);
             }
             catch (IOException&) {
                 // We could run out of store
                 goto RAISE_EXCEPTION;
             }
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_arbSubtract:
+        CASE(INSTR_arbSubtract):
         {
-            PolyWord x = *sp++;
+            PolyWord x = tos;
             PolyWord y = (*sp);
             if (x.IsTagged() && y.IsTagged())
             {
                 POLYSIGNED t = UNTAGGED(y) - UNTAGGED(x);
                 if (t <= MAXTAGGED && t >= -MAXTAGGED - 1)
                 {
-                    *sp = TAGGED(t);
-                    break;
+                    sp++;
+                    tos = TAGGED(t);
+                    NEXT_INSTR;
                 }
             }
             // One argument was untagged or there was an overflow
@@ -1122,199 +1471,213 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 SaveInterpreterState(pc, sp);
                 Handle result = sub_longc(taskData, taskData->saveVec.push(x), taskData->saveVec.push(y));
                 LoadInterpreterState(pc, sp);
-                *sp = result->Word();
+                RELOAD_TOS;
+                tos = result->Word();
                 taskData->saveVec.reset(mark);
             }
             catch (IOException&) {
                 // We could run out of store
                 goto RAISE_EXCEPTION;
             }
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_arbMultiply:
+        CASE(INSTR_arbMultiply):
         {
             // See comment on fixedMultiply above
-            PolyWord x = *sp++;
+            PolyWord x = tos;
             PolyWord y = (*sp);
             try {
                 Handle mark = taskData->saveVec.mark();
                 SaveInterpreterState(pc, sp);
                 Handle result = mult_longc(taskData, taskData->saveVec.push(x), taskData->saveVec.push(y));
                 LoadInterpreterState(pc, sp);
-                *sp = result->Word();
+                RELOAD_TOS;
+                tos = result->Word();
                 taskData->saveVec.reset(mark);
             }
             catch (IOException&) {
                 // We could run out of store
                 goto RAISE_EXCEPTION;
             }
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_allocByteMem:
+        CASE(INSTR_allocByteMem):
         {
             // Allocate byte segment.  This does not need to be initialised.
-            POLYUNSIGNED flags = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED flags = UNTAGGED_UNSIGNED(tos);
             POLYUNSIGNED length = UNTAGGED_UNSIGNED(*sp);
             PolyObject *t = this->allocateMemory(taskData, length, pc, sp);
             if (t == 0) goto RAISE_EXCEPTION; // Exception
             t->SetLengthWord(length, (byte)flags);
-            *sp = (PolyWord)t;
-            break;
+            sp++;
+            tos = (PolyWord)t;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_getThreadId:
-            *(--sp) = (PolyWord)taskData->threadObject;
-            break;
+        CASE(INSTR_getThreadId):
+            SPILL_TOS;
+            tos = (PolyWord)taskData->threadObject;
+            NEXT_INSTR;
 
-        case INSTR_allocWordMemory:
+        CASE(INSTR_allocWordMemory):
         {
             // Allocate word segment.  This must be initialised.
             // We mustn't pop the initialiser until after any potential GC.
+            SPILL_TOS;
             POLYUNSIGNED length = UNTAGGED_UNSIGNED(sp[2]);
             PolyObject *t = this->allocateMemory(taskData, length, pc, sp);
             if (t == 0) goto RAISE_EXCEPTION;
             PolyWord initialiser = *sp++;
             POLYUNSIGNED flags = UNTAGGED_UNSIGNED(*sp++);
             t->SetLengthWord(length, (byte)flags);
-            *sp = (PolyWord)t;
+            sp++;
+            tos = (PolyWord)t;
             // Have to initialise the data.
             for (; length > 0; ) t->Set(--length, initialiser);
-            break;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_alloc_ref:
+        CASE(INSTR_alloc_ref):
         {
             // Allocate a single word mutable cell.  This is more common than allocWordMemory on its own.
+            SPILL_TOS;
             PolyObject *t = this->allocateMemory(taskData, 1, pc, sp);
             if (t == 0) goto RAISE_EXCEPTION;
-            PolyWord initialiser = (*sp);
+            PolyWord initialiser = *sp++;
             t->SetLengthWord(1, F_MUTABLE_BIT);
             t->Set(0, initialiser);
-            *sp = (PolyWord)t;
-            break;
+            tos = (PolyWord)t;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_allocMutClosureB:
+        CASE(INSTR_allocMutClosureB):
         {
             // Allocate memory for a mutable closure and copy in the code address.
             POLYUNSIGNED length = *pc++ + sizeof(uintptr_t) / sizeof(PolyWord);
+            SPILL_TOS;
             PolyObject* t = this->allocateMemory(taskData, length, pc, sp);
             if (t == 0) goto RAISE_EXCEPTION;
             t->SetLengthWord(length, F_CLOSURE_OBJ | F_MUTABLE_BIT);
-            PolyObject* srcClosure = (*sp).w().AsObjPtr();
+            PolyObject* srcClosure = (*sp++).w().AsObjPtr();
             *(uintptr_t*)t = *(uintptr_t*)srcClosure;
             for (POLYUNSIGNED i = sizeof(uintptr_t) / sizeof(PolyWord); i < length; i++)
                 t->Set(i, TAGGED(0));
-            *sp = (PolyWord)t;
-            break;
+            tos = (PolyWord)t;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_loadMLWord:
+        CASE(INSTR_loadMLWord):
         {
-            POLYUNSIGNED index = UNTAGGED(*sp++);
-            PolyObject* p = (PolyObject*)((*sp).w().AsCodePtr());
-            *sp = p->Get(index);
-            break;
+            POLYUNSIGNED index = UNTAGGED(tos);
+            RELOAD_TOS;
+            PolyObject* p = (PolyObject*)(tos.w().AsCodePtr());
+            tos = p->Get(index);
+            NEXT_INSTR;
         }
 
-        case INSTR_loadMLByte:
+        CASE(INSTR_loadMLByte):
         {
             // The values on the stack are base and index.
-            POLYUNSIGNED index = UNTAGGED(*sp++);
-            POLYCODEPTR p = (*sp).w().AsCodePtr();
-            *sp = TAGGED(p[index]); // Have to tag the result
-            break;
+            POLYUNSIGNED index = UNTAGGED(tos);
+            RELOAD_TOS;
+            POLYCODEPTR p = tos.w().AsCodePtr();
+            tos = TAGGED(p[index]); // Have to tag the result
+            NEXT_INSTR;
         }
 
-        case INSTR_loadUntagged:
+        CASE(INSTR_loadUntagged):
         {
-            POLYUNSIGNED index = UNTAGGED(*sp++);
-            PolyObject* p = (PolyObject*)((*sp).w().AsCodePtr());
-            *sp = TAGGED(p->Get(index).AsUnsigned());
-            break;
+            POLYUNSIGNED index = UNTAGGED(tos);
+            RELOAD_TOS;
+            PolyObject* p = (PolyObject*)(tos.w().AsCodePtr());
+            tos = TAGGED(p->Get(index).AsUnsigned());
+            NEXT_INSTR;
         }
 
-        case INSTR_storeMLWord:
+        CASE(INSTR_storeMLWord):
         {
-            PolyWord toStore = *sp++;
+            PolyWord toStore = tos;
             POLYUNSIGNED index = UNTAGGED(*sp++);
-            PolyObject* p = (PolyObject*)((*sp).w().AsCodePtr());
+            PolyObject* p = (PolyObject*)((*sp++).w().AsCodePtr());
             p->Set(index, toStore);
-            *sp = Zero;
-            break;
+            tos = Zero;
+            NEXT_INSTR;
         }
 
-        case INSTR_storeMLByte: 
+        CASE(INSTR_storeMLByte):
         {
-            POLYUNSIGNED toStore = UNTAGGED(*sp++);
+            POLYUNSIGNED toStore = UNTAGGED(tos);
             POLYUNSIGNED index = UNTAGGED(*sp++);
-            POLYCODEPTR p = (*sp).w().AsCodePtr();
+            POLYCODEPTR p = (*sp++).w().AsCodePtr();
             p[index] = (byte)toStore;
-            *sp = Zero;
-            break; 
+            tos = Zero;
+            NEXT_INSTR;
         }
 
-        case INSTR_storeUntagged:
+        CASE(INSTR_storeUntagged):
         {
-            PolyWord toStore = PolyWord::FromUnsigned(UNTAGGED_UNSIGNED(*sp++));
+            PolyWord toStore = PolyWord::FromUnsigned(UNTAGGED_UNSIGNED(tos));
             POLYUNSIGNED index = UNTAGGED(*sp++);
-            PolyObject* p = (PolyObject*)((*sp).w().AsCodePtr());
+            PolyObject* p = (PolyObject*)((*sp++).w().AsCodePtr());
             p->Set(index, toStore);
-            *sp = Zero;
-            break;
+            tos = Zero;
+            NEXT_INSTR;
         }
 
-        case INSTR_blockMoveWord:
+        CASE(INSTR_blockMoveWord):
         {
-            POLYUNSIGNED length = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED length = UNTAGGED_UNSIGNED(tos);
             POLYUNSIGNED destIndex = UNTAGGED_UNSIGNED(*sp++);
             PolyObject* dest = (PolyObject*)((*sp++).w().AsCodePtr());
             POLYUNSIGNED srcIndex = UNTAGGED_UNSIGNED(*sp++);
-            PolyObject* src = (PolyObject*)((*sp).w().AsCodePtr());
+            PolyObject* src = (PolyObject*)((*sp++).w().AsCodePtr());
             for (POLYUNSIGNED u = 0; u < length; u++) dest->Set(destIndex + u, src->Get(srcIndex + u));
-            *sp = Zero;
-            break;
+            tos = Zero;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_blockMoveByte:
+        CASE(INSTR_blockMoveByte):
         {
-            POLYUNSIGNED length = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED length = UNTAGGED_UNSIGNED(tos);
             POLYUNSIGNED destOffset = UNTAGGED_UNSIGNED(*sp++);
             POLYCODEPTR dest = (*sp++).w().AsCodePtr();
             POLYUNSIGNED srcOffset = UNTAGGED_UNSIGNED(*sp++);
-            POLYCODEPTR src = (*sp).w().AsCodePtr();
+            POLYCODEPTR src = (*sp++).w().AsCodePtr();
             memcpy(dest+destOffset, src+srcOffset, length);
-            *sp = Zero;
-            break;
+            tos = Zero;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_blockEqualByte:
+        CASE(INSTR_blockEqualByte):
         {
-            POLYUNSIGNED length = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED length = UNTAGGED_UNSIGNED(tos);
             POLYUNSIGNED arg2Offset = UNTAGGED_UNSIGNED(*sp++);
             POLYCODEPTR arg2Ptr = (*sp++).w().AsCodePtr();
             POLYUNSIGNED arg1Offset = UNTAGGED_UNSIGNED(*sp++);
-            POLYCODEPTR arg1Ptr = (*sp).w().AsCodePtr();
-            *sp = memcmp(arg1Ptr+arg1Offset, arg2Ptr+arg2Offset, length) == 0 ? True : False;
-            break;
+            POLYCODEPTR arg1Ptr = (*sp++).w().AsCodePtr();
+            tos = memcmp(arg1Ptr+arg1Offset, arg2Ptr+arg2Offset, length) == 0 ? True : False;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_blockCompareByte:
+        CASE(INSTR_blockCompareByte):
         {
-            POLYUNSIGNED length = UNTAGGED_UNSIGNED(*sp++);
+            POLYUNSIGNED length = UNTAGGED_UNSIGNED(tos);
             POLYUNSIGNED arg2Offset = UNTAGGED_UNSIGNED(*sp++);
             POLYCODEPTR arg2Ptr = (*sp++).w().AsCodePtr();
             POLYUNSIGNED arg1Offset = UNTAGGED_UNSIGNED(*sp++);
-            POLYCODEPTR arg1Ptr = (*sp).w().AsCodePtr();
+            POLYCODEPTR arg1Ptr = (*sp++).w().AsCodePtr();
             int result = memcmp(arg1Ptr+arg1Offset, arg2Ptr+arg2Offset, length);
-            *sp = result == 0 ? TAGGED(0) : result < 0 ? TAGGED(-1) : TAGGED(1);
-            break;
+            tos = result == 0 ? TAGGED(0) : result < 0 ? TAGGED(-1) : TAGGED(1);
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_escape:
+        CASE(INSTR_escape):
         {
+            // The extended instructions work on the stack in memory.
+            SPILL_TOS;
+            double realResult; // Set by instructions that go to REAL_RESULT.
             switch (*pc++) {
 
             case EXTINSTR_callFastRRtoR:
@@ -1325,12 +1688,9 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 PolyWord rtsArg1 = *sp++;
                 double argument1 = unboxDouble(rtsArg1);
                 double argument2 = unboxDouble(rtsArg2);
-                // Allocate memory for the result.
-                double result = doCall(argument1, argument2);
-                PolyObject* t = boxDouble(taskData, result, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *(--sp) = (PolyWord)t;
-                break;
+                realResult = doCall(argument1, argument2);
+                --sp; // The slot for the result.
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_callFastRGtoR:
@@ -1340,12 +1700,9 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 intptr_t rtsArg2 = (*sp++).w().AsSigned();
                 PolyWord rtsArg1 = *sp++;
                 double argument1 = unboxDouble(rtsArg1);
-                // Allocate memory for the result.
-                double result = doCall(argument1, rtsArg2);
-                PolyObject* t = boxDouble(taskData, result, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *(--sp) = (PolyWord)t;
-                break;
+                realResult = doCall(argument1, rtsArg2);
+                --sp; // The slot for the result.
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_callFastGtoR:
@@ -1353,12 +1710,9 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 // Call that takes a POLYUNSIGNED argument and returns a double.
                 callRTSGtoR doCall = *(callRTSGtoR*)(*sp++).w().AsObjPtr();
                 intptr_t rtsArg1 = (*sp++).w().AsSigned();
-                // Allocate memory for the result.
-                double result = doCall(rtsArg1);
-                PolyObject* t = boxDouble(taskData, result, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *(--sp) = (PolyWord)t;
-                break;
+                realResult = doCall(rtsArg1);
+                --sp; // The slot for the result.
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_callFastFtoF:
@@ -1427,12 +1781,9 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 callRTSRtoR doCall = *(callRTSRtoR*)(*sp++).w().AsObjPtr();
                 PolyWord rtsArg1 = *sp++;
                 double argument = unboxDouble(rtsArg1);
-                // Allocate memory for the result.
-                double result = doCall(argument);
-                PolyObject* t = boxDouble(taskData, result, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *(--sp) = (PolyWord)t;
-                break;
+                realResult = doCall(argument);
+                --sp; // The slot for the result.
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_loadPolyWord:
@@ -1584,18 +1935,14 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
 
             case EXTINSTR_realAbs:
             {
-                PolyObject* t = this->boxDouble(taskData, fabs(unboxDouble(*sp)), pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = fabs(unboxDouble(*sp));
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_realNeg:
             {
-                PolyObject* t = this->boxDouble(taskData, -(unboxDouble(*sp)), pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = -(unboxDouble(*sp));
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_floatAbs:
@@ -1617,10 +1964,8 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             case EXTINSTR_fixedIntToReal:
             {
                 POLYSIGNED u = UNTAGGED(*sp);
-                PolyObject* t = this->boxDouble(taskData, (double)u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = (double)u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_fixedIntToFloat:
@@ -1635,10 +1980,8 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             case EXTINSTR_floatToReal:
             {
                 float u = unboxFloat(*sp);
-                PolyObject* t = this->boxDouble(taskData, (double)u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = (double)u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_wordShiftRArith:
@@ -1874,40 +2217,32 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             {
                 double u = unboxDouble(*sp++);
                 double v = unboxDouble(*sp);
-                PolyObject* t = this->boxDouble(taskData, v + u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = v + u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_realSub:
             {
                 double u = unboxDouble(*sp++);
                 double v = unboxDouble(*sp);
-                PolyObject* t = this->boxDouble(taskData, v - u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = v - u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_realMult:
             {
                 double u = unboxDouble(*sp++);
                 double v = unboxDouble(*sp);
-                PolyObject* t = this->boxDouble(taskData, v * u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = v * u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_realDiv:
             {
                 double u = unboxDouble(*sp++);
                 double v = unboxDouble(*sp);
-                PolyObject* t = this->boxDouble(taskData, v / u, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = v / u;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_floatEqual:
@@ -2124,11 +2459,8 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 POLYSIGNED index = UNTAGGED(*sp++);
                 POLYCODEPTR p = *((byte**)((*sp).w().AsObjPtr())) + offset;
                 double r = ((float*)p)[index];
-                // This must be boxed.
-                PolyObject* t = this->boxDouble(taskData, r, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = r;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_loadCDouble:
@@ -2137,11 +2469,8 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 POLYSIGNED index = UNTAGGED(*sp++);
                 POLYCODEPTR p = *((byte**)((*sp).w().AsObjPtr())) + offset;
                 double r = ((double*)p)[index];
-                // This must be boxed.
-                PolyObject* t = this->boxDouble(taskData, r, pc, sp);
-                if (t == 0) goto RAISE_EXCEPTION;
-                *sp = (PolyWord)t;
-                break;
+                realResult = r;
+                goto REAL_RESULT;
             }
 
             case EXTINSTR_storeC8:
@@ -2242,6 +2571,14 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
                 offset = (offset << 8) | pc[1];
                 offset = (offset << 8) | pc[0];
                 pc += offset + 4;
+                // A long loop uses this rather than jump_back8/16.  Check for interrupt
+                // so that the thread will stop for a GC.
+                if (offset < 0 && sp < *stackLimitAddress)
+                {
+                    SaveInterpreterState(pc, sp);
+                    HandleStackOverflow(0);
+                    LoadInterpreterState(pc, sp);
+                }
                 break;
             }
 
@@ -2274,16 +2611,8 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             }
 
             case EXTINSTR_tuple_w:
-            {
                 storeWords = arg1; pc += 2;
-            TUPLE: /* Common code for tupling. */
-                PolyObject* p = this->allocateMemory(taskData, storeWords, pc, sp);
-                if (p == 0) goto RAISE_EXCEPTION; // Exception
-                p->SetLengthWord(storeWords, 0);
-                for (; storeWords > 0; ) p->Set(--storeWords, *sp++);
-                *(--sp) = (PolyWord)p;
-                break;
-            }
+                goto TUPLE;
 
             case EXTINSTR_indirect_w:
                 *sp = (*sp).w().AsObjPtr()->Get(arg1); pc += 2; break;
@@ -2413,18 +2742,73 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             }
 
             case EXTINSTR_closureW:
-            {
                 storeWords = arg1;
                 pc += 2;
-            CREATE_CLOSURE:
-                // Allocate a closure.  storeWords is the number of non-locals.
-                POLYUNSIGNED length = storeWords + sizeof(uintptr_t) / sizeof(PolyWord);
-                PolyObject* t = this->allocateMemory(taskData, length, pc, sp);
+                goto CREATE_CLOSURE;
+
+            REAL_RESULT:
+            {
+                // Instructions that produce a real come here with the value in realResult
+                // and *sp as the slot for it.  The slot may still hold one of the arguments
+                // which is fine for the GC.  Before allocating a box look ahead: if the
+                // next instruction is a real operation that takes this value as an argument
+                // apply it directly.  That is often the case within an expression.  The
+                // other argument is either the next item on the stack or is loaded by an
+                // instruction in between.  Nothing else can refer to the value so the
+                // intermediate boxes are never needed.
+                for (;;)
+                {
+                    if (pc[0] == INSTR_escape)
+                    {
+                        byte op = pc[1];
+                        if (op == EXTINSTR_realAbs) realResult = fabs(realResult);
+                        else if (op == EXTINSTR_realNeg) realResult = -realResult;
+                        else if (isUnboxedRealOperation(op))
+                        {
+                            // The value is the second argument.
+                            PolyWord b = Zero;
+                            bool isReal = unboxedRealOperation(op, unboxDouble(sp[1]), realResult, realResult, b);
+                            sp++;
+                            pc += 2;
+                            if (isReal) continue;
+                            *sp = b;
+                            goto REAL_DONE;
+                        }
+                        else break;
+                        pc += 2;
+                        continue;
+                    }
+                    // The value is the first argument and the next instruction loads the second.
+                    // Only unbox the second argument once we know it is used as a real.
+                    PolyWord operand = Zero;
+                    bool isValue = false; // True if the argument is the value itself.
+                    unsigned opLen = 0;
+                    switch (pc[0])
+                    {
+                    case INSTR_local_0: isValue = true; opLen = 1; break;
+                    case INSTR_local_1: operand = sp[1]; opLen = 1; break;
+                    case INSTR_local_2: operand = sp[2]; opLen = 1; break;
+                    case INSTR_local_3: operand = sp[3]; opLen = 1; break;
+                    case INSTR_local_4: operand = sp[4]; opLen = 1; break;
+                    case INSTR_local_5: operand = sp[5]; opLen = 1; break;
+                    case INSTR_local_6: operand = sp[6]; opLen = 1; break;
+                    case INSTR_local_7: operand = sp[7]; opLen = 1; break;
+                    case INSTR_local_b: operand = sp[pc[1]]; isValue = pc[1] == 0; opLen = 2; break;
+                    case INSTR_constAddr8: operand = *(PolyWord*)(pc + pc[1] + 2); opLen = 2; break;
+                    case INSTR_constAddr16: operand = *(PolyWord*)(pc + pc[1] + pc[2] * 256 + 3); opLen = 3; break;
+                    }
+                    if (opLen == 0 || pc[opLen] != INSTR_escape || !isUnboxedRealOperation(pc[opLen + 1]))
+                        break;
+                    PolyWord b = Zero;
+                    bool isReal = unboxedRealOperation(pc[opLen + 1], realResult,
+                        isValue ? realResult : unboxDouble(operand), realResult, b);
+                    pc += opLen + 2;
+                    if (isReal) continue;
+                    *sp = b;
+                    goto REAL_DONE;
+                }
+                PolyObject* t = this->boxDouble(taskData, realResult, pc, sp);
                 if (t == 0) goto RAISE_EXCEPTION;
-                t->SetLengthWord(length, F_CLOSURE_OBJ);
-                for (; storeWords > 0; ) t->Set(--storeWords + sizeof(uintptr_t) / sizeof(PolyWord), *sp++);
-                PolyObject* srcClosure = (*sp).w().AsObjPtr();
-                *(uintptr_t*)t = *(uintptr_t*)srcClosure;
                 *sp = (PolyWord)t;
                 break;
             }
@@ -2432,21 +2816,28 @@ enum ByteCodeInterpreter::_returnValue ByteCodeInterpreter::RunInterpreter(TaskD
             default: Crash("Unknown extended instruction %x\n", pc[-1]);
             }
 
-            break;
+        REAL_DONE:
+            RELOAD_TOS;
+            goto JIT_CONTINUE;
         }
 
-        case INSTR_enterIntX86:
+        CASE(INSTR_enterIntX86):
             // This is a no-op if we are already interpreting.
-            pc += 3; break;
+            pc += 3; NEXT_INSTR;
 
-        case INSTR_enterIntArm64:
-            pc += 12; break;
+        CASE(INSTR_enterIntArm64):
+            pc += 12; NEXT_INSTR;
 
-        case INSTR_no_op:
+        CASE(INSTR_no_op):
             // Only used for alignment for ARM64.
-            break;
+            NEXT_INSTR;
+
+        JIT_CONTINUE:
+            // After an instruction that the native code returns to the interpreter for.
+            JIT_ENTER(false);
+            NEXT_INSTR;
 
-        default: Crash("Unknown instruction %x\n", pc[-1]);
+        DEFAULT_CASE: Crash("Unknown instruction %x\n", pc[-1]);
 
         } /* switch */
      } /* for */
@@ -24,6 +24,7 @@
 #include "globals.h"
 
 class TaskData;
+class ByteCodeJit;
 
 class ByteCodeInterpreter
 {
@@ -49,6 +50,7 @@ protected:
     unsigned numTailArguments;
     POLYCODEPTR     interpreterPc;
     stackItem       **stackPointerAddress, **stackLimitAddress;
+    ByteCodeJit     *byteCodeJit; // Compiled code if --jit is used.  Zero otherwise.
 
     bool InterpreterReleaseMutex(PolyObject* mutexp);
 
@@ -0,0 +1,994 @@
+/*
+    Title:      bytecodejit.cpp - Tiered compilation of byte code to native code
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/*
+This is a baseline compiler.  Each byte code instruction is translated
+separately using a fixed template so there is no register allocation and no
+analysis beyond finding the instruction boundaries.  The templates use the
+same stack layout as the interpreter with these registers:
+
+    rbx     sp.  Points at the second item on the stack.
+    r12     tos.  The item on the top of the stack.
+    r13     Address of the stack limit.  Checked on back-edges.
+    r14     The ByteCodeJitState passed in.
+
+Instructions without a template return to the interpreter at the start of the
+instruction.  So do the templates that find a case they cannot handle, such as
+overflow in arbitrary precision addition, but they test for this before they
+change anything.  Returning to the interpreter stores rbx and r12 in the state
+and returns the byte code address in rax.
+
+The compiled code contains the absolute addresses of constants within the code
+object.  That relies on code objects never being moved.  They can be freed by
+the GC or replaced when a saved state is loaded and byteCodeJitGeneration is
+incremented when that happens.  The compiled code is never running at that
+point because the interpreter is only stopped at a call to the RTS.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_WIN32)
+#include "winconfig.h"
+#else
+#error "No configuration file"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_STDDEF_H
+#include <stddef.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "globals.h"
+#include "bytecodejit.h"
+#include "int_opcodes.h"
+#include "machine_dep.h"
+#include "memmgr.h"
+
+unsigned byteCodeJitThreshold = 0;
+unsigned byteCodeJitGeneration = 0;
+
+#if (defined(HAVE_BYTECODE_JIT) && defined(HAVE_SYS_MMAN_H))
+
+// Each chunk of native code memory.  A code object larger than this is not compiled.
+#define JIT_CHUNK_SIZE      (1024 * 1024)
+// Stop compiling once this much has been generated.  The code is discarded and
+// compiled again if any code objects are freed.
+#define JIT_MAX_CODE        (64 * 1024 * 1024)
+
+namespace {
+
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+       R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+// Registers used by the templates
+enum { REG_SP = RBX, REG_TOS = R12, REG_LIMIT = R13, REG_STATE = R14 };
+
+enum { CC_O = 0, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+       CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G, CC_ALWAYS };
+
+// Extensions to the opcode for group 1 arithmetic and shifts.
+enum { ARITH_ADD = 0, ARITH_OR = 1, ARITH_AND = 4, ARITH_SUB = 5, ARITH_XOR = 6, ARITH_CMP = 7 };
+enum { SHIFT_SHL = 4, SHIFT_SHR = 5, SHIFT_SAR = 7 };
+
+#define TAGGED_VAL(n)   ((POLYUNSIGNED)(n) * 2 + 1)
+#define TRUE_VAL        TAGGED_VAL(1)
+#define FALSE_VAL       TAGGED_VAL(0)
+
+// Return the length of the instruction at pc or zero if it is not recognised
+// or extends beyond the end of the byte code.
+static unsigned instructionLength(POLYCODEPTR pc, POLYCODEPTR end)
+{
+    unsigned len;
+    switch (pc[0])
+    {
+    case INSTR_loadMLWord: case INSTR_storeMLWord: case INSTR_alloc_ref: case INSTR_blockMoveWord:
+    case INSTR_loadUntagged: case INSTR_storeUntagged: case INSTR_call_closure: case INSTR_raise_ex:
+    case INSTR_return_1: case INSTR_return_2: case INSTR_return_3:
+    case INSTR_local_0: case INSTR_local_1: case INSTR_local_2: case INSTR_local_3:
+    case INSTR_local_4: case INSTR_local_5: case INSTR_local_6: case INSTR_local_7:
+    case INSTR_local_8: case INSTR_local_9: case INSTR_local_10: case INSTR_local_11:
+    case INSTR_local_12: case INSTR_local_13: case INSTR_local_14: case INSTR_local_15:
+    case INSTR_indirect_0: case INSTR_indirect_1: case INSTR_indirect_2:
+    case INSTR_indirect_3: case INSTR_indirect_4: case INSTR_indirect_5:
+    case INSTR_const_0: case INSTR_const_1: case INSTR_const_2: case INSTR_const_3:
+    case INSTR_const_4: case INSTR_const_10:
+    case INSTR_arbAdd: case INSTR_arbSubtract: case INSTR_arbMultiply:
+    case INSTR_reset_1: case INSTR_reset_2: case INSTR_no_op:
+    case INSTR_reset_r_1: case INSTR_reset_r_2: case INSTR_reset_r_3:
+    case INSTR_tuple_2: case INSTR_tuple_3: case INSTR_tuple_4: case INSTR_lock: case INSTR_ldexc:
+    case INSTR_push_handler: case INSTR_deleteHandler:
+    case INSTR_callFastRTS0: case INSTR_callFastRTS1: case INSTR_callFastRTS2:
+    case INSTR_callFastRTS3: case INSTR_callFastRTS4: case INSTR_callFastRTS5:
+    case INSTR_notBoolean: case INSTR_isTagged: case INSTR_cellLength: case INSTR_cellFlags:
+    case INSTR_clearMutable: case INSTR_atomicIncr: case INSTR_atomicDecr: case INSTR_equalWord:
+    case INSTR_lessSigned: case INSTR_lessUnsigned: case INSTR_lessEqSigned: case INSTR_lessEqUnsigned:
+    case INSTR_greaterSigned: case INSTR_greaterUnsigned: case INSTR_greaterEqSigned: case INSTR_greaterEqUnsigned:
+    case INSTR_fixedAdd: case INSTR_fixedSub: case INSTR_fixedMult: case INSTR_fixedQuot: case INSTR_fixedRem:
+    case INSTR_wordAdd: case INSTR_wordSub: case INSTR_wordMult: case INSTR_wordDiv: case INSTR_wordMod:
+    case INSTR_wordAnd: case INSTR_wordOr: case INSTR_wordXor: case INSTR_wordShiftLeft: case INSTR_wordShiftRLog:
+    case INSTR_allocByteMem: case INSTR_indirect0Local0: case INSTR_getThreadId: case INSTR_allocWordMemory:
+    case INSTR_loadMLByte: case INSTR_storeMLByte:
+    case INSTR_blockMoveByte: case INSTR_blockEqualByte: case INSTR_blockCompareByte:
+        len = 1; break;
+
+    case INSTR_jump8: case INSTR_jump8false: case INSTR_jump8True: case INSTR_stack_containerB:
+    case INSTR_callConstAddr8: case INSTR_callLocalB: case INSTR_jump_back8: case INSTR_return_b:
+    case INSTR_local_b: case INSTR_indirect_b: case INSTR_moveToContainerB: case INSTR_set_stack_val_b:
+    case INSTR_reset_b: case INSTR_reset_r_b: case INSTR_const_int_b:
+    case INSTR_constAddr8: case INSTR_constAddr8_0: case INSTR_constAddr8_1:
+    case INSTR_callConstAddr8_0: case INSTR_callConstAddr8_1:
+    case INSTR_jumpNotEqualWord: case INSTR_jumpNotLessSigned: case INSTR_jumpNotLessUnsigned:
+    case INSTR_jumpNotLessEqSigned: case INSTR_jumpNotLessEqUnsigned: case INSTR_jumpNotGreaterSigned:
+    case INSTR_jumpNotGreaterUnsigned: case INSTR_jumpNotGreaterEqSigned: case INSTR_jumpNotGreaterEqUnsigned:
+    case INSTR_wordAddConstB: case INSTR_wordSubConstB: case INSTR_tuple_b:
+    case INSTR_indirectContainerB: case INSTR_moveToMutClosureB: case INSTR_allocMutClosureB:
+    case INSTR_indirectClosureB0: case INSTR_indirectClosureB1: case INSTR_indirectClosureB2:
+    case INSTR_setHandler8: case INSTR_isTaggedLocalB: case INSTR_indirectLocalB0:
+    case INSTR_indirectLocalB1: case INSTR_closureB:
+        len = 2; break;
+
+    case INSTR_return_w: case INSTR_callConstAddr16: case INSTR_local_w: case INSTR_constAddr8_8:
+    case INSTR_callConstAddr8_8: case INSTR_local_b_b: case INSTR_constAddr16: case INSTR_const_int_w:
+    case INSTR_jump_back16: case INSTR_indirectLocalBB: case INSTR_jump16True: case INSTR_indirectClosureBB:
+    case INSTR_tail_b_b: case INSTR_jumpTaggedLocal: case INSTR_jump16: case INSTR_jump16false:
+    case INSTR_setHandler16: case INSTR_stackSize16:
+        len = 3; break;
+
+    case INSTR_constAddr16_8: case INSTR_callConstAddr16_8: case INSTR_jumpNEqLocalInd:
+    case INSTR_jumpNEqLocal: case INSTR_enterIntX86:
+        len = 4; break;
+
+    case INSTR_enterIntArm64: len = 13; break;
+
+    case INSTR_case16:
+        if (pc + 3 > end) return 0;
+        len = 3 + (pc[1] + pc[2] * 256) * 2;
+        break;
+
+    case INSTR_escape:
+        if (pc + 2 > end) return 0;
+        switch (pc[1])
+        {
+        case EXTINSTR_stack_containerW: case EXTINSTR_allocMutClosureW: case EXTINSTR_indirectClosureW:
+        case EXTINSTR_indirectContainerW: case EXTINSTR_indirect_w: case EXTINSTR_moveToContainerW:
+        case EXTINSTR_moveToMutClosureW: case EXTINSTR_set_stack_val_w: case EXTINSTR_reset_w:
+        case EXTINSTR_reset_r_w: case EXTINSTR_tuple_w: case EXTINSTR_closureW:
+            len = 4; break;
+        case EXTINSTR_jump32True: case EXTINSTR_jump32False: case EXTINSTR_jump32:
+        case EXTINSTR_setHandler32: case EXTINSTR_constAddr32: case EXTINSTR_tail:
+            len = 6; break;
+        case EXTINSTR_constAddr32_16:
+            len = 8; break;
+        case EXTINSTR_realToFloat: case EXTINSTR_realToInt: case EXTINSTR_floatToInt:
+            len = 3; break;
+        case EXTINSTR_case32:
+            if (pc + 4 > end) return 0;
+            len = 4 + (pc[2] + pc[3] * 256) * 4;
+            break;
+        case EXTINSTR_callFastRRtoR: case EXTINSTR_callFastRGtoR: case EXTINSTR_callFastGtoR:
+        case EXTINSTR_callFastFtoF: case EXTINSTR_callFastFFtoF: case EXTINSTR_callFastGtoF:
+        case EXTINSTR_callFastFGtoF: case EXTINSTR_callFastRtoR:
+        case EXTINSTR_loadPolyWord: case EXTINSTR_loadNativeWord: case EXTINSTR_storePolyWord:
+        case EXTINSTR_storeNativeWord: case EXTINSTR_atomicExchAdd: case EXTINSTR_createMutex:
+        case EXTINSTR_lockMutex: case EXTINSTR_tryLockMutex: case EXTINSTR_atomicReset:
+        case EXTINSTR_longWToTagged: case EXTINSTR_signedToLongW: case EXTINSTR_unsignedToLongW:
+        case EXTINSTR_realAbs: case EXTINSTR_realNeg: case EXTINSTR_floatAbs: case EXTINSTR_floatNeg:
+        case EXTINSTR_fixedIntToReal: case EXTINSTR_fixedIntToFloat: case EXTINSTR_floatToReal:
+        case EXTINSTR_wordShiftRArith:
+        case EXTINSTR_lgWordEqual: case EXTINSTR_lgWordLess: case EXTINSTR_lgWordLessEq:
+        case EXTINSTR_lgWordGreater: case EXTINSTR_lgWordGreaterEq: case EXTINSTR_lgWordAdd:
+        case EXTINSTR_lgWordSub: case EXTINSTR_lgWordMult: case EXTINSTR_lgWordDiv:
+        case EXTINSTR_lgWordMod: case EXTINSTR_lgWordAnd: case EXTINSTR_lgWordOr:
+        case EXTINSTR_lgWordXor: case EXTINSTR_lgWordShiftLeft: case EXTINSTR_lgWordShiftRLog:
+        case EXTINSTR_lgWordShiftRArith:
+        case EXTINSTR_realEqual: case EXTINSTR_realLess: case EXTINSTR_realLessEq:
+        case EXTINSTR_realGreater: case EXTINSTR_realGreaterEq: case EXTINSTR_realUnordered:
+        case EXTINSTR_realAdd: case EXTINSTR_realSub: case EXTINSTR_realMult: case EXTINSTR_realDiv:
+        case EXTINSTR_floatEqual: case EXTINSTR_floatLess: case EXTINSTR_floatLessEq:
+        case EXTINSTR_floatGreater: case EXTINSTR_floatGreaterEq: case EXTINSTR_floatUnordered:
+        case EXTINSTR_floatAdd: case EXTINSTR_floatSub: case EXTINSTR_floatMult: case EXTINSTR_floatDiv:
+        case EXTINSTR_loadC8: case EXTINSTR_loadC16: case EXTINSTR_loadC32: case EXTINSTR_loadC64:
+        case EXTINSTR_loadCFloat: case EXTINSTR_loadCDouble:
+        case EXTINSTR_storeC8: case EXTINSTR_storeC16: case EXTINSTR_storeC32: case EXTINSTR_storeC64:
+        case EXTINSTR_storeCFloat: case EXTINSTR_storeCDouble:
+        case EXTINSTR_log2Word: case EXTINSTR_allocCSpace: case EXTINSTR_freeCSpace:
+            len = 2; break;
+        default:
+            return 0;
+        }
+        break;
+
+    default:
+        return 0;
+    }
+    if (pc + len > end) return 0;
+    return len;
+}
+
+// The address a handler set up by setHandler will run.  This follows the interpreter.
+static POLYCODEPTR handlerEntry(POLYCODEPTR entry)
+{
+    while (((uintptr_t)entry & 3) && entry[0] == INSTR_no_op)
+        entry++;
+    return entry;
+}
+
+// Generate X86-64 code into a buffer.  The code is position-independent apart
+// from the absolute addresses it loads so it is copied into executable memory
+// at the end.
+class JitAssembler
+{
+public:
+    std::vector<byte> code;
+
+    size_t Pos() const { return code.size(); }
+
+    void Byte(unsigned b) { code.push_back((byte)b); }
+    void Word32(uint32_t w) { for (unsigned i = 0; i < 4; i++) Byte((w >> (i * 8)) & 0xff); }
+    void Word64(uint64_t w) { for (unsigned i = 0; i < 8; i++) Byte((unsigned)(w >> (i * 8)) & 0xff); }
+    void Patch32(size_t pos, int32_t w) { for (unsigned i = 0; i < 4; i++) code[pos + i] = (byte)(((uint32_t)w >> (i * 8)) & 0xff); }
+
+    // REX prefix with W set.
+    void RexW(int reg, int index, int base)
+    { Byte(0x48 | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3)); }
+    // REX prefix only if required for the extended registers.
+    void RexOpt(int reg, int index, int base)
+    { if ((reg | index | base) & 8) Byte(0x40 | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3)); }
+
+    void ModRM(int mod, int reg, int rm) { Byte((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+    // Memory operand [base + disp]
+    void Mem(int reg, int base, int32_t disp)
+    {
+        int mod = disp == 0 && (base & 7) != RBP ? 0 : disp >= -128 && disp < 128 ? 1 : 2;
+        ModRM(mod, reg, base);
+        if ((base & 7) == RSP) Byte(0x24);
+        if (mod == 1) Byte(disp & 0xff); else if (mod == 2) Word32((uint32_t)disp);
+    }
+
+    // Memory operand [base + index << scale + disp]
+    void MemIndex(int reg, int base, int index, int scale, int32_t disp)
+    {
+        int mod = disp == 0 && (base & 7) != RBP ? 0 : disp >= -128 && disp < 128 ? 1 : 2;
+        ModRM(mod, reg, RSP);
+        Byte((scale << 6) | ((index & 7) << 3) | (base & 7));
+        if (mod == 1) Byte(disp & 0xff); else if (mod == 2) Word32((uint32_t)disp);
+    }
+
+    // 64-bit operation with a register and a memory operand.
+    void OpRM(unsigned op, int reg, int base, int32_t disp) { RexW(reg, 0, base); Byte(op); Mem(reg, base, disp); }
+    void OpRMIndex(unsigned op, int reg, int base, int index, int scale, int32_t disp)
+    { RexW(reg, index, base); Byte(op); MemIndex(reg, base, index, scale, disp); }
+    // 64-bit operation with two registers.  For most operations rm is the destination.
+    void OpRR(unsigned op, int reg, int rm) { RexW(reg, 0, rm); Byte(op); ModRM(3, reg, rm); }
+
+    void Load(int dst, int base, int32_t disp) { OpRM(0x8b, dst, base, disp); }
+    void Store(int base, int32_t disp, int src) { OpRM(0x89, src, base, disp); }
+    void Move(int dst, int src) { OpRR(0x89, src, dst); }
+    void Lea(int dst, int base, int32_t disp) { OpRM(0x8d, dst, base, disp); }
+    void LeaIndex(int dst, int base, int index, int32_t disp) { OpRMIndex(0x8d, dst, base, index, 0, disp); }
+
+    void LoadImm(int reg, uint64_t imm)
+    {
+        if ((int64_t)imm == (int32_t)imm)
+        { RexW(0, 0, reg); Byte(0xc7); ModRM(3, 0, reg); Word32((uint32_t)imm); }
+        else
+        { RexW(0, 0, reg); Byte(0xb8 + (reg & 7)); Word64(imm); }
+    }
+
+    void ArithImm(int ext, int reg, int32_t imm)
+    {
+        RexW(0, 0, reg);
+        if (imm >= -128 && imm < 128) { Byte(0x83); ModRM(3, ext, reg); Byte(imm & 0xff); }
+        else { Byte(0x81); ModRM(3, ext, reg); Word32((uint32_t)imm); }
+    }
+
+    void Shift(int ext, int reg, int n)
+    {
+        RexW(0, 0, reg);
+        if (n == 1) { Byte(0xd1); ModRM(3, ext, reg); }
+        else { Byte(0xc1); ModRM(3, ext, reg); Byte(n); }
+    }
+    void ShiftCL(int ext, int reg) { RexW(0, 0, reg); Byte(0xd3); ModRM(3, ext, reg); }
+
+    void TestImm(int reg, int32_t imm) { RexW(0, 0, reg); Byte(0xf7); ModRM(3, 0, reg); Word32((uint32_t)imm); }
+
+    // Set reg to ML true or false depending on the condition.
+    void SetBool(int cc, int reg)
+    {
+        Byte(0x0f); Byte(0x90 + cc); ModRM(3, 0, RAX);  // setcc al
+        Byte(0x0f); Byte(0xb6); ModRM(3, RAX, RAX);     // movzx eax,al
+        LeaIndex(reg, RAX, RAX, 1);
+    }
+
+    // Jumps with 32-bit offsets.  Return the position of the offset.
+    size_t Jump(int cc)
+    {
+        if (cc == CC_ALWAYS) Byte(0xe9); else { Byte(0x0f); Byte(0x80 + cc); }
+        size_t pos = Pos();
+        Word32(0);
+        return pos;
+    }
+    void SetJumpTarget(size_t pos, size_t target) { Patch32(pos, (int32_t)(target - (pos + 4))); }
+};
+
+// Compile a single code object.
+class JitCompiler: public JitAssembler
+{
+public:
+    JitCompiler(POLYCODEPTR s, POLYCODEPTR e): start(s), end(e), nativeOffset(e - s, -1), isNative(e - s, false) {}
+
+    bool CompileCode(void);
+
+    POLYCODEPTR start, end;
+    std::vector<long> nativeOffset; // Offset in the native code for each instruction start.
+    std::vector<bool> isNative;     // True if the instruction at this offset has a template.
+    std::vector<POLYCODEPTR> entryPoints; // Candidate entry points.
+
+private:
+    bool CompileInstruction(POLYCODEPTR pc, unsigned len);
+
+    void Spill(void) { Store(REG_SP, -(int32_t)sizeof(PolyWord), REG_TOS); ArithImm(ARITH_SUB, REG_SP, sizeof(PolyWord)); }
+    void Reload(void) { Load(REG_TOS, REG_SP, 0); ArithImm(ARITH_ADD, REG_SP, sizeof(PolyWord)); }
+    void Pop(unsigned n) { if (n != 0) ArithImm(ARITH_ADD, REG_SP, n * sizeof(PolyWord)); }
+    void PushLocal(unsigned n) { Spill(); if (n != 0) Load(REG_TOS, REG_SP, n * sizeof(PolyWord)); }
+    void PushConst(POLYUNSIGNED v) { Spill(); LoadImm(REG_TOS, v); }
+    void PushConstAddr(PolyWord *addr) { Spill(); LoadImm(RAX, (uintptr_t)addr); Load(REG_TOS, RAX, 0); }
+    // Load the local that the interpreter addresses as sp[n-1] after storing tos below sp.
+    void LoadLocalNoPush(int reg, unsigned n)
+    { if (n == 0) Move(reg, REG_TOS); else Load(reg, REG_SP, (n - 1) * sizeof(PolyWord)); }
+    // Tag the value in reg and put it in tos.
+    void TagToTos(int reg) { LeaIndex(REG_TOS, reg, reg, 1); }
+    void Untag(int reg, bool isSigned) { Shift(isSigned ? SHIFT_SAR : SHIFT_SHR, reg, 1); }
+
+    void JumpTo(int cc, POLYCODEPTR target) { jumps.push_back(Fixup(Jump(cc), target)); }
+    void JumpToExit(int cc, POLYCODEPTR pc) { exits.push_back(Fixup(Jump(cc), pc)); }
+    void ExitTo(POLYCODEPTR pc) { LoadImm(RAX, (uintptr_t)pc); epilogueJumps.push_back(Jump(CC_ALWAYS)); }
+
+    void Compare(int cc);
+    void CompareJump(int cc, POLYCODEPTR target);
+
+    struct Fixup {
+        Fixup(size_t p, POLYCODEPTR t): pos(p), target(t) {}
+        size_t pos;
+        POLYCODEPTR target;
+    };
+    std::vector<Fixup> jumps, exits;
+    // Entries in case tables.  These are offsets relative to the table.
+    struct TableFixup {
+        TableFixup(size_t p, size_t b, POLYCODEPTR t): pos(p), base(b), target(t) {}
+        size_t pos, base;
+        POLYCODEPTR target;
+    };
+    std::vector<TableFixup> tableEntries;
+    std::vector<size_t> epilogueJumps;
+};
+
+// Replace u = tos, v = next with v cc u.
+void JitCompiler::Compare(int cc)
+{
+    Load(RAX, REG_SP, 0);
+    Pop(1);
+    OpRR(0x39, REG_TOS, RAX); // cmp rax,r12
+    SetBool(cc, REG_TOS);
+}
+
+// Pop u = tos, v = next and jump if not (v cc u).
+void JitCompiler::CompareJump(int cc, POLYCODEPTR target)
+{
+    Move(RCX, REG_TOS);
+    Load(RAX, REG_SP, 0);
+    Load(REG_TOS, REG_SP, sizeof(PolyWord));
+    Pop(2);
+    OpRR(0x39, RCX, RAX); // cmp rax,rcx
+    JumpTo(cc ^ 1, target);
+}
+
+// Generate the template for an instruction.  Returns false if there is no
+// template and the instruction returns to the interpreter.
+bool JitCompiler::CompileInstruction(POLYCODEPTR pc, unsigned len)
+{
+    POLYCODEPTR next = pc + len;
+    const POLYUNSIGNED word = sizeof(PolyWord);
+    const unsigned closureOffset = sizeof(uintptr_t) / sizeof(PolyWord);
+    unsigned arg1 = len >= 3 ? pc[1] + pc[2] * 256 : 0;
+
+    switch (pc[0])
+    {
+    case INSTR_jump8: JumpTo(CC_ALWAYS, next + pc[1]); return true;
+    case INSTR_jump16: JumpTo(CC_ALWAYS, next + arg1); return true;
+
+    case INSTR_jump8false: case INSTR_jump8True: case INSTR_jump16false: case INSTR_jump16True:
+        Move(RAX, REG_TOS);
+        Reload();
+        switch (pc[0])
+        {
+        case INSTR_jump8false:
+            ArithImm(ARITH_CMP, RAX, TRUE_VAL); JumpTo(CC_NE, next + pc[1]); break;
+        case INSTR_jump8True:
+            ArithImm(ARITH_CMP, RAX, FALSE_VAL); JumpTo(CC_NE, next + pc[1]); break;
+        case INSTR_jump16false:
+            ArithImm(ARITH_CMP, RAX, TRUE_VAL); JumpTo(CC_NE, next + arg1); break;
+        case INSTR_jump16True:
+            ArithImm(ARITH_CMP, RAX, TRUE_VAL); JumpTo(CC_E, next + arg1); break;
+        }
+        return true;
+
+    case INSTR_jump_back8: case INSTR_jump_back16:
+    {
+        // Check for an interrupt or a request to stop.  The interpreter deals with it.
+        POLYCODEPTR target = pc[0] == INSTR_jump_back8 ? pc - pc[1] : pc - arg1;
+        Load(RAX, REG_LIMIT, 0);
+        OpRR(0x39, RAX, REG_SP); // cmp rbx,rax
+        JumpToExit(CC_B, pc);
+        JumpTo(CC_ALWAYS, target);
+        entryPoints.push_back(target);
+        return true;
+    }
+
+    case INSTR_case16:
+    {
+        // Offsets in the byte code table are relative to the start of the table.
+        POLYCODEPTR table = pc + 3;
+        Move(RAX, REG_TOS);
+        Untag(RAX, true);
+        Reload();
+        ArithImm(ARITH_CMP, RAX, arg1);
+        JumpTo(CC_AE, next); // Default is after the table.  This is an unsigned test so it includes negative values.
+        // lea rcx,[rip+table]; movsxd rdx,dword [rcx+rax*4]; add rdx,rcx; jmp rdx
+        RexW(RCX, 0, 0); Byte(0x8d); ModRM(0, RCX, RBP);
+        size_t leaPos = Pos();
+        Word32(0);
+        OpRMIndex(0x63, RDX, RCX, RAX, 2, 0);
+        OpRR(0x01, RCX, RDX);
+        Byte(0xff); ModRM(3, 4, RDX);
+        size_t tableBase = Pos();
+        Patch32(leaPos, (int32_t)(tableBase - (leaPos + 4)));
+        for (unsigned i = 0; i < arg1; i++)
+        {
+            tableEntries.push_back(TableFixup(Pos(), tableBase, table + table[i * 2] + table[i * 2 + 1] * 256));
+            Word32(0);
+        }
+        return true;
+    }
+
+    case INSTR_local_w: PushLocal(arg1); return true;
+    case INSTR_local_b: PushLocal(pc[1]); return true;
+    case INSTR_local_b_b: PushLocal(pc[1]); PushLocal(pc[2]); return true;
+    case INSTR_local_0: case INSTR_local_1: case INSTR_local_2: case INSTR_local_3:
+    case INSTR_local_4: case INSTR_local_5: case INSTR_local_6: case INSTR_local_7:
+    case INSTR_local_8: case INSTR_local_9: case INSTR_local_10: case INSTR_local_11:
+        PushLocal(pc[0] - INSTR_local_0); return true;
+    case INSTR_local_12: PushLocal(12); return true;
+    case INSTR_local_13: case INSTR_local_14: case INSTR_local_15:
+        PushLocal(pc[0] - INSTR_local_13 + 13); return true;
+
+    case INSTR_const_int_b: PushConst(TAGGED_VAL(pc[1])); return true;
+    case INSTR_const_int_w: PushConst(TAGGED_VAL(arg1)); return true;
+    case INSTR_const_0: case INSTR_const_1: case INSTR_const_2: case INSTR_const_3: case INSTR_const_4:
+        PushConst(TAGGED_VAL(pc[0] - INSTR_const_0)); return true;
+    case INSTR_const_10: PushConst(TAGGED_VAL(10)); return true;
+
+    case INSTR_constAddr8: PushConstAddr((PolyWord*)(pc + pc[1] + 2)); return true;
+    case INSTR_constAddr16: PushConstAddr((PolyWord*)(pc + arg1 + 3)); return true;
+    case INSTR_constAddr8_8: PushConstAddr((PolyWord*)(pc + pc[1] + 3) + pc[2] + 3); return true;
+    case INSTR_constAddr8_0: PushConstAddr((PolyWord*)(pc + pc[1] + 2) + 3); return true;
+    case INSTR_constAddr8_1: PushConstAddr((PolyWord*)(pc + pc[1] + 2) + 4); return true;
+    case INSTR_constAddr16_8: PushConstAddr((PolyWord*)(pc + arg1 + 4) + pc[3] + 3); return true;
+
+    case INSTR_indirect_b: Load(REG_TOS, REG_TOS, pc[1] * word); return true;
+    case INSTR_indirect_0: case INSTR_indirect_1: case INSTR_indirect_2:
+    case INSTR_indirect_3: case INSTR_indirect_4: case INSTR_indirect_5:
+        Load(REG_TOS, REG_TOS, (pc[0] - INSTR_indirect_0) * word); return true;
+    case INSTR_indirectContainerB: Load(REG_TOS, REG_TOS, pc[1] * word); return true;
+
+    case INSTR_indirectLocalBB:
+        Spill(); Load(RAX, REG_SP, pc[1] * word); Load(REG_TOS, RAX, pc[2] * word); return true;
+    case INSTR_indirectLocalB0:
+        Spill(); Load(RAX, REG_SP, pc[1] * word); Load(REG_TOS, RAX, 0); return true;
+    case INSTR_indirectLocalB1:
+        Spill(); Load(RAX, REG_SP, pc[1] * word); Load(REG_TOS, RAX, word); return true;
+    case INSTR_indirect0Local0:
+        Spill(); Load(REG_TOS, REG_TOS, 0); return true;
+    case INSTR_indirectClosureBB:
+        Spill(); Load(RAX, REG_SP, pc[1] * word); Load(REG_TOS, RAX, (pc[2] + closureOffset) * word); return true;
+    case INSTR_indirectClosureB0: case INSTR_indirectClosureB1: case INSTR_indirectClosureB2:
+    {
+        unsigned n = pc[0] == INSTR_indirectClosureB0 ? 0 : pc[0] == INSTR_indirectClosureB1 ? 1 : 2;
+        Spill(); Load(RAX, REG_SP, pc[1] * word); Load(REG_TOS, RAX, (n + closureOffset) * word);
+        return true;
+    }
+
+    case INSTR_moveToContainerB:
+        Move(RAX, REG_TOS); Reload(); Store(REG_TOS, pc[1] * word, RAX); return true;
+    case INSTR_moveToMutClosureB:
+        Move(RAX, REG_TOS); Reload(); Store(REG_TOS, (pc[1] + closureOffset) * word, RAX); return true;
+
+    case INSTR_set_stack_val_b:
+        if (pc[1] == 0) break;
+        Store(REG_SP, (pc[1] - 1) * word, REG_TOS); Reload(); return true;
+    case INSTR_reset_b:
+        if (pc[1] == 0) break;
+        Load(REG_TOS, REG_SP, (pc[1] - 1) * word); Pop(pc[1]); return true;
+    case INSTR_reset_r_b: Pop(pc[1]); return true;
+    case INSTR_reset_1: Reload(); return true;
+    case INSTR_reset_2: Load(REG_TOS, REG_SP, word); Pop(2); return true;
+    case INSTR_reset_r_1: Pop(1); return true;
+    case INSTR_reset_r_2: Pop(2); return true;
+    case INSTR_reset_r_3: Pop(3); return true;
+
+    case INSTR_stack_containerB:
+    {
+        unsigned words = pc[1];
+        Spill();
+        if (words != 0) ArithImm(ARITH_SUB, REG_SP, words * word);
+        LoadImm(RAX, TAGGED_VAL(0));
+        for (unsigned i = 0; i < words; i++) Store(REG_SP, i * word, RAX);
+        Move(REG_TOS, REG_SP);
+        return true;
+    }
+
+    case INSTR_notBoolean:
+        ArithImm(ARITH_CMP, REG_TOS, TRUE_VAL); SetBool(CC_NE, REG_TOS); return true;
+    case INSTR_isTagged:
+        TestImm(REG_TOS, 1); SetBool(CC_NE, REG_TOS); return true;
+    case INSTR_cellLength:
+        Load(RAX, REG_TOS, -(int32_t)word);
+        Shift(SHIFT_SHL, RAX, 8); Shift(SHIFT_SHR, RAX, 8);
+        TagToTos(RAX);
+        return true;
+    case INSTR_cellFlags:
+        // The flags are in the top byte of the length word.
+        RexOpt(RAX, 0, REG_TOS); Byte(0x0f); Byte(0xb6); Mem(RAX, REG_TOS, -1); // movzx eax,byte [r12-1]
+        TagToTos(RAX);
+        return true;
+
+    case INSTR_equalWord: Compare(CC_E); return true;
+    case INSTR_lessSigned: Compare(CC_L); return true;
+    case INSTR_lessUnsigned: Compare(CC_B); return true;
+    case INSTR_lessEqSigned: Compare(CC_LE); return true;
+    case INSTR_lessEqUnsigned: Compare(CC_BE); return true;
+    case INSTR_greaterSigned: Compare(CC_G); return true;
+    case INSTR_greaterUnsigned: Compare(CC_A); return true;
+    case INSTR_greaterEqSigned: Compare(CC_GE); return true;
+    case INSTR_greaterEqUnsigned: Compare(CC_AE); return true;
+
+    case INSTR_jumpNotEqualWord: CompareJump(CC_E, next + pc[1]); return true;
+    case INSTR_jumpNotLessSigned: CompareJump(CC_L, next + pc[1]); return true;
+    case INSTR_jumpNotLessUnsigned: CompareJump(CC_B, next + pc[1]); return true;
+    case INSTR_jumpNotLessEqSigned: CompareJump(CC_LE, next + pc[1]); return true;
+    case INSTR_jumpNotLessEqUnsigned: CompareJump(CC_BE, next + pc[1]); return true;
+    case INSTR_jumpNotGreaterSigned: CompareJump(CC_G, next + pc[1]); return true;
+    case INSTR_jumpNotGreaterUnsigned: CompareJump(CC_A, next + pc[1]); return true;
+    case INSTR_jumpNotGreaterEqSigned: CompareJump(CC_GE, next + pc[1]); return true;
+    case INSTR_jumpNotGreaterEqUnsigned: CompareJump(CC_AE, next + pc[1]); return true;
+
+    case INSTR_jumpNEqLocal:
+        LoadLocalNoPush(RAX, pc[1]);
+        ArithImm(ARITH_CMP, RAX, TAGGED_VAL(pc[2]));
+        JumpTo(CC_NE, next + pc[3]);
+        return true;
+    case INSTR_jumpNEqLocalInd:
+        LoadLocalNoPush(RAX, pc[1]);
+        Load(RAX, RAX, 0);
+        ArithImm(ARITH_CMP, RAX, TAGGED_VAL(pc[2]));
+        JumpTo(CC_NE, next + pc[3]);
+        return true;
+    case INSTR_jumpTaggedLocal:
+        LoadLocalNoPush(RAX, pc[1]);
+        TestImm(RAX, 1);
+        JumpTo(CC_NE, next + pc[2]);
+        return true;
+    case INSTR_isTaggedLocalB:
+        Spill();
+        Load(RAX, REG_SP, pc[1] * word);
+        TestImm(RAX, 1);
+        SetBool(CC_NE, REG_TOS);
+        return true;
+
+    case INSTR_fixedAdd:
+        // Adding the tagged values and removing one tag overflows exactly when the result cannot be tagged.
+        Load(RAX, REG_SP, 0);
+        ArithImm(ARITH_SUB, RAX, 1);
+        OpRR(0x01, REG_TOS, RAX);
+        JumpToExit(CC_O, pc);
+        Pop(1);
+        Move(REG_TOS, RAX);
+        return true;
+    case INSTR_fixedSub:
+        Load(RAX, REG_SP, 0);
+        OpRR(0x29, REG_TOS, RAX);
+        JumpToExit(CC_O, pc);
+        Lea(REG_TOS, RAX, 1);
+        Pop(1);
+        return true;
+    case INSTR_arbAdd: case INSTR_arbSubtract:
+        // If either is long or there is an overflow let the interpreter deal with it.
+        Load(RAX, REG_SP, 0);
+        Move(RCX, RAX);
+        OpRR(0x21, REG_TOS, RCX);
+        TestImm(RCX, 1);
+        JumpToExit(CC_E, pc);
+        if (pc[0] == INSTR_arbAdd)
+        {
+            ArithImm(ARITH_SUB, RAX, 1);
+            OpRR(0x01, REG_TOS, RAX);
+            JumpToExit(CC_O, pc);
+            Move(REG_TOS, RAX);
+        }
+        else
+        {
+            OpRR(0x29, REG_TOS, RAX);
+            JumpToExit(CC_O, pc);
+            Lea(REG_TOS, RAX, 1);
+        }
+        Pop(1);
+        entryPoints.push_back(next); // The interpreter continues after the long case.
+        return true;
+    case INSTR_fixedQuot: case INSTR_fixedRem:
+        // Zero and overflow are checked for in ML.
+        Move(RCX, REG_TOS);
+        Untag(RCX, true);
+        Load(RAX, REG_SP, 0);
+        Untag(RAX, true);
+        Byte(0x48); Byte(0x99); // cqo
+        RexW(0, 0, RCX); Byte(0xf7); ModRM(3, 7, RCX); // idiv rcx
+        Pop(1);
+        TagToTos(pc[0] == INSTR_fixedQuot ? RAX : RDX);
+        return true;
+
+    case INSTR_wordAdd:
+        Load(RAX, REG_SP, 0); Pop(1); LeaIndex(REG_TOS, RAX, REG_TOS, -1); return true;
+    case INSTR_wordSub:
+        Load(RAX, REG_SP, 0); Pop(1); OpRR(0x29, REG_TOS, RAX); Lea(REG_TOS, RAX, 1); return true;
+    case INSTR_wordAddConstB: ArithImm(ARITH_ADD, REG_TOS, pc[1] * 2); return true;
+    case INSTR_wordSubConstB: ArithImm(ARITH_SUB, REG_TOS, pc[1] * 2); return true;
+    case INSTR_wordMult:
+        Load(RAX, REG_SP, 0); Pop(1); Untag(RAX, false);
+        Move(RCX, REG_TOS); Untag(RCX, false);
+        RexW(RAX, 0, RCX); Byte(0x0f); Byte(0xaf); ModRM(3, RAX, RCX); // imul rax,rcx
+        TagToTos(RAX);
+        return true;
+    case INSTR_wordDiv: case INSTR_wordMod:
+        // Zero is checked for in ML.
+        Move(RCX, REG_TOS); Untag(RCX, false);
+        Load(RAX, REG_SP, 0); Untag(RAX, false);
+        Byte(0x31); ModRM(3, RDX, RDX); // xor edx,edx
+        RexW(0, 0, RCX); Byte(0xf7); ModRM(3, 6, RCX); // div rcx
+        Pop(1);
+        TagToTos(pc[0] == INSTR_wordDiv ? RAX : RDX);
+        return true;
+    case INSTR_wordAnd: OpRM(0x23, REG_TOS, REG_SP, 0); Pop(1); return true;
+    case INSTR_wordOr: OpRM(0x0b, REG_TOS, REG_SP, 0); Pop(1); return true;
+    case INSTR_wordXor: OpRM(0x33, REG_TOS, REG_SP, 0); Pop(1); ArithImm(ARITH_OR, REG_TOS, 1); return true;
+    case INSTR_wordShiftLeft: case INSTR_wordShiftRLog:
+        // Shifts of a word or more are dealt with in ML.
+        Move(RCX, REG_TOS); Untag(RCX, false);
+        Load(RAX, REG_SP, 0); Pop(1); Untag(RAX, false);
+        ShiftCL(pc[0] == INSTR_wordShiftLeft ? SHIFT_SHL : SHIFT_SHR, RAX);
+        TagToTos(RAX);
+        return true;
+
+    case INSTR_loadMLWord:
+        Move(RAX, REG_TOS); Untag(RAX, true); Reload();
+        OpRMIndex(0x8b, REG_TOS, REG_TOS, RAX, 3, 0);
+        return true;
+    case INSTR_loadMLByte:
+        Move(RAX, REG_TOS); Untag(RAX, true); Reload();
+        RexOpt(RAX, RAX, REG_TOS); Byte(0x0f); Byte(0xb6); MemIndex(RAX, REG_TOS, RAX, 0, 0); // movzx eax,byte [r12+rax]
+        TagToTos(RAX);
+        return true;
+    case INSTR_loadUntagged:
+        Move(RAX, REG_TOS); Untag(RAX, true); Reload();
+        OpRMIndex(0x8b, RAX, REG_TOS, RAX, 3, 0);
+        TagToTos(RAX);
+        return true;
+    case INSTR_storeMLWord: case INSTR_storeUntagged: case INSTR_storeMLByte:
+        Load(RAX, REG_SP, 0); Untag(RAX, true); // Index
+        Load(RCX, REG_SP, word); // Base
+        Pop(2);
+        if (pc[0] == INSTR_storeMLWord)
+            OpRMIndex(0x89, REG_TOS, RCX, RAX, 3, 0);
+        else
+        {
+            Move(RDX, REG_TOS);
+            Untag(RDX, pc[0] == INSTR_storeMLByte);
+            if (pc[0] == INSTR_storeUntagged)
+                OpRMIndex(0x89, RDX, RCX, RAX, 3, 0);
+            else { Byte(0x88); MemIndex(RDX, RCX, RAX, 0, 0); } // mov [rcx+rax],dl
+        }
+        LoadImm(REG_TOS, TAGGED_VAL(0));
+        return true;
+
+    case INSTR_no_op: return true;
+    }
+    // No template.  Return to the interpreter to execute this.
+    ExitTo(pc);
+    return false;
+}
+
+bool JitCompiler::CompileCode(void)
+{
+    entryPoints.push_back(start);
+    POLYCODEPTR pc = start;
+    while (pc < end)
+    {
+        unsigned len = instructionLength(pc, end);
+        if (len == 0) break; // Unknown or padding at the end.
+        nativeOffset[pc - start] = (long)Pos();
+        bool native = CompileInstruction(pc, len);
+        isNative[pc - start] = native;
+        if (!native)
+        {
+            // The interpreter will enter the native code again after this instruction
+            // or at the handler or jump target.
+            POLYCODEPTR next = pc + len;
+            entryPoints.push_back(next);
+            switch (pc[0])
+            {
+            case INSTR_setHandler8: entryPoints.push_back(handlerEntry(next + pc[1])); break;
+            case INSTR_setHandler16: entryPoints.push_back(handlerEntry(next + pc[1] + pc[2] * 256)); break;
+            case INSTR_escape:
+                switch (pc[1])
+                {
+                case EXTINSTR_jump32True: case EXTINSTR_jump32False: case EXTINSTR_jump32: case EXTINSTR_setHandler32:
+                {
+                    int32_t offset = (int32_t)(pc[2] | (pc[3] << 8) | (pc[4] << 16) | ((uint32_t)pc[5] << 24));
+                    POLYCODEPTR target = next + offset;
+                    entryPoints.push_back(pc[1] == EXTINSTR_setHandler32 ? handlerEntry(target) : target);
+                    break;
+                }
+                case EXTINSTR_case32:
+                {
+                    unsigned cases = pc[2] + pc[3] * 256;
+                    POLYCODEPTR table = pc + 4;
+                    for (unsigned i = 0; i < cases; i++)
+                        entryPoints.push_back(table + (table[i * 4] | (table[i * 4 + 1] << 8) |
+                            (table[i * 4 + 2] << 16) | ((uint32_t)table[i * 4 + 3] << 24)));
+                    break;
+                }
+                }
+                break;
+            }
+        }
+        pc += len;
+    }
+    if (pc == start) return false;
+
+    // Jumps to byte code that has not been compiled go to the interpreter.
+    for (std::vector<Fixup>::iterator i = jumps.begin(); i != jumps.end(); i++)
+    {
+        if (i->target >= start && i->target < end && nativeOffset[i->target - start] >= 0)
+            SetJumpTarget(i->pos, nativeOffset[i->target - start]);
+        else exits.push_back(*i);
+    }
+    // The exits are out of line.  There is one for each byte code address.
+    std::map<POLYCODEPTR, size_t> exitStubs;
+    for (std::vector<Fixup>::iterator i = exits.begin(); i != exits.end(); i++)
+    {
+        std::map<POLYCODEPTR, size_t>::iterator stub = exitStubs.find(i->target);
+        if (stub == exitStubs.end())
+        {
+            exitStubs[i->target] = Pos();
+            SetJumpTarget(i->pos, Pos());
+            ExitTo(i->target);
+        }
+        else SetJumpTarget(i->pos, stub->second);
+    }
+    for (std::vector<TableFixup>::iterator i = tableEntries.begin(); i != tableEntries.end(); i++)
+    {
+        size_t dest;
+        if (i->target >= start && i->target < end && nativeOffset[i->target - start] >= 0)
+            dest = nativeOffset[i->target - start];
+        else
+        {
+            std::map<POLYCODEPTR, size_t>::iterator stub = exitStubs.find(i->target);
+            if (stub == exitStubs.end())
+            {
+                dest = exitStubs[i->target] = Pos();
+                ExitTo(i->target);
+            }
+            else dest = stub->second;
+        }
+        Patch32(i->pos, (int32_t)(dest - i->base));
+    }
+    // Return to the interpreter with the byte code address in rax.  The
+    // callee-save registers were pushed by the trampoline.
+    size_t epilogue = Pos();
+    Store(REG_STATE, offsetof(ByteCodeJitState, sp), REG_SP);
+    Store(REG_STATE, offsetof(ByteCodeJitState, tos), REG_TOS);
+    Byte(0x41); Byte(0x58 + (R15 & 7)); // pop r15
+    Byte(0x41); Byte(0x58 + (R14 & 7)); // pop r14
+    Byte(0x41); Byte(0x58 + (R13 & 7)); // pop r13
+    Byte(0x41); Byte(0x58 + (R12 & 7)); // pop r12
+    Byte(0x58 + RBP); // pop rbp
+    Byte(0x58 + RBX); // pop rbx
+    Byte(0xc3); // ret
+    for (std::vector<size_t>::iterator i = epilogueJumps.begin(); i != epilogueJumps.end(); i++)
+        SetJumpTarget(*i, epilogue);
+    return true;
+}
+
+} // namespace
+
+ByteCodeJit *ByteCodeJit::Create(void)
+{
+    if (byteCodeJitThreshold == 0) return 0;
+    ByteCodeJit *jit = new ByteCodeJit;
+    if (!jit->NewChunk(JIT_CHUNK_SIZE))
+    {
+        delete jit;
+        return 0;
+    }
+    // The trampoline is the entry from C.  It saves the callee-save
+    // registers, loads the state and jumps to the native code.
+    JitAssembler a;
+    a.Byte(0x50 + RBX); // push rbx
+    a.Byte(0x50 + RBP); // push rbp
+    a.Byte(0x41); a.Byte(0x50 + (R12 & 7)); // push r12
+    a.Byte(0x41); a.Byte(0x50 + (R13 & 7)); // push r13
+    a.Byte(0x41); a.Byte(0x50 + (R14 & 7)); // push r14
+    a.Byte(0x41); a.Byte(0x50 + (R15 & 7)); // push r15
+    a.Move(REG_STATE, RDI);
+    a.Load(REG_SP, REG_STATE, offsetof(ByteCodeJitState, sp));
+    a.Load(REG_TOS, REG_STATE, offsetof(ByteCodeJitState, tos));
+    a.Load(REG_LIMIT, REG_STATE, offsetof(ByteCodeJitState, stackLimit));
+    a.Byte(0xff); a.ModRM(3, 4, RSI); // jmp rsi
+    void *t = jit->AllocateCode(a.code.size());
+    memcpy(t, &a.code[0], a.code.size());
+    jit->trampoline = (POLYCODEPTR (*)(ByteCodeJitState *, void *))t;
+    jit->codeStart = jit->allocPtr;
+    return jit;
+}
+
+ByteCodeJit::ByteCodeJit(): generation(byteCodeJitGeneration), allocPtr(0), allocLimit(0), codeStart(0), totalCode(0), trampoline(0)
+{
+    memset(table, 0, sizeof(table));
+}
+
+ByteCodeJit::~ByteCodeJit()
+{
+    for (std::map<PolyObject*, CompiledCode*>::iterator i = compiled.begin(); i != compiled.end(); i++)
+        delete i->second;
+    for (std::vector<Chunk>::iterator i = chunks.begin(); i != chunks.end(); i++)
+        munmap(i->base, i->size);
+}
+
+bool ByteCodeJit::NewChunk(size_t size)
+{
+    void *mem = mmap(0, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    Chunk c;
+    c.base = (byte*)mem;
+    c.size = size;
+    chunks.push_back(c);
+    allocPtr = c.base;
+    allocLimit = c.base + size;
+    return true;
+}
+
+void *ByteCodeJit::AllocateCode(size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    if (allocPtr + size > allocLimit)
+    {
+        if (size > JIT_CHUNK_SIZE || totalCode + JIT_CHUNK_SIZE > JIT_MAX_CODE || !NewChunk(JIT_CHUNK_SIZE))
+            return 0;
+        totalCode += JIT_CHUNK_SIZE;
+    }
+    void *result = allocPtr;
+    allocPtr += size;
+    return result;
+}
+
+// Discard all the compiled code except the trampoline at the start of the first chunk.
+void ByteCodeJit::Flush(void)
+{
+    generation = byteCodeJitGeneration;
+    memset(table, 0, sizeof(table));
+    for (std::map<PolyObject*, CompiledCode*>::iterator i = compiled.begin(); i != compiled.end(); i++)
+        delete i->second;
+    compiled.clear();
+    for (std::vector<Chunk>::iterator i = chunks.begin() + 1; i < chunks.end(); i++)
+        munmap(i->base, i->size);
+    chunks.resize(1);
+    allocPtr = codeStart;
+    allocLimit = chunks[0].base + chunks[0].size;
+    totalCode = 0;
+}
+
+void *ByteCodeJit::LookupSlow(POLYCODEPTR pc, Entry *e)
+{
+    if (e->pc != pc)
+    {
+        // Start counting this unless the entry has native code.
+        if (e->native == 0)
+        {
+            e->pc = pc;
+            e->count = 1;
+        }
+        return 0;
+    }
+    // It has reached the threshold.
+    e->count = 0;
+    PolyObject *code = gMem.FindCodeObject(pc);
+    if (code == 0 || !code->IsCodeObject() || code->IsMutable()) return 0;
+    CompiledCode *c;
+    std::map<PolyObject*, CompiledCode*>::iterator i = compiled.find(code);
+    if (i == compiled.end())
+        c = compiled[code] = Compile(code);
+    else c = i->second;
+    // Add the entries to the table.  This may replace others that are then
+    // added again if they are needed.
+    for (std::map<POLYCODEPTR, void*>::iterator j = c->entries.begin(); j != c->entries.end(); j++)
+    {
+        Entry *f = &table[((uintptr_t)j->first ^ ((uintptr_t)j->first >> 12)) & (JIT_TABLE_SIZE - 1)];
+        f->pc = j->first;
+        f->native = j->second;
+        f->count = 0;
+    }
+    std::map<POLYCODEPTR, void*>::iterator k = c->entries.find(pc);
+    return k == c->entries.end() ? 0 : k->second;
+}
+
+ByteCodeJit::CompiledCode *ByteCodeJit::Compile(PolyObject *code)
+{
+    CompiledCode *result = new CompiledCode;
+    // The byte code is followed by the constants.  The first word before the constants is the count.
+    PolyWord *cp;
+    POLYUNSIGNED count;
+    machineDependent->GetConstSegmentForCode(code, cp, count);
+    POLYCODEPTR start = (POLYCODEPTR)code, end = (POLYCODEPTR)(cp - 1);
+    if (end <= start || end > (POLYCODEPTR)code->Offset(code->Length()))
+        return result;
+    JitCompiler compiler(start, end);
+    if (!compiler.CompileCode())
+        return result;
+    byte *native = (byte*)AllocateCode(compiler.code.size());
+    if (native == 0)
+        return result;
+    memcpy(native, &compiler.code[0], compiler.code.size());
+    // Only instructions with templates are used as entry points.  There's
+    // no point in entering if the first thing is to return to the interpreter.
+    for (std::vector<POLYCODEPTR>::iterator i = compiler.entryPoints.begin(); i != compiler.entryPoints.end(); i++)
+    {
+        POLYCODEPTR pc = *i;
+        if (pc >= start && pc < end && compiler.nativeOffset[pc - start] >= 0 && compiler.isNative[pc - start])
+            result->entries[pc] = native + compiler.nativeOffset[pc - start];
+    }
+    return result;
+}
+
+#else
+
+// Not available on this platform.
+ByteCodeJit *ByteCodeJit::Create(void) { return 0; }
+ByteCodeJit::~ByteCodeJit() {}
+void ByteCodeJit::Flush(void) {}
+void *ByteCodeJit::LookupSlow(POLYCODEPTR, Entry *) { return 0; }
+
+#endif
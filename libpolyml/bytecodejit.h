@@ -0,0 +1,134 @@
+/*
+    Title:      bytecodejit.h - Tiered compilation of byte code to native code
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef BYTECODEJIT_H_INCLUDED
+#define BYTECODEJIT_H_INCLUDED
+
+#include "globals.h"
+
+#include <map>
+#include <vector>
+
+// When the run-time system is built without a native code generator the
+// byte code interpreter runs everything.  With --jit the interpreter counts
+// the number of times each function is entered and each loop head is reached
+// and once that passes the threshold the whole code object is translated to
+// native code with one template for each byte code instruction.  Calls,
+// returns, allocation and anything else that needs the RTS are left to the
+// interpreter.  The compiled code returns to the interpreter at these with
+// the byte code address to continue from and the interpreter enters the
+// compiled code again at the next instruction.
+//
+// The compiled code keeps the ML stack in exactly the same form as the
+// interpreter: the top item in a register and the rest in memory, so
+// moving between the two is just a matter of copying sp, tos and pc.
+// Currently the templates are only provided for X86-64 on Unix.
+#if (defined(__x86_64__) && defined(__GNUC__) && !defined(_WIN32) && !defined(POLYML32IN64))
+#define HAVE_BYTECODE_JIT 1
+#endif
+
+// Set from --jit.  Zero if the JIT is not used.
+extern unsigned byteCodeJitThreshold;
+
+// Incremented whenever code objects may have been freed or replaced.  Each
+// thread discards its compiled code if this has changed.  This is only
+// changed while the ML threads are stopped.
+extern unsigned byteCodeJitGeneration;
+inline void byteCodeJitInvalidate(void) { byteCodeJitGeneration++; }
+
+// The interpreter state passed to and from the compiled code.
+struct ByteCodeJitState {
+    stackItem   *sp;
+    stackItem   tos;
+    stackItem   **stackLimit;
+};
+
+class ByteCodeJit
+{
+public:
+    // Returns zero if the JIT is not enabled or cannot be used.
+    static ByteCodeJit *Create(void);
+    ~ByteCodeJit();
+
+    // Return the native code for this byte code address or zero if there is
+    // none.  Function entries and loop heads are counted and may trigger
+    // compilation.  Other addresses are only looked up.
+    void *Lookup(POLYCODEPTR pc, bool count)
+    {
+        if (generation != byteCodeJitGeneration)
+            Flush();
+        Entry *e = &table[((uintptr_t)pc ^ ((uintptr_t)pc >> 12)) & (JIT_TABLE_SIZE - 1)];
+        if (e->pc == pc)
+        {
+            if (e->native != 0) return e->native;
+            if (!count || ++e->count < byteCodeJitThreshold) return 0;
+        }
+        else if (!count) return 0;
+        return LookupSlow(pc, e);
+    }
+
+    // Run native code until it returns to the interpreter.  Updates
+    // the state and returns the byte code address to continue from.
+    POLYCODEPTR Run(void *native, ByteCodeJitState *state)
+    {
+        return trampoline(state, native);
+    }
+
+private:
+    ByteCodeJit();
+
+    enum { JIT_TABLE_SIZE = 4096 };
+
+    // Direct-mapped table of byte code addresses.  An entry either has
+    // native code or is counting towards the threshold.
+    struct Entry {
+        POLYCODEPTR pc;
+        void        *native;
+        unsigned    count;
+    };
+
+    // The result of compiling a code object.  The entry points are the
+    // addresses at which the interpreter may enter the native code.
+    // If the code could not be compiled there are no entries.
+    struct CompiledCode {
+        std::map<POLYCODEPTR, void*> entries;
+    };
+
+    void *LookupSlow(POLYCODEPTR pc, Entry *e);
+    CompiledCode *Compile(PolyObject *code);
+    void *AllocateCode(size_t size);
+    bool NewChunk(size_t size);
+    void Flush(void);
+
+    Entry table[JIT_TABLE_SIZE];
+    unsigned generation;
+    std::map<PolyObject*, CompiledCode*> compiled;
+
+    // The native code is allocated sequentially in chunks.
+    struct Chunk { byte *base; size_t size; };
+    std::vector<Chunk> chunks;
+    byte *allocPtr, *allocLimit;
+    byte *codeStart; // After the trampoline in the first chunk.
+    size_t totalCode;
+
+    POLYCODEPTR (*trampoline)(ByteCodeJitState *, void *);
+};
+
+#endif
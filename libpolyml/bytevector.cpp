@@ -0,0 +1,343 @@
+/*
+    Title:      Search, comparison and hashing of byte vectors.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/*
+Strings and Word8Vector.vector values are byte objects with the length in the
+first word.  The functions here work on a range of the bytes that follow it.
+They are called with rtsCallFast so they do not allocate and the objects cannot
+be moved by the garbage collector while they run.  The ranges have been checked
+in ML.
+
+The versions of memchr and memcmp in the C library are already vectorised and
+usually select the code for the particular processor when the library is
+loaded so they are used for finding a byte and for comparison.  Searching for a
+substring compares the first and last bytes of the pattern at sixteen or
+thirty-two positions at once and only compares the rest of the pattern where
+both match.  SSE2 is always available on X86-64 and AVX2 is used if the
+processor has it.  NEON is used on ARM64.  This is generally quicker than the
+SSE4.2 string instructions.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_WIN32)
+#include "winconfig.h"
+#else
+#error "No configuration file"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#if (defined(__x86_64__) || defined(_M_X64))
+#include <emmintrin.h>
+#define USE_SSE2_SEARCH 1
+#if (defined(__GNUC__) && defined(__x86_64__))
+#include <immintrin.h>
+#define USE_AVX2_SEARCH 1
+#endif
+#elif (defined(__aarch64__) && defined(__ARM_NEON))
+#include <arm_neon.h>
+#define USE_NEON_SEARCH 1
+#endif
+
+#if (defined(_MSC_VER))
+#include <intrin.h>
+#endif
+
+#include "globals.h"
+#include "bytevector.h"
+#include "polystring.h"
+#include "rtsentry.h"
+
+extern "C" {
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyByteVectorFind(POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length, POLYUNSIGNED ch);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyByteVectorSearch(POLYUNSIGNED pat, POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyByteVectorCompare(POLYUNSIGNED vec1, POLYUNSIGNED vec2, POLYUNSIGNED length);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyByteVectorEqual(POLYUNSIGNED vec1, POLYUNSIGNED vec2, POLYUNSIGNED start2, POLYUNSIGNED length);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyByteVectorHash(POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length);
+}
+
+// The address of the first byte of a string or byte vector.
+static inline const byte *vectorBytes(POLYUNSIGNED vec)
+{
+    return (const byte *)((PolyStringObject*)PolyWord::FromUnsigned(vec).AsObjPtr())->chars;
+}
+
+static inline unsigned lowestBit(uint32_t mask)
+{
+#if (defined(__GNUC__))
+    return (unsigned)__builtin_ctz(mask);
+#elif (defined(_MSC_VER))
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    unsigned index = 0;
+    while ((mask & 1) == 0) { mask >>= 1; index++; }
+    return index;
+#endif
+}
+
+// Search for the pattern of m bytes in the n bytes of text, starting at
+// position i.  Returns the position of the first match or n if there is none.
+// m is at least 2 and no more than n.  This is used for the positions that
+// are left over after the vector loops.
+static POLYUNSIGNED searchBytesFrom(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m, POLYUNSIGNED i)
+{
+    while (i + m <= n)
+    {
+        const byte *p = (const byte*)memchr(text + i, pat[0], n - m + 1 - i);
+        if (p == 0) break;
+        i = (POLYUNSIGNED)(p - text);
+        if (memcmp(p + 1, pat + 1, m - 1) == 0) return i;
+        i++;
+    }
+    return n;
+}
+
+typedef POLYUNSIGNED (*searchFunction)(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m);
+
+#if (defined(USE_SSE2_SEARCH))
+static POLYUNSIGNED searchBytesSSE2(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m)
+{
+    const __m128i first = _mm_set1_epi8((char)pat[0]);
+    const __m128i last = _mm_set1_epi8((char)pat[m-1]);
+    POLYUNSIGNED i = 0;
+    // Each iteration tests the sixteen positions from i.  The last bytes of
+    // the pattern would be at i+m-1 to i+m+14.
+    for (; i + m + 15 <= n; i += 16)
+    {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i*)(text + i));
+        __m128i blockLast = _mm_loadu_si128((const __m128i*)(text + i + m - 1));
+        uint32_t mask =
+            (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        while (mask != 0)
+        {
+            unsigned bit = lowestBit(mask);
+            if (memcmp(text + i + bit + 1, pat + 1, m - 2) == 0)
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return searchBytesFrom(text, n, pat, m, i);
+}
+#endif
+
+#if (defined(USE_AVX2_SEARCH))
+__attribute__((target("avx2")))
+static POLYUNSIGNED searchBytesAVX2(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m)
+{
+    const __m256i first = _mm256_set1_epi8((char)pat[0]);
+    const __m256i last = _mm256_set1_epi8((char)pat[m-1]);
+    POLYUNSIGNED i = 0;
+    for (; i + m + 31 <= n; i += 32)
+    {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i*)(text + i));
+        __m256i blockLast = _mm256_loadu_si256((const __m256i*)(text + i + m - 1));
+        uint32_t mask =
+            (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask != 0)
+        {
+            unsigned bit = lowestBit(mask);
+            if (memcmp(text + i + bit + 1, pat + 1, m - 2) == 0)
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return searchBytesFrom(text, n, pat, m, i);
+}
+#endif
+
+#if (defined(USE_NEON_SEARCH))
+static POLYUNSIGNED searchBytesNEON(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m)
+{
+    const uint8x16_t first = vdupq_n_u8(pat[0]);
+    const uint8x16_t last = vdupq_n_u8(pat[m-1]);
+    POLYUNSIGNED i = 0;
+    for (; i + m + 15 <= n; i += 16)
+    {
+        uint8x16_t matches =
+            vandq_u8(vceqq_u8(vld1q_u8(text + i), first), vceqq_u8(vld1q_u8(text + i + m - 1), last));
+        // There's no movemask in NEON.  Narrowing gives four bits for each byte.
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+        while (mask != 0)
+        {
+            unsigned bit = (unsigned)__builtin_ctzll(mask) / 4;
+            if (memcmp(text + i + bit + 1, pat + 1, m - 2) == 0)
+                return i + bit;
+            mask &= ~((uint64_t)0xf << (bit * 4));
+        }
+    }
+    return searchBytesFrom(text, n, pat, m, i);
+}
+#endif
+
+#if (!defined(USE_SSE2_SEARCH) && !defined(USE_NEON_SEARCH))
+static POLYUNSIGNED searchBytesScalar(const byte *text, POLYUNSIGNED n, const byte *pat, POLYUNSIGNED m)
+{
+    return searchBytesFrom(text, n, pat, m, 0);
+}
+#endif
+
+// Choose the search function when the library is loaded.
+static searchFunction chooseSearch()
+{
+#if (defined(USE_AVX2_SEARCH))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return searchBytesAVX2;
+#endif
+#if (defined(USE_SSE2_SEARCH))
+    return searchBytesSSE2;
+#elif (defined(USE_NEON_SEARCH))
+    return searchBytesNEON;
+#else
+    return searchBytesScalar;
+#endif
+}
+
+static const searchFunction searchBytes = chooseSearch();
+
+// Return the offset from start of the first occurrence of ch or -1 if there isn't one.
+POLYUNSIGNED PolyByteVectorFind(POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length, POLYUNSIGNED ch)
+{
+    const byte *base = vectorBytes(vec) + PolyWord::FromUnsigned(start).UnTaggedUnsigned();
+    POLYUNSIGNED n = PolyWord::FromUnsigned(length).UnTaggedUnsigned();
+    const byte *p = (const byte*)memchr(base, (int)PolyWord::FromUnsigned(ch).UnTaggedUnsigned(), n);
+    if (p == 0) return TAGGED(-1).AsUnsigned();
+    return TAGGED(p - base).AsUnsigned();
+}
+
+// Return the offset from start of the first occurrence of the whole of pat or -1.
+POLYUNSIGNED PolyByteVectorSearch(POLYUNSIGNED pat, POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length)
+{
+    const byte *text = vectorBytes(vec) + PolyWord::FromUnsigned(start).UnTaggedUnsigned();
+    POLYUNSIGNED n = PolyWord::FromUnsigned(length).UnTaggedUnsigned();
+    PolyStringObject *patString = (PolyStringObject*)PolyWord::FromUnsigned(pat).AsObjPtr();
+    const byte *patBytes = (const byte *)patString->chars;
+    POLYUNSIGNED m = patString->length;
+    POLYUNSIGNED result;
+    if (m == 0) result = 0;
+    else if (m > n) result = n;
+    else if (m == 1)
+    {
+        const byte *p = (const byte*)memchr(text, patBytes[0], n);
+        result = p == 0 ? n : (POLYUNSIGNED)(p - text);
+    }
+    else result = searchBytes(text, n, patBytes, m);
+    if (m != 0 && result == n) return TAGGED(-1).AsUnsigned();
+    return TAGGED(result).AsUnsigned();
+}
+
+// Compare the first length bytes of each.  Returns -1, 0 or 1.
+POLYUNSIGNED PolyByteVectorCompare(POLYUNSIGNED vec1, POLYUNSIGNED vec2, POLYUNSIGNED length)
+{
+    int res = memcmp(vectorBytes(vec1), vectorBytes(vec2), PolyWord::FromUnsigned(length).UnTaggedUnsigned());
+    return TAGGED(res < 0 ? -1 : res > 0 ? 1 : 0).AsUnsigned();
+}
+
+// Test whether the first length bytes of vec1 are the same as those from start2 in vec2.
+POLYUNSIGNED PolyByteVectorEqual(POLYUNSIGNED vec1, POLYUNSIGNED vec2, POLYUNSIGNED start2, POLYUNSIGNED length)
+{
+    int res = memcmp(vectorBytes(vec1), vectorBytes(vec2) + PolyWord::FromUnsigned(start2).UnTaggedUnsigned(),
+        PolyWord::FromUnsigned(length).UnTaggedUnsigned());
+    return TAGGED(res == 0 ? 1 : 0).AsUnsigned();
+}
+
+// A fast, non-cryptographic hash.  The bytes are read as little-endian 64-bit
+// words whatever the machine so the value does not depend on the byte order or
+// the word length.  Two multiply chains are interleaved for long vectors and
+// the result is mixed so that all the bits depend on all the input.
+#define HASH_MULTIPLIER 0x517cc1b727220a95ULL
+
+static inline uint64_t loadLittleEndian64(const byte *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#ifdef WORDS_BIGENDIAN
+    w = ((w & 0x00000000000000ffULL) << 56) | ((w & 0x000000000000ff00ULL) << 40) |
+        ((w & 0x0000000000ff0000ULL) << 24) | ((w & 0x00000000ff000000ULL) << 8) |
+        ((w & 0x000000ff00000000ULL) >> 8) | ((w & 0x0000ff0000000000ULL) >> 24) |
+        ((w & 0x00ff000000000000ULL) >> 40) | ((w & 0xff00000000000000ULL) >> 56);
+#endif
+    return w;
+}
+
+static inline uint64_t hashStep(uint64_t h, uint64_t w)
+{
+    return (((h << 5) | (h >> 59)) ^ w) * HASH_MULTIPLIER;
+}
+
+static uint64_t hashBytes(const byte *p, POLYUNSIGNED n)
+{
+    uint64_t h1 = (uint64_t)n, h2 = 0x9e3779b97f4a7c15ULL;
+    for (; n >= 16; p += 16, n -= 16)
+    {
+        h1 = hashStep(h1, loadLittleEndian64(p));
+        h2 = hashStep(h2, loadLittleEndian64(p + 8));
+    }
+    if (n >= 8)
+    {
+        h1 = hashStep(h1, loadLittleEndian64(p));
+        p += 8; n -= 8;
+    }
+    if (n != 0)
+    {
+        uint64_t w = 0;
+        for (POLYUNSIGNED i = 0; i < n; i++)
+            w |= (uint64_t)p[i] << (i * 8);
+        h2 = hashStep(h2, w);
+    }
+    uint64_t h = h1 ^ ((h2 << 32) | (h2 >> 32));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The result is limited to 30 bits so that it is always a short word.
+POLYUNSIGNED PolyByteVectorHash(POLYUNSIGNED vec, POLYUNSIGNED start, POLYUNSIGNED length)
+{
+    uint64_t h = hashBytes(vectorBytes(vec) + PolyWord::FromUnsigned(start).UnTaggedUnsigned(),
+        PolyWord::FromUnsigned(length).UnTaggedUnsigned());
+    return TAGGED((POLYUNSIGNED)(h & 0x3fffffff)).AsUnsigned();
+}
+
+struct _entrypts byteVectorEPT[] =
+{
+    { "PolyByteVectorFind",             (polyRTSFunction)&PolyByteVectorFind},
+    { "PolyByteVectorSearch",           (polyRTSFunction)&PolyByteVectorSearch},
+    { "PolyByteVectorCompare",          (polyRTSFunction)&PolyByteVectorCompare},
+    { "PolyByteVectorEqual",            (polyRTSFunction)&PolyByteVectorEqual},
+    { "PolyByteVectorHash",             (polyRTSFunction)&PolyByteVectorHash},
+
+    { NULL, NULL} // End of list.
+};
@@ -56,6 +56,7 @@
 #include "profiling.h"
 #include "heapsizing.h"
 #include "gc_progress.h"
+#include "tracing.h"
 
 static GCTaskFarm gTaskFarm; // Global task farm.
 GCTaskFarm *gpTaskFarm = &gTaskFarm;
@@ -103,7 +104,9 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
 {
     gHeapSizeParameters.RecordAtStartOfMajorGC();
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeStart);
+    globalStats.startGCTimer();
     globalStats.incCount(PSC_GC_FULLGC);
+    traceBegin(TRACE_GC_FULL);
 
     // Remove any empty spaces.  There will not normally be any except
     // if we have triggered a full GC as a result of detecting paging in the
@@ -118,10 +121,15 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
         gMem.ReportHeapSizes("Full GC (before)");
 
     // Data sharing pass.
-    if (gHeapSizeParameters.PerformSharingPass())
+    bool sharingPass = gHeapSizeParameters.PerformSharingPass();
+    if (sharingPass)
     {
         globalStats.incCount(PSC_GC_SHARING);
+        globalStats.startGCPhase();
+        traceBegin(TRACE_GC_SHARING);
         GCSharingPhase();
+        traceEnd(TRACE_GC_SHARING);
+        globalStats.endGCPhase(PST_GC_SHARE_RTIME);
     }
 
     gcProgressBeginMajorGC(); // The GC sharing phase is treated separately
@@ -136,6 +144,8 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
  * not match.
  */
     
+    globalStats.startGCPhase();
+    traceBegin(TRACE_GC_MARK);
     for (unsigned p = 3; p > 0; p--)
     {
         for(std::vector<LocalMemSpace*>::iterator i = gMem.lSpaces.begin(); i < gMem.lSpaces.end(); i++)
@@ -198,12 +208,18 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
 #endif
         lSpace->upperAllocPtr = lSpace->top;
     }
+    traceEnd(TRACE_GC_MARK);
+    globalStats.endGCPhase(PST_GC_MARK_RTIME);
 
 	gcProgressSetPercent(25);
 
     if (debugOptions & DEBUG_GC) Log("GC: Check weak refs\n");
     /* Detect unreferenced streams, windows etc. */
+    globalStats.startGCPhase();
+    traceBegin(TRACE_GC_WEAKREF);
     GCheckWeakRefs();
+    traceEnd(TRACE_GC_WEAKREF);
+    globalStats.endGCPhase(PST_GC_WEAKREF_RTIME);
 	gcProgressSetPercent(50);
 
     // Check that the heap is not overfull.  We make sure the marked
@@ -233,14 +249,22 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
     }
 
     /* Compact phase */
+    globalStats.startGCPhase();
+    traceBegin(TRACE_GC_COPY);
     GCCopyPhase();
+    traceEnd(TRACE_GC_COPY);
+    globalStats.endGCPhase(PST_GC_COPY_RTIME);
 
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeIntermediate, "Copy");
 	gcProgressSetPercent(75);
 
     // Update Phase.
     if (debugOptions & DEBUG_GC) Log("GC: Update\n");
+    globalStats.startGCPhase();
+    traceBegin(TRACE_GC_UPDATE);
     GCUpdatePhase();
+    traceEnd(TRACE_GC_UPDATE);
+    globalStats.endGCPhase(PST_GC_UPDATE_RTIME);
 
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeIntermediate, "Update");
 
@@ -306,6 +330,8 @@ static bool doGC(const POLYUNSIGNED wordsRequiredToAllocate)
 
     // End of garbage collection
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeEnd);
+    globalStats.recordGCPause(sharingPass ? PSH_SHARING_GC : PSH_MAJOR_GC);
+    traceEnd(TRACE_GC_FULL);
 
     // Now we've finished we can adjust the heap sizes.
     gHeapSizeParameters.AdjustSizeAfterMajorGC(wordsRequiredToAllocate);
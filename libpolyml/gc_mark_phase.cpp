@@ -79,6 +79,8 @@ Many of the ideas are drawn from Flood, Detlefs, Shavit and Zhang 2001
 #include "gctaskfarm.h"
 #include "profiling.h"
 #include "heapsizing.h"
+#include "perfmap.h"
+#include "bytecodejit.h"
 
 #define MARK_STACK_SIZE 3000
 #define LARGECACHE_SIZE 20
@@ -769,6 +771,7 @@ static void CheckMarksOnCodeTask(GCTaskId *, void *arg1, void *arg2)
 #endif
     PolyWord *lastFree = 0;
     POLYUNSIGNED lastFreeSpace = 0;
+    bool codeFreed = false;
     space->largestFree = 0;
     space->firstFree = 0;
     while (pt < space->top)
@@ -801,6 +804,7 @@ static void CheckMarksOnCodeTask(GCTaskId *, void *arg1, void *arg2)
         }
 #endif
         else { // Turn it into a byte area i.e. free.  It may already be free.
+            if (L & _OBJ_CODE_OBJ) codeFreed = true;
             if (space->firstFree == 0) space->firstFree = pt;
             space->headerMap.ClearBit(pt-space->bottom); // Remove the "header" bit
             if (lastFree + lastFreeSpace == pt)
@@ -817,6 +821,10 @@ static void CheckMarksOnCodeTask(GCTaskId *, void *arg1, void *arg2)
         }
         pt += length+1;
     }
+    if (codeFreed && perfMapEnabled)
+        perfMapCodeFreed();
+    if (codeFreed)
+        byteCodeJitInvalidate();
 }
 
 void GCMarkPhase(void)
@@ -861,6 +869,7 @@ void GCMarkPhase(void)
     gpTaskFarm->WaitForCompletion(); // Wait for completion of the bitmaps
 
     gMem.RemoveEmptyCodeAreas();
+    perfMapUpdate(); // Remove any freed code from the perf map.
 
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeIntermediate, "Bitmap");
 
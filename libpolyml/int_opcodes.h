@@ -42,6 +42,7 @@
 #define INSTR_callLocalB            0x16
 #define INSTR_callConstAddr8_8      0x17
 #define INSTR_callConstAddr16_8     0x18
+#define INSTR_local_b_b             0x19
 #define INSTR_constAddr16           0x1a // Legacy
 #define INSTR_const_int_w           0x1b
 #define INSTR_jump_back8            0x1e
@@ -99,6 +100,18 @@
 #define INSTR_constAddr8_1          0x56
 #define INSTR_callConstAddr8_0      0x57
 #define INSTR_callConstAddr8_1      0x58
+// Comparisons combined with jump8false.
+#define INSTR_jumpNotEqualWord          0x59
+#define INSTR_jumpNotLessSigned         0x5a
+#define INSTR_jumpNotLessUnsigned       0x5b
+#define INSTR_jumpNotLessEqSigned       0x5c
+#define INSTR_jumpNotLessEqUnsigned     0x5d
+#define INSTR_jumpNotGreaterSigned      0x5e
+#define INSTR_jumpNotGreaterUnsigned    0x5f
+#define INSTR_jumpNotGreaterEqSigned    0x60
+#define INSTR_jumpNotGreaterEqUnsigned  0x61
+#define INSTR_wordAddConstB             0x62
+#define INSTR_wordSubConstB             0x63
 #define INSTR_reset_r_1     0x64
 #define INSTR_reset_r_2     0x65
 #define INSTR_reset_r_3     0x66
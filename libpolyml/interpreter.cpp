@@ -52,6 +52,7 @@
 #include "scanaddrs.h"
 #include "rtsentry.h"
 #include "bytecode.h"
+#include "bytecodejit.h"
 
 /* the amount of ML stack space to reserve for registers,
    C exception handling etc. The compiler requires us to
@@ -63,7 +64,7 @@
 
 class IntTaskData: public TaskData, ByteCodeInterpreter {
 public:
-    IntTaskData() : ByteCodeInterpreter(&taskSp, &sl) {}
+    IntTaskData() : ByteCodeInterpreter(&taskSp, &sl) { byteCodeJit = ByteCodeJit::Create(); }
     ~IntTaskData() {}
 
     virtual void GarbageCollect(ScanAddress *process);
@@ -86,6 +87,7 @@ public:
     virtual uintptr_t currentStackSpace(void) const { return ((stackItem*)this->stack->top - this->taskSp) + OVERFLOW_STACK_SIZE; }
 
     virtual void addProfileCount(POLYUNSIGNED words) { addSynchronousCount(interpreterPc, words); }
+    virtual POLYCODEPTR GetProfileSite(stackItem *&sp) { sp = taskSp; return interpreterPc; }
 
     virtual void CopyStackFrame(StackObject *old_stack, uintptr_t old_length, StackObject *new_stack, uintptr_t new_length);
 
@@ -314,7 +316,7 @@ bool IntTaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace *space = gMem.SpaceForAddress(interpreterPc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(interpreterPc);
+            incrementCountAsynch(this, interpreterPc, taskSp);
             return true;
         }
     }
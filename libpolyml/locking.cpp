@@ -70,12 +70,82 @@
 #include <stdio.h>
 #endif
 
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
 #include "locking.h"
 #include "diagnostics.h"
 
 // Report contended locks after this many attempts
 #define LOCK_REPORT_COUNT   50
 
+bool PLock::holdTiming = false;
+
+// List of named locks and the accumulated statistics of named locks that have
+// been deleted.  Locks may be created during static initialisation so these
+// must not require constructors.
+struct RetiredLock {
+    PLockStatistics stats;
+    RetiredLock *next;
+};
+
+static PLock *namedLocks = 0;
+static RetiredLock *retiredLocks = 0;
+
+#if (!defined(_WIN32))
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+#define LockRegistry()      pthread_mutex_lock(&registryLock)
+#define UnlockRegistry()    pthread_mutex_unlock(&registryLock)
+#else
+static SRWLOCK registryLock = SRWLOCK_INIT;
+#define LockRegistry()      AcquireSRWLockExclusive(&registryLock)
+#define UnlockRegistry()    ReleaseSRWLockExclusive(&registryLock)
+#endif
+
+// Monotonic clock in nanoseconds used for lock timing.
+static uint64_t lockClock(void)
+{
+#if (defined(_WIN32))
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1.0E9 / (double)frequency.QuadPart);
+#elif (defined(CLOCK_MONOTONIC))
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+// Add the statistics to an entry with the same name or add a new entry.
+static void addStatistics(std::vector<PLockStatistics> &result, const PLockStatistics &stats)
+{
+    for (std::vector<PLockStatistics>::iterator i = result.begin(); i != result.end(); i++)
+    {
+        if (strcmp(i->name, stats.name) == 0)
+        {
+            i->acquisitions += stats.acquisitions;
+            i->contended += stats.contended;
+            i->waitTime += stats.waitTime;
+            if (stats.maxWait > i->maxWait) i->maxWait = stats.maxWait;
+            i->holdTime += stats.holdTime;
+            return;
+        }
+    }
+    result.push_back(stats);
+}
+
 PLock::PLock(const char *n): lockName(n), lockCount(0)
 {
 #if (!defined(_WIN32))
@@ -83,10 +153,53 @@ PLock::PLock(const char *n): lockName(n), lockCount(0)
 #else
     InitializeCriticalSection(&lock);
 #endif
+    acquisitions = contended = waitTime = maxWait = holdTime = acquiredAt = 0;
+    nextNamed = 0;
+    if (lockName != 0)
+    {
+        LockRegistry();
+        nextNamed = namedLocks;
+        namedLocks = this;
+        UnlockRegistry();
+    }
 }
 
 PLock::~PLock()
 {
+    if (lockName != 0)
+    {
+        // Remove it from the list and keep its statistics.
+        LockRegistry();
+        for (PLock **p = &namedLocks; *p != 0; p = &(*p)->nextNamed)
+        {
+            if (*p == this)
+            {
+                *p = nextNamed;
+                break;
+            }
+        }
+        if (acquisitions != 0)
+        {
+            RetiredLock *r = retiredLocks;
+            while (r != 0 && strcmp(r->stats.name, lockName) != 0)
+                r = r->next;
+            if (r == 0 && (r = (RetiredLock*)calloc(1, sizeof(RetiredLock))) != 0)
+            {
+                r->stats.name = lockName;
+                r->next = retiredLocks;
+                retiredLocks = r;
+            }
+            if (r != 0)
+            {
+                r->stats.acquisitions += acquisitions;
+                r->stats.contended += contended;
+                r->stats.waitTime += waitTime;
+                if (maxWait > r->stats.maxWait) r->stats.maxWait = maxWait;
+                r->stats.holdTime += holdTime;
+            }
+        }
+        UnlockRegistry();
+    }
 #if (!defined(_WIN32))
     pthread_mutex_destroy(&lock);
 #else
@@ -96,30 +209,45 @@ PLock::~PLock()
 
 void PLock::Lock(void)
 {
-    if (debugOptions & DEBUG_CONTENTION)
+    // Try to get the lock first.  If that fails the lock is contended
+    // and we time how long we have to wait.
+#if (!defined(_WIN32))
+    bool acquired = pthread_mutex_trylock(&lock) == 0;
+#else
+    bool acquired = TryEnterCriticalSection(&lock) == TRUE;
+#endif
+    if (! acquired)
     {
-        // Report a heavily contended lock.
-        if (Trylock())
-            return;
-        if (++lockCount > LOCK_REPORT_COUNT)
+        if (debugOptions & DEBUG_CONTENTION)
         {
-            if (lockName != 0)
-                Log("Lock: contention on lock: %s\n", lockName);
-            else
-                Log("Lock: contention on lock at %p\n", &lock);
-            lockCount = 0;
+            // Report a heavily contended lock.
+            if (++lockCount > LOCK_REPORT_COUNT)
+            {
+                if (lockName != 0)
+                    Log("Lock: contention on lock: %s\n", lockName);
+                else
+                    Log("Lock: contention on lock at %p\n", &lock);
+                lockCount = 0;
+            }
         }
-        // Drop through to a normal lock
-    }
+        uint64_t startWait = lockClock();
 #if (!defined(_WIN32))
-    pthread_mutex_lock(&lock);
+        pthread_mutex_lock(&lock);
 #else
-    EnterCriticalSection(&lock);
+        EnterCriticalSection(&lock);
 #endif
+        uint64_t waited = lockClock() - startWait;
+        contended++;
+        waitTime += waited;
+        if (waited > maxWait) maxWait = waited;
+    }
+    acquisitions++;
+    StartHold();
 }
 
 void PLock::Unlock(void)
 {
+    EndHold();
 #if (!defined(_WIN32))
     pthread_mutex_unlock(&lock);
 #else
@@ -132,13 +260,55 @@ bool PLock::Trylock(void)
 #if (!defined(_WIN32))
     // Since we use normal mutexes this returns EBUSY if the
     // current thread owns the mutex.
-    return pthread_mutex_trylock(&lock) != EBUSY;
+    bool acquired = pthread_mutex_trylock(&lock) != EBUSY;
 #else
     // This is not implemented properly in Windows.  There is
     // TryEnterCriticalSection in Win NT and later but that
     // returns TRUE if the current thread owns the mutex.
-   return TryEnterCriticalSection(&lock) == TRUE;
+    bool acquired = TryEnterCriticalSection(&lock) == TRUE;
 #endif
+    if (acquired)
+    {
+        acquisitions++;
+        StartHold();
+    }
+    return acquired;
+}
+
+// Record the time when the lock was acquired or reacquired after waiting on
+// a condition variable.
+void PLock::StartHold(void)
+{
+    acquiredAt = holdTiming ? lockClock() : 0;
+}
+
+// Called before the lock is released.
+void PLock::EndHold(void)
+{
+    if (acquiredAt != 0)
+    {
+        holdTime += lockClock() - acquiredAt;
+        acquiredAt = 0;
+    }
+}
+
+void PLock::GetStatistics(std::vector<PLockStatistics> &result)
+{
+    LockRegistry();
+    for (PLock *p = namedLocks; p != 0; p = p->nextNamed)
+    {
+        PLockStatistics stats;
+        stats.name = p->lockName;
+        stats.acquisitions = p->acquisitions;
+        stats.contended = p->contended;
+        stats.waitTime = p->waitTime;
+        stats.maxWait = p->maxWait;
+        stats.holdTime = p->holdTime;
+        addStatistics(result, stats);
+    }
+    for (RetiredLock *r = retiredLocks; r != 0; r = r->next)
+        addStatistics(result, r->stats);
+    UnlockRegistry();
 }
 
 PCondVar::PCondVar()
@@ -160,11 +330,13 @@ PCondVar::~PCondVar()
 // Wait indefinitely.  Drops the lock and reaquires it.
 void PCondVar::Wait(PLock *pLock)
 {
+    pLock->EndHold();
 #if (!defined(_WIN32))
     pthread_cond_wait(&cond, &pLock->lock);
 #else
     SleepConditionVariableCS(&cond, &pLock->lock, INFINITE);
 #endif
+    pLock->StartHold();
 }
 
 // Wait until a specified absolute time.  Drops the lock and reaquires it.
@@ -188,7 +360,9 @@ void PCondVar::WaitUntil(PLock *pLock, const FILETIME *time)
 // Unix-style times
 void PCondVar::WaitUntil(PLock *pLock, const timespec *time)
 {
+    pLock->EndHold();
     pthread_cond_timedwait(&cond, &pLock->lock, time);
+    pLock->StartHold();
 }
 #endif
 
@@ -209,11 +383,15 @@ bool PCondVar::WaitFor(PLock *pLock, unsigned milliseconds)
         waitTime.tv_nsec -= 1000*1000*1000;
         waitTime.tv_sec += 1;
     }
-    return pthread_cond_timedwait(&cond, &pLock->lock, &waitTime) == 0;
+    pLock->EndHold();
+    bool result = pthread_cond_timedwait(&cond, &pLock->lock, &waitTime) == 0;
 #else
+    pLock->EndHold();
     // SleepConditionVariableCS returns zero on error or timeout.
-    return SleepConditionVariableCS(&cond, &pLock->lock, milliseconds) != 0;
+    bool result = SleepConditionVariableCS(&cond, &pLock->lock, milliseconds) != 0;
 #endif
+    pLock->StartHold();
+    return result;
 }
 
 // Wake up all the waiting threads. 
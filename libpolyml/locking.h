@@ -44,6 +44,23 @@
 #include <pthread.h>
 #endif
 
+#if HAVE_STDINT_H
+#  include <stdint.h>
+#endif
+
+#include <vector>
+
+// Statistics for a named lock.  Locks with the same name are combined.
+// Times are in nanoseconds.
+struct PLockStatistics {
+    const char *name;
+    uint64_t acquisitions;  // Number of times the lock was acquired
+    uint64_t contended;     // Number of those where the lock was already held
+    uint64_t waitTime;      // Total time waiting for the lock
+    uint64_t maxWait;       // Longest single wait
+    uint64_t holdTime;      // Total time the lock was held, if hold timing is enabled
+};
+
 // Simple Mutex.
 class PLock {
 public:
@@ -53,6 +70,12 @@ public:
     void Unlock(void); // Unlock the mutex
     bool Trylock(void); // Try to lock the mutex - returns true if succeeded
 
+    // Return the statistics for all named locks including those that have been deleted.
+    static void GetStatistics(std::vector<PLockStatistics> &result);
+    // Measuring the hold time requires reading the clock on each acquisition
+    // so is only done if it has been enabled.
+    static bool holdTiming;
+
 private:
 #if (!defined(_WIN32))
     pthread_mutex_t lock;
@@ -63,6 +86,14 @@ private:
     const char *lockName;
     unsigned lockCount;
 
+    // Statistics.  These are only updated while the lock is held.
+    uint64_t acquisitions, contended, waitTime, maxWait, holdTime;
+    uint64_t acquiredAt; // Time when acquired if holdTiming is set, otherwise zero.
+    PLock *nextNamed; // List of named locks
+
+    void StartHold(void);
+    void EndHold(void);
+
     friend class PCondVar;
 };
 
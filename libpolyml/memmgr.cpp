@@ -124,7 +124,8 @@ bool LocalMemSpace::InitSpace(PolyWord *heapSpace, uintptr_t size, bool mut)
     return bitmap.Create(size);
 }
 
-MemMgr::MemMgr(): allocLock("Memmgr alloc"), codeBitmapLock("Code bitmap")
+MemMgr::MemMgr(): stackSpaceLock("Stack spaces"), codeSpaceLock("Code spaces"), allocLock("Memmgr alloc"),
+    codeBitmapLock("Code bitmap"), spaceTreeLock("Space tree")
 {
     nextIndex = 0;
     reservedSpace = 0;
@@ -87,6 +87,9 @@
 #include "pexport.h"
 #include "polystring.h"
 #include "statistics.h"
+#include "perfmap.h"
+#include "tracing.h"
+#include "bytecodejit.h"
 #include "noreturn.h"
 
 #if (defined(_WIN32))
@@ -118,7 +121,11 @@ enum {
     OPT_DDESERVICE,
     OPT_CODEPAGE,
     OPT_REMOTESTATS,
-    OPT_GCSHARING
+    OPT_GCSHARING,
+    OPT_METRICS,
+    OPT_PERF,
+    OPT_TRACE,
+    OPT_JIT
 };
 
 static struct __argtab {
@@ -142,7 +149,11 @@ static struct __argtab {
 #endif
     { _T("-pServiceName"),  "DDE service name for remote interrupt in Windows",     OPT_DDESERVICE }
 #else
-    { _T("--exportstats"),  "Enable another process to read the statistics",        OPT_REMOTESTATS }
+    { _T("--exportstats"),  "Enable another process to read the statistics",        OPT_REMOTESTATS },
+    { _T("--metrics"),      "Serve OpenMetrics statistics on a socket path or [host:]port", OPT_METRICS },
+    { _T("--perf"),         "Write symbols of ML code for Linux perf: map or jitdump", OPT_PERF },
+    { _T("--trace"),        "Trace RTS events and write them to a file on SIGUSR2 and at exit", OPT_TRACE },
+    { _T("--jit"),          "Compile interpreted code to native code after this many calls or loop iterations", OPT_JIT }
 #endif
 };
 
@@ -164,7 +175,8 @@ static struct __debugOpts {
     { _T("sharing"),            "Information from PolyML.shareCommonData",          DEBUG_SHARING},
     { _T("locks"),              "Information about contended locks",                DEBUG_CONTENTION},
     { _T("rts"),                "General run-time system calls",                    DEBUG_RTSCALLS},
-    { _T("saving"),             "Saving and loading state; exporting",              DEBUG_SAVING }
+    { _T("saving"),             "Saving and loading state; exporting",              DEBUG_SAVING },
+    { _T("safepoint"),          "Time taken for threads to stop for a GC",          DEBUG_SAFEPOINT }
 };
 
 // Parse a parameter that is meant to be a size.  Returns the value as a number
@@ -353,6 +365,31 @@ int polymain(int argc, TCHAR **argv, exportDescription *exports)
                         globalStats.exportStats = true;
                         break;
 
+#if (!defined(_WIN32))
+                    case OPT_METRICS:
+                        // Serve the statistics over HTTP.
+                        globalStats.metricsEndpoint = p;
+                        break;
+
+                    case OPT_PERF:
+                        // Write a perf map or jitdump file.
+                        if (!perfMapSetFormat(p))
+                            Usage("Unknown argument to --perf. Use map or jitdump.\n");
+                        break;
+
+                    case OPT_TRACE:
+                        // Record events and write them to this file.
+                        traceSetFile(p);
+                        break;
+
+                    case OPT_JIT:
+                        // Only used by the byte code interpreter.
+                        byteCodeJitThreshold = _tcstol(p, &endp, 10);
+                        if (*endp != '\0')
+                            Usage("Malformed %s option\n", argTable[j].argName);
+                        break;
+#endif
+
                     case OPT_GCSHARING:
                         // If set allow the GC to run the expensive sharing pass
                         gcShare = true;
@@ -100,6 +100,14 @@
 #include <sys/select.h>
 #endif
 
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
 #ifdef HAVE_ARPA_INET_H
 #include <arpa/inet.h>
 #endif
@@ -175,10 +183,15 @@ extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkGetSocketError(POLYUNSIGNED threadId, POLYUNSIGNED skt);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkConnect(POLYUNSIGNED threadId, POLYUNSIGNED skt, POLYUNSIGNED addr);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAccept(POLYUNSIGNED threadId, POLYUNSIGNED skt);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAcceptMultiple(POLYUNSIGNED threadId, POLYUNSIGNED skt, POLYUNSIGNED maxCount);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSend(POLYUNSIGNED threadId, POLYUNSIGNED args);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendTo(POLYUNSIGNED threadId, POLYUNSIGNED args);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendFile(POLYUNSIGNED threadId, POLYUNSIGNED args);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceive(POLYUNSIGNED threadId, POLYUNSIGNED args);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveVector(POLYUNSIGNED threadId, POLYUNSIGNED args);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveFrom(POLYUNSIGNED threadId, POLYUNSIGNED args);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendToMultiple(POLYUNSIGNED threadId, POLYUNSIGNED args);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveFromMultiple(POLYUNSIGNED threadId, POLYUNSIGNED args);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkGetFamilyFromAddress(POLYUNSIGNED sockAddress);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkGetAddressAndPortFromIP4(POLYUNSIGNED threadId, POLYUNSIGNED sockAddress);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkCreateIP4Address(POLYUNSIGNED threadId, POLYUNSIGNED ip4Address, POLYUNSIGNED portNumber);
@@ -877,6 +890,32 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkConnect(POLYUNSIGNED threadId, POLYUN
     return TAGGED(0).AsUnsigned(); // Always returns unit
 }
 
+// Accept a connection.  The new socket is non-blocking, as are all sockets we create,
+// and is not inherited by child processes.  accept4 does this in a single call.  In
+// Windows the new socket inherits the non-blocking state from the listener.
+static SOCKET acceptConnection(SOCKET sock, struct sockaddr_storage *resultAddr, socklen_t *addrLen)
+{
+#ifdef HAVE_ACCEPT4
+    return accept4(sock, (struct sockaddr*)resultAddr, addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    SOCKET resultSkt = accept(sock, (struct sockaddr*)resultAddr, addrLen);
+#if (!defined(_WIN32))
+    if (resultSkt != INVALID_SOCKET)
+    {
+        int onOff = 1;
+        if (ioctl(resultSkt, FIONBIO, &onOff) < 0 || fcntl(resultSkt, F_SETFD, FD_CLOEXEC) < 0)
+        {
+            int err = GETERROR;
+            close(resultSkt);
+            errno = err;
+            return INVALID_SOCKET;
+        }
+    }
+#endif
+    return resultSkt;
+#endif
+}
+
 POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAccept(POLYUNSIGNED threadId, POLYUNSIGNED skt)
 {
     TaskData *taskData = TaskData::FindTaskForId(threadId);
@@ -889,7 +928,7 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAccept(POLYUNSIGNED threadId, POLYUNS
         SOCKET sock = getStreamSocket(taskData, PolyWord::FromUnsigned(skt));
         struct sockaddr_storage resultAddr;
         socklen_t addrLen = sizeof(resultAddr);
-        SOCKET resultSkt = accept(sock, (struct sockaddr*)&resultAddr, &addrLen);
+        SOCKET resultSkt = acceptConnection(sock, &resultAddr, &addrLen);
         if (resultSkt == INVALID_SOCKET)
             raise_syscall(taskData, "accept failed", GETERROR);
         if (addrLen > sizeof(resultAddr)) addrLen = sizeof(resultAddr);
@@ -908,6 +947,69 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAccept(POLYUNSIGNED threadId, POLYUNS
     else return result->Word().AsUnsigned();
 }
 
+#define MAX_ACCEPT_BATCH    64
+
+// Accept up to maxCount connections that are already pending and return them as a list
+// of pairs of the socket and the address.  This allows a busy listener to be drained
+// with a single RTS call.  Raises an exception if there are no pending connections.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkAcceptMultiple(POLYUNSIGNED threadId, POLYUNSIGNED skt, POLYUNSIGNED maxCount)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+
+    try {
+        SOCKET sock = getStreamSocket(taskData, PolyWord::FromUnsigned(skt));
+        POLYUNSIGNED max = getPolyUnsigned(taskData, PolyWord::FromUnsigned(maxCount));
+        if (max > MAX_ACCEPT_BATCH) max = MAX_ACCEPT_BATCH;
+        SOCKET sockets[MAX_ACCEPT_BATCH];
+        struct sockaddr_storage addresses[MAX_ACCEPT_BATCH];
+        socklen_t addrLengths[MAX_ACCEPT_BATCH];
+        unsigned accepted = 0;
+        while (accepted < max)
+        {
+            addrLengths[accepted] = sizeof(struct sockaddr_storage);
+            SOCKET resultSkt = acceptConnection(sock, &addresses[accepted], &addrLengths[accepted]);
+            if (resultSkt == INVALID_SOCKET)
+            {
+                int err = GETERROR;
+                if (err == CALLINTERRUPTED) continue;
+                // Only report the error if we have nothing to return.
+                if (accepted == 0) raise_syscall(taskData, "accept failed", err);
+                break;
+            }
+            if (addrLengths[accepted] > sizeof(struct sockaddr_storage))
+                addrLengths[accepted] = sizeof(struct sockaddr_storage);
+            sockets[accepted++] = resultSkt;
+        }
+        // Build the list from the end so that it is in the order the connections were accepted.
+        Handle mark = taskData->saveVec.mark();
+        result = taskData->saveVec.push(ListNull);
+        for (unsigned i = accepted; i > 0; i--)
+        {
+            Handle addrHandle = taskData->saveVec.push(C_string_to_Poly(taskData, (char*)&addresses[i-1], addrLengths[i-1]));
+            Handle resSkt = wrapStreamSocket(taskData, sockets[i-1]);
+            Handle pair = alloc_and_save(taskData, 2);
+            pair->WordP()->Set(0, resSkt->Word());
+            pair->WordP()->Set(1, addrHandle->Word());
+            Handle next = alloc_and_save(taskData, SIZEOF(ML_Cons_Cell));
+            DEREFLISTHANDLE(next)->h = pair->Word();
+            DEREFLISTHANDLE(next)->t = result->Word();
+            // Reset the save vector to stop it overflowing.
+            taskData->saveVec.reset(mark);
+            result = taskData->saveVec.push(next->Word());
+        }
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSend(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
 {
     TaskData *taskData = TaskData::FindTaskForId(threadId);
@@ -947,6 +1049,86 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSend(POLYUNSIGNED threadId, POLYUNSIG
     return TAGGED(sent).AsUnsigned();
 }
 
+#if (!defined(_WIN32))
+// Send part of a file to a socket without copying the data into the ML heap.
+// On Linux sendfile transfers the data within the kernel.  Otherwise, or if
+// sendfile does not support this kind of file, we read a block and send it.
+// Any data read but not sent are read again on the next call since we use
+// an explicit file position.
+static ssize_t sendFileRange(SOCKET sock, int fd, off_t offset, size_t length)
+{
+#if (defined(HAVE_SYS_SENDFILE_H) && defined(__linux__))
+    off_t off = offset;
+    ssize_t res = sendfile(sock, fd, &off, length);
+    if (res >= 0 || (errno != EINVAL && errno != ENOSYS))
+        return res;
+#endif
+    char buffer[16384];
+    if (length > sizeof(buffer)) length = sizeof(buffer);
+    ssize_t haveRead = pread(fd, buffer, length, offset);
+    if (haveRead <= 0) return haveRead;
+    return send(sock, buffer, haveRead, 0);
+}
+#endif
+
+// Send up to "length" bytes from a file, starting at the given position, to a
+// stream socket.  Returns the number of bytes sent.  This is less than the length
+// if the end of the file is reached or if some data have been sent and the
+// socket would now block.  If nothing can be sent and "blocking" is true this
+// waits until the socket is ready, otherwise it raises an EWOULDBLOCK exception.
+// We never block after sending anything because the caller needs to know how
+// much was sent if the thread is interrupted.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendFile(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle args = taskData->saveVec.push(argsAsWord);
+    Handle result = 0;
+
+    try {
+#if (defined(_WIN32))
+        raise_fail(taskData, "sendFile is not implemented");
+#else
+        SOCKET sock = getStreamSocket(taskData, DEREFHANDLE(args)->Get(0));
+        int fd = getStreamFileDescriptor(taskData, DEREFHANDLE(args)->Get(1));
+        off_t position = getPolySigned(taskData, DEREFHANDLE(args)->Get(2));
+        size_t length = getPolyUnsigned(taskData, DEREFHANDLE(args)->Get(3));
+        bool blocking = get_C_unsigned(taskData, DEREFHANDLE(args)->Get(4)) != 0;
+        if (position < 0) raise_syscall(taskData, "Invalid position", EINVAL);
+        size_t sent = 0;
+        while (sent < length)
+        {
+            ssize_t res = sendFileRange(sock, fd, position + sent, length - sent);
+            if (res > 0) { sent += res; continue; }
+            if (res == 0) break; // End of file.
+            int err = GETERROR;
+            if (err == CALLINTERRUPTED) continue;
+            if (err != WOULDBLOCK && err != EAGAIN)
+                raise_syscall(taskData, "sendfile failed", err);
+            if (sent != 0) break; // Return what we have sent so far.
+            if (! blocking)
+                raise_syscall(taskData, "sendfile failed", err);
+            // Nothing sent yet: wait until the socket is writable.
+            WaitSelect waiter;
+            waiter.SetWrite(sock);
+            processes->ThreadPauseForIO(taskData, &waiter);
+        }
+        result = Make_fixed_precision(taskData, sent);
+#endif
+    }
+    catch (KillException &) {
+        processes->ThreadExit(taskData); // TestAnyEvents may test for kill
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendTo(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
 {
     TaskData *taskData = TaskData::FindTaskForId(threadId);
@@ -1028,6 +1210,45 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceive(POLYUNSIGNED threadId, POLYUN
     return TAGGED(recvd).AsUnsigned();
 }
 
+// Receive into a new vector.  The vector is allocated first and the data are
+// received directly into it, avoiding the need to receive into an array and copy.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveVector(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle args = taskData->saveVec.push(argsAsWord);
+    Handle result = 0;
+
+    try {
+        size_t length = getPolyUnsigned(taskData, DEREFHANDLE(args)->Get(1));
+        unsigned int peek = get_C_unsigned(taskData, DEREFHANDLE(args)->Get(2));
+        unsigned int outOfBand = get_C_unsigned(taskData, DEREFHANDLE(args)->Get(3));
+        int flags = 0;
+        if (peek != 0) flags |= MSG_PEEK;
+        if (outOfBand != 0) flags |= MSG_OOB;
+        // Allocate the vector before getting the socket since it may GC.
+        result = SAVE(AllocatePolyString(taskData, length));
+        SOCKET sock = getStreamSocket(taskData, DEREFHANDLE(args)->Get(0));
+        PolyStringObject *str = (PolyStringObject *)result->WordP();
+#if(defined(_WIN32) && ! defined(_CYGWIN))
+        int recvd = recv(sock, str->chars, (int)length, flags);
+#else
+        ssize_t recvd = recv(sock, str->chars, length, flags);
+#endif
+        if (recvd == SOCKET_ERROR)
+            raise_syscall(taskData, "recv failed", GETERROR);
+        TruncatePolyString(str, recvd);
+    }
+    catch (...) { result = 0; } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveFrom(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
 {
     TaskData *taskData = TaskData::FindTaskForId(threadId);
@@ -1080,6 +1301,159 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveFrom(POLYUNSIGNED threadId, PO
     else return result->Word().AsUnsigned();
 }
 
+// Batched datagram IO.  Each call transfers as many datagrams as it can without
+// blocking, up to MAX_DATAGRAM_BATCH, and returns the number transferred.  If none
+// can be transferred it raises an EWOULDBLOCK exception.  On Linux this uses
+// sendmmsg/recvmmsg; MSG_WAITFORONE is defined along with them.  Otherwise we loop
+// with sendto/recvfrom but still only make a single RTS call.
+#define MAX_DATAGRAM_BATCH  64
+
+#if (defined(MSG_WAITFORONE) && ! defined(_WIN32))
+#define HAVE_MMSG   1
+#endif
+
+// Send a vector of datagrams.  Each entry is a tuple of the destination address
+// (a string), the base of the data, the byte offset and the length.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkSendToMultiple(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle args = taskData->saveVec.push(argsAsWord);
+    int sent = 0;
+
+    try {
+        SOCKET sock = getStreamSocket(taskData, DEREFHANDLE(args)->Get(0));
+        PolyObject *msgVec = DEREFHANDLE(args)->Get(1).AsObjPtr();
+        POLYUNSIGNED nMsgs = msgVec->Length();
+        if (nMsgs > MAX_DATAGRAM_BATCH) nMsgs = MAX_DATAGRAM_BATCH;
+#ifdef HAVE_MMSG
+        struct mmsghdr msgs[MAX_DATAGRAM_BATCH];
+        struct iovec iovs[MAX_DATAGRAM_BATCH];
+        memset(msgs, 0, nMsgs * sizeof(struct mmsghdr));
+        for (POLYUNSIGNED i = 0; i < nMsgs; i++)
+        {
+            PolyObject *entry = msgVec->Get(i).AsObjPtr();
+            PolyStringObject *psAddr = (PolyStringObject *)entry->Get(0).AsObjPtr();
+            iovs[i].iov_base = entry->Get(1).AsObjPtr()->AsBytePtr() + getPolyUnsigned(taskData, entry->Get(2));
+            iovs[i].iov_len = getPolyUnsigned(taskData, entry->Get(3));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = psAddr->chars;
+            msgs[i].msg_hdr.msg_namelen = (socklen_t)psAddr->length;
+        }
+        int res;
+        do {
+            res = sendmmsg(sock, msgs, (unsigned)nMsgs, 0);
+        } while (res == SOCKET_ERROR && GETERROR == CALLINTERRUPTED);
+        if (res == SOCKET_ERROR)
+            raise_syscall(taskData, "sendmmsg failed", GETERROR);
+        sent = res;
+#else
+        for (; sent < (int)nMsgs; sent++)
+        {
+            PolyObject *entry = msgVec->Get(sent).AsObjPtr();
+            PolyStringObject *psAddr = (PolyStringObject *)entry->Get(0).AsObjPtr();
+            char *base = (char*)entry->Get(1).AsObjPtr()->AsBytePtr() + getPolyUnsigned(taskData, entry->Get(2));
+            size_t length = getPolyUnsigned(taskData, entry->Get(3));
+            if (sendto(sock, base, (int)length, 0, (struct sockaddr *)psAddr->chars, (int)psAddr->length) == SOCKET_ERROR)
+            {
+                int err = GETERROR;
+                // Report the error only if it happens on the first datagram.
+                if (sent == 0) raise_syscall(taskData, "sendto failed", err);
+                break;
+            }
+        }
+#endif
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(sent).AsUnsigned();
+}
+
+// Receive datagrams into a vector of buffers supplied by the caller.  Each buffer
+// is a tuple of the base of the data area, its length, a byte area for the source
+// address and an int array with two elements.  These are all allocated once by the
+// caller and reused.  The length of the data and the length of the address are
+// stored in the int array so no allocation is needed on the ML heap.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyNetworkReceiveFromMultiple(POLYUNSIGNED threadId, POLYUNSIGNED argsAsWord)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle args = taskData->saveVec.push(argsAsWord);
+    int received = 0;
+
+    try {
+        SOCKET sock = getStreamSocket(taskData, DEREFHANDLE(args)->Get(0));
+        PolyObject *bufVec = DEREFHANDLE(args)->Get(1).AsObjPtr();
+        POLYUNSIGNED nBufs = bufVec->Length();
+        if (nBufs > MAX_DATAGRAM_BATCH) nBufs = MAX_DATAGRAM_BATCH;
+#ifdef HAVE_MMSG
+        struct mmsghdr msgs[MAX_DATAGRAM_BATCH];
+        struct iovec iovs[MAX_DATAGRAM_BATCH];
+        memset(msgs, 0, nBufs * sizeof(struct mmsghdr));
+        for (POLYUNSIGNED i = 0; i < nBufs; i++)
+        {
+            PolyObject *entry = bufVec->Get(i).AsObjPtr();
+            PolyObject *addrBuff = entry->Get(2).AsObjPtr();
+            iovs[i].iov_base = entry->Get(0).AsObjPtr()->AsBytePtr();
+            iovs[i].iov_len = getPolyUnsigned(taskData, entry->Get(1));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = addrBuff->AsBytePtr();
+            msgs[i].msg_hdr.msg_namelen = (socklen_t)(addrBuff->Length() * sizeof(PolyWord));
+        }
+        int res;
+        do {
+            res = recvmmsg(sock, msgs, (unsigned)nBufs, 0, NULL);
+        } while (res == SOCKET_ERROR && GETERROR == CALLINTERRUPTED);
+        if (res == SOCKET_ERROR)
+            raise_syscall(taskData, "recvmmsg failed", GETERROR);
+        for (int j = 0; j < res; j++)
+        {
+            PolyObject *lengths = bufVec->Get(j).AsObjPtr()->Get(3).AsObjPtr();
+            lengths->Set(0, TAGGED(msgs[j].msg_len));
+            lengths->Set(1, TAGGED(msgs[j].msg_hdr.msg_namelen));
+        }
+        received = res;
+#else
+        for (; received < (int)nBufs; received++)
+        {
+            PolyObject *entry = bufVec->Get(received).AsObjPtr();
+            PolyObject *addrBuff = entry->Get(2).AsObjPtr();
+            char *base = (char*)entry->Get(0).AsObjPtr()->AsBytePtr();
+            size_t length = getPolyUnsigned(taskData, entry->Get(1));
+            socklen_t addrLen = (socklen_t)(addrBuff->Length() * sizeof(PolyWord));
+#if(defined(_WIN32) && ! defined(_CYGWIN))
+            int recvd;
+#else
+            ssize_t recvd;
+#endif
+            recvd = recvfrom(sock, base, (int)length, 0, (struct sockaddr*)addrBuff->AsBytePtr(), &addrLen);
+            if (recvd == SOCKET_ERROR)
+            {
+                int err = GETERROR;
+                if (received == 0) raise_syscall(taskData, "recvfrom failed", err);
+                break;
+            }
+            PolyObject *lengths = entry->Get(3).AsObjPtr();
+            lengths->Set(0, TAGGED(recvd));
+            lengths->Set(1, TAGGED(addrLen));
+        }
+#endif
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(received).AsUnsigned();
+}
+
 /* Return a list of known address families. */
 POLYUNSIGNED PolyNetworkGetAddrList(POLYUNSIGNED threadId)
 {
@@ -1217,6 +1591,14 @@ POLYUNSIGNED PolyNetworkSetOption(POLYUNSIGNED threadId, POLYUNSIGNED code, POLY
         case 31: /* Set RCVBUF size. */
             setSocketOption(taskData, pushedSock, pushedOpt, SOL_SOCKET, SO_RCVBUF);
             break;
+
+        case 34: /* Set REUSEPORT option. */
+#ifdef SO_REUSEPORT
+            setSocketOption(taskData, pushedSock, pushedOpt, SOL_SOCKET, SO_REUSEPORT);
+#else
+            raise_syscall(taskData, "SO_REUSEPORT is not supported", ENOPROTOOPT);
+#endif
+            break;
         }
     }
     catch (KillException&) {
@@ -1280,6 +1662,14 @@ POLYUNSIGNED PolyNetworkGetOption(POLYUNSIGNED threadId, POLYUNSIGNED code, POLY
         case 33: /* Get socket type e.g. SOCK_STREAM. */
             result = getSocketOption(taskData, pushedArg, SOL_SOCKET, SO_TYPE);
             break;
+
+        case 35: /* Get REUSEPORT option. */
+#ifdef SO_REUSEPORT
+            result = getSocketOption(taskData, pushedArg, SOL_SOCKET, SO_REUSEPORT);
+#else
+            raise_syscall(taskData, "SO_REUSEPORT is not supported", ENOPROTOOPT);
+#endif
+            break;
         }
     }
     catch (KillException&) {
@@ -2179,10 +2569,15 @@ struct _entrypts networkingEPT[] =
     { "PolyNetworkGetSocketError",              (polyRTSFunction)&PolyNetworkGetSocketError },
     { "PolyNetworkConnect",                     (polyRTSFunction)&PolyNetworkConnect },
     { "PolyNetworkAccept",                      (polyRTSFunction)&PolyNetworkAccept },
+    { "PolyNetworkAcceptMultiple",              (polyRTSFunction)&PolyNetworkAcceptMultiple },
     { "PolyNetworkSend",                        (polyRTSFunction)&PolyNetworkSend },
+    { "PolyNetworkSendFile",                    (polyRTSFunction)&PolyNetworkSendFile },
     { "PolyNetworkSendTo",                      (polyRTSFunction)&PolyNetworkSendTo },
     { "PolyNetworkReceive",                     (polyRTSFunction)&PolyNetworkReceive },
+    { "PolyNetworkReceiveVector",               (polyRTSFunction)&PolyNetworkReceiveVector },
     { "PolyNetworkReceiveFrom",                 (polyRTSFunction)&PolyNetworkReceiveFrom },
+    { "PolyNetworkSendToMultiple",              (polyRTSFunction)&PolyNetworkSendToMultiple },
+    { "PolyNetworkReceiveFromMultiple",         (polyRTSFunction)&PolyNetworkReceiveFromMultiple },
     { "PolyNetworkGetAddrInfo",                 (polyRTSFunction)&PolyNetworkGetAddrInfo },
     { "PolyNetworkGetFamilyFromAddress",        (polyRTSFunction)&PolyNetworkGetFamilyFromAddress },
     { "PolyNetworkGetAddressAndPortFromIP4",    (polyRTSFunction)&PolyNetworkGetAddressAndPortFromIP4 },
@@ -0,0 +1,416 @@
+/*
+    Title:      Symbol information for the Linux perf tool.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/*
+ML code is created at run time so perf cannot find any symbols for it.  perf
+has two ways of obtaining this information.  The simpler is a text file,
+/tmp/perf-<pid>.map, with a line giving the address, size and name of each
+function.  perf reads this when the report is produced so it can only
+describe the code as it is at the end.  We append entries as code is created
+and rewrite the file if the GC frees any code so that addresses that have
+been reused refer to the new function.
+
+The alternative is a "jitdump" file, jit-<pid>.dump, which is a binary log
+of code loads, with timestamps, and copies of the code.  "perf record -k 1"
+notes that the process has mapped this file and "perf inject --jit"
+combines the log with the recorded samples.  Because each load has a
+timestamp, samples are attributed to the function that was at the address
+at the time.  There is no "unload" record; a new load at the same address
+replaces the old one.  Code objects are never moved once they have been
+created so we do not need "move" records.
+
+The names are the same as those used by the profiler.  Nothing is written
+for the interpreted version since samples are always in the interpreter.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_WIN32)
+#include "winconfig.h"
+#else
+#error "No configuration file"
+#endif
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+#ifdef HAVE_ELF_H
+#include <elf.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#include <string>
+
+#include "globals.h"
+#include "perfmap.h"
+#include "machine_dep.h"
+#include "memmgr.h"
+#include "polystring.h"
+#include "locking.h"
+#include "rts_module.h"
+#include "diagnostics.h"
+
+#ifndef EM_386
+#define EM_386          3
+#endif
+#ifndef EM_X86_64
+#define EM_X86_64       62
+#endif
+#ifndef EM_AARCH64
+#define EM_AARCH64      183
+#endif
+
+bool perfMapEnabled = false;
+
+#if (!defined(_WIN32))
+
+// Values from tools/perf/util/jitdump.h in the Linux sources.
+#define JITDUMP_MAGIC       0x4A695444
+#define JITDUMP_VERSION     1
+#define JIT_CODE_LOAD       0
+#define JIT_CODE_CLOSE      3
+
+struct jitHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t totalSize;
+    uint32_t elfMach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitRecordHeader {
+    uint32_t id;
+    uint32_t totalSize;
+    uint64_t timestamp;
+};
+
+// Followed by the null-terminated name and then the code.
+struct jitCodeLoad {
+    jitRecordHeader header;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t codeAddr;
+    uint64_t codeSize;
+    uint64_t codeIndex;
+};
+
+enum PerfFormat { PERF_NONE, PERF_MAP, PERF_JITDUMP };
+
+class PerfMapModule: public RtsModule
+{
+public:
+    PerfMapModule(): format(PERF_NONE), mapFile(0), mapping(0), mapLength(0),
+        codeIndex(0), codeFreed(false), perfLock("Perf map") {}
+    virtual void Start(void);
+    virtual void Stop(void);
+    virtual void ForkChild(void);
+
+    void AddCode(PolyObject *code);
+    void AddCodeInArea(PolyWord *bottom, PolyWord *top);
+    void AddAllCode(void);
+    void RewriteMap(void);
+
+    PerfFormat format;
+    std::string fileName;
+    FILE *mapFile;
+    void *mapping; // The jitdump file is mapped so that perf can find it.
+    size_t mapLength;
+    uint64_t codeIndex;
+    bool codeFreed;
+    PLock perfLock;
+};
+
+static PerfMapModule perfMapModule;
+
+// jitdump timestamps must match those perf uses with "-k 1".
+static uint64_t perfTimestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t perfThreadId(void)
+{
+#if (defined(SYS_gettid))
+    return (uint32_t)syscall(SYS_gettid);
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+void PerfMapModule::Start(void)
+{
+    if (format == PERF_NONE || machineDependent->MachineArchitecture() == MA_Interpreted)
+        return;
+
+    char name[100];
+    if (format == PERF_MAP)
+    {
+        snprintf(name, sizeof(name), "/tmp/perf-%d.map", (int)getpid());
+        fileName = name;
+        mapFile = fopen(name, "w");
+        if (mapFile == 0)
+        {
+            Log("PERF: Unable to create %s\n", name);
+            return;
+        }
+    }
+    else
+    {
+        const char *dir = getenv("JITDUMPDIR");
+        if (dir == 0 || *dir == 0) dir = "/tmp";
+        fileName = std::string(dir) + "/jit-";
+        snprintf(name, sizeof(name), "%d.dump", (int)getpid());
+        fileName += name;
+        int fd = open(fileName.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0666);
+        if (fd < 0 || (mapFile = fdopen(fd, "w+")) == 0)
+        {
+            if (fd >= 0) close(fd);
+            Log("PERF: Unable to create %s\n", fileName.c_str());
+            return;
+        }
+        jitHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = JITDUMP_MAGIC;
+        header.version = JITDUMP_VERSION;
+        header.totalSize = sizeof(header);
+        switch (machineDependent->MachineArchitecture())
+        {
+        case MA_I386: header.elfMach = EM_386; break;
+        case MA_Arm64: case MA_Arm64_32: header.elfMach = EM_AARCH64; break;
+        default: header.elfMach = EM_X86_64; break;
+        }
+        header.pid = (uint32_t)getpid();
+        header.timestamp = perfTimestamp();
+        fwrite(&header, sizeof(header), 1, mapFile);
+        fflush(mapFile);
+        // perf only looks at the file if it sees an executable mapping of it.
+        mapLength = (size_t)sysconf(_SC_PAGESIZE);
+        mapping = mmap(0, mapLength, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            mapping = 0;
+            Log("PERF: Unable to map %s\n", fileName.c_str());
+        }
+    }
+    perfMapEnabled = true;
+    PLocker lock(&perfLock);
+    AddAllCode();
+}
+
+void PerfMapModule::Stop(void)
+{
+    PLocker lock(&perfLock);
+    if (mapFile == 0) return;
+    perfMapEnabled = false;
+    if (format == PERF_JITDUMP)
+    {
+        jitRecordHeader close;
+        close.id = JIT_CODE_CLOSE;
+        close.totalSize = sizeof(close);
+        close.timestamp = perfTimestamp();
+        fwrite(&close, sizeof(close), 1, mapFile);
+        if (mapping != 0) munmap(mapping, mapLength);
+        mapping = 0;
+    }
+    fclose(mapFile);
+    mapFile = 0;
+}
+
+// The file belongs to the parent.  Stop recording in the child.
+void PerfMapModule::ForkChild(void)
+{
+    perfMapEnabled = false;
+    if (mapFile != 0)
+    {
+        fclose(mapFile);
+        mapFile = 0;
+    }
+    if (mapping != 0) munmap(mapping, mapLength);
+    mapping = 0;
+}
+
+// Write an entry for a code object.  The caller must hold the lock.
+void PerfMapModule::AddCode(PolyObject *code)
+{
+    if (mapFile == 0) return;
+    PolyWord nameWord = machineDependent->ConstPtrForCode(code)[0];
+    std::string name;
+    if (nameWord != TAGGED(0)) name = PolyStringToCString(nameWord);
+    if (name.empty()) name = "<anonymous>";
+    uintptr_t start = (uintptr_t)code;
+    size_t size = code->Length() * sizeof(PolyWord);
+
+    if (format == PERF_MAP)
+        fprintf(mapFile, "%" PRIxPTR " %zx %s\n", start, size, name.c_str());
+    else
+    {
+        jitCodeLoad load;
+        load.header.id = JIT_CODE_LOAD;
+        load.header.totalSize = (uint32_t)(sizeof(load) + name.length() + 1 + size);
+        load.header.timestamp = perfTimestamp();
+        load.pid = (uint32_t)getpid();
+        load.tid = perfThreadId();
+        load.vma = load.codeAddr = start;
+        load.codeSize = size;
+        load.codeIndex = codeIndex++;
+        fwrite(&load, sizeof(load), 1, mapFile);
+        fwrite(name.c_str(), name.length() + 1, 1, mapFile);
+        fwrite(code, size, 1, mapFile);
+    }
+}
+
+void PerfMapModule::AddCodeInArea(PolyWord *bottom, PolyWord *top)
+{
+    PolyWord *ptr = bottom;
+    while (ptr < top)
+    {
+        ptr++; // Skip the length word
+        PolyObject *obj = (PolyObject*)ptr;
+        ASSERT(obj->ContainsNormalLengthWord());
+        if (obj->IsCodeObject())
+            AddCode(obj);
+        ptr += obj->Length();
+    }
+}
+
+// Write entries for all the code currently in the heap.  Permanent spaces are
+// filled from the bottom.  Free space in the code areas is made into byte objects.
+void PerfMapModule::AddAllCode(void)
+{
+    for (std::vector<PermanentMemSpace*>::iterator i = gMem.pSpaces.begin(); i < gMem.pSpaces.end(); i++)
+    {
+        PermanentMemSpace *space = *i;
+        if (space->isCode && !space->constArea)
+            AddCodeInArea(space->bottom, space->top);
+    }
+    for (std::vector<CodeSpace*>::iterator i = gMem.cSpaces.begin(); i < gMem.cSpaces.end(); i++)
+        AddCodeInArea((*i)->bottom, (*i)->top);
+    if (mapFile != 0) fflush(mapFile);
+}
+
+// Replace the perf map with one describing only the code currently present.
+// The caller must hold the lock.
+void PerfMapModule::RewriteMap(void)
+{
+    if (mapFile == 0) return;
+    std::string tempName = fileName + ".tmp";
+    FILE *newFile = fopen(tempName.c_str(), "w");
+    if (newFile == 0) return; // Leave the old file.
+    fclose(mapFile);
+    mapFile = newFile;
+    AddAllCode();
+    if (rename(tempName.c_str(), fileName.c_str()) != 0)
+        Log("PERF: Unable to replace %s\n", fileName.c_str());
+}
+
+bool perfMapSetFormat(const TCHAR *format)
+{
+    if (strcmp(format, "map") == 0)
+        perfMapModule.format = PERF_MAP;
+    else if (strcmp(format, "jitdump") == 0)
+        perfMapModule.format = PERF_JITDUMP;
+    else return false;
+    return true;
+}
+
+void perfMapAddCode(PolyObject *code)
+{
+    if (!perfMapEnabled) return;
+    PLocker lock(&perfMapModule.perfLock);
+    perfMapModule.AddCode(code);
+    if (perfMapModule.mapFile != 0) fflush(perfMapModule.mapFile);
+}
+
+// This may be called from several GC threads.
+void perfMapCodeFreed(void)
+{
+    PLocker lock(&perfMapModule.perfLock);
+    perfMapModule.codeFreed = true;
+}
+
+// Called in the GC with the ML threads stopped.  Only the map needs to be
+// rewritten: new entries in the jitdump file override older ones.
+void perfMapUpdate(void)
+{
+    if (!perfMapEnabled) return;
+    PLocker lock(&perfMapModule.perfLock);
+    if (perfMapModule.codeFreed && perfMapModule.format == PERF_MAP)
+        perfMapModule.RewriteMap();
+    perfMapModule.codeFreed = false;
+}
+
+void perfMapReload(void)
+{
+    if (!perfMapEnabled) return;
+    PLocker lock(&perfMapModule.perfLock);
+    if (perfMapModule.format == PERF_MAP)
+        perfMapModule.RewriteMap();
+    else perfMapModule.AddAllCode();
+    perfMapModule.codeFreed = false;
+}
+
+#else
+
+bool perfMapSetFormat(const TCHAR *) { return false; }
+void perfMapAddCode(PolyObject *) {}
+void perfMapCodeFreed(void) {}
+void perfMapUpdate(void) {}
+void perfMapReload(void) {}
+
+#endif
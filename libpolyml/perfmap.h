@@ -0,0 +1,49 @@
+/*
+    Title:      Symbol information for the Linux perf tool.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _PERFMAP_H
+#define _PERFMAP_H
+
+#ifdef HAVE_TCHAR_H
+#include <tchar.h>
+#else
+typedef char TCHAR;
+#endif
+
+class PolyObject;
+
+// Set from the --perf option.  Returns false if the format is not recognised.
+extern bool perfMapSetFormat(const TCHAR *format);
+
+// True if we are writing a map or jitdump file.
+extern bool perfMapEnabled;
+
+// Record a code object once it has been locked.
+extern void perfMapAddCode(PolyObject *code);
+
+// Called by the GC when it has freed at least one code object and at the end
+// of the mark phase to bring the map up to date.
+extern void perfMapCodeFreed(void);
+extern void perfMapUpdate(void);
+
+// Called after a saved state has been loaded.
+extern void perfMapReload(void);
+
+#endif
@@ -56,6 +56,7 @@
 #include "gc.h"
 #include "rtsentry.h"
 #include "scanaddrs.h" // For SetConstantValue
+#include "perfmap.h"
 
 extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolySpecificGeneral(POLYUNSIGNED threadId, POLYUNSIGNED code, POLYUNSIGNED arg);
@@ -250,6 +251,8 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyLockMutableClosure(POLYUNSIGNED threadId, PO
         gMem.SpaceForObjectAddress(codeObj)->writeAble(codeObj)->SetLengthWord(segLength, F_CODE_OBJ);
         // Flush cache on ARM at least.
         machineDependent->FlushInstructionCache(codeObj, segLength * sizeof(PolyWord));
+        // The code is now complete so can be described to perf.
+        perfMapAddCode(codeObj);
         // In the future it may be necessary to return a different address here.
         // N.B.  The code area should only have execute permission in the native
         // code version, not the interpreted version.
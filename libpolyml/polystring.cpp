@@ -83,6 +83,30 @@ PolyWord C_string_to_Poly(TaskData *mdTaskData, const char *buffer, size_t buffL
     return result;
 } /* C_string_to_Poly */
 
+// Allocate a string of the given length with the characters set to zero.
+// This is used when the data is to be read directly into the string.
+PolyStringObject *AllocatePolyString(TaskData *mdTaskData, size_t buffLen)
+{
+    PolyStringObject *result = (PolyStringObject *)(alloc(mdTaskData, WORDS(buffLen) + 1, F_BYTE_OBJ));
+    result->length = (POLYUNSIGNED)buffLen;
+    return result;
+}
+
+// Reduce the length of a string allocated by AllocatePolyString.  This is used if
+// fewer characters were read than were requested.  The string must not have been
+// passed back to ML.  Any words no longer part of the string are cleared to zero
+// so that they form zero-length objects and the heap can still be scanned.
+void TruncatePolyString(PolyStringObject *str, size_t newLen)
+{
+    POLYUNSIGNED oldWords = str->Length();
+    POLYUNSIGNED newWords = WORDS(newLen) + 1;
+    if (newLen >= str->length) return;
+    char *end = (char*)((PolyWord*)str + oldWords);
+    memset(str->chars + newLen, 0, end - (str->chars + newLen));
+    str->length = (POLYUNSIGNED)newLen;
+    str->SetLengthWord(newWords, F_BYTE_OBJ);
+}
+
 POLYUNSIGNED Poly_string_to_C(PolyWord ps, char *buff, POLYUNSIGNED bufflen)
 /* Copies the characters from the string into the destination buffer.
    Returns original length of string. */
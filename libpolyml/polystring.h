@@ -49,6 +49,8 @@ extern PolyWord EmptyString(TaskData *mdTaskData);
 
 /* PolyStringObject functions */
 extern PolyWord C_string_to_Poly(TaskData *mdTaskData, const char *buffer, size_t buffLen = -1);
+extern PolyStringObject *AllocatePolyString(TaskData *mdTaskData, size_t buffLen);
+extern void TruncatePolyString(PolyStringObject *str, size_t newLen);
 extern POLYUNSIGNED Poly_string_to_C(PolyWord ps, char *buff, POLYUNSIGNED bufflen);
 extern char *Poly_string_to_C_alloc(PolyWord ps, size_t extraChars = 0);
 extern std::string PolyStringToCString(PolyWord ps);
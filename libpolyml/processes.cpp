@@ -126,6 +126,7 @@
 #include "statistics.h"
 #include "rtsentry.h"
 #include "gc_progress.h"
+#include "polystring.h"
 
 extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyThreadKillSelf(POLYUNSIGNED threadId);
@@ -217,6 +218,8 @@ public:
     // If the schedule lock is already held we need to use these functions.
     void ThreadUseMLMemoryWithSchedLock(TaskData *taskData);
     void ThreadReleaseMLMemoryWithSchedLock(TaskData *taskData);
+    // Record the time taken for the threads to stop for a request.
+    void ReportSafepointWait(void);
 
     // Requests from the threads for actions that need to be performed by
     // the root thread. Make the request and wait until it has completed.
@@ -236,6 +239,7 @@ public:
     // Profiling control.
     virtual void StartProfiling(void);
     virtual void StopProfiling(void);
+    virtual void ProcessProfileSamples(void);
 
 #ifdef HAVE_WINDOWS_H
     // Windows: Called every millisecond while profiling is on.
@@ -303,6 +307,12 @@ public:
     // A requesting thread sets this to indicate the request.  This value
     // is only reset once the request has been satisfied.
     MainThreadRequest *threadRequest;
+    // Time-to-safepoint.  When the request was made and the last thread to stop for it
+    // with the address it stopped at.  Reported with "--debug safepoint".
+    uint64_t threadRequestTime;
+    TaskData *lastToStop;
+    POLYCODEPTR lastStopPC;
+    uint64_t lastStopTime;
 
     PCondVar mlThreadWait;  // All the threads block on here until the request has completed.
 
@@ -326,7 +336,7 @@ ProcessExternal *processes = &processesModule;
 
 Processes::Processes(): singleThreaded(false),
     schedLock("Scheduler"), interrupt_exn(0),
-    threadRequest(0), exitResult(0), exitRequest(false), sigTask(0)
+    threadRequest(0), threadRequestTime(0), lastToStop(0), lastStopPC(0), lastStopTime(0), exitResult(0), exitRequest(false), sigTask(0)
 {
 #ifdef HAVE_WINDOWS_H
     hStopEvent = NULL;
@@ -770,9 +780,10 @@ void TaskData::FillUnusedSpace(void)
 
 
 TaskData::TaskData(): allocPointer(0), allocLimit(0), allocSize(MIN_HEAP_SIZE), allocCount(0),
+        allocSampleCountdown(0), allocSampleBase(0), allocSampleEpoch(0),
         stack(0), threadObject(0), signalStack(0),
         requests(kRequestNone), blockMutex(0), inMLHeap(false),
-        runningProfileTimer(false)
+        runningProfileTimer(false), profileSamples(0), profileCounter(-1)
 {
 #ifdef HAVE_WINDOWS_H
     lastCPUTime = 0;
@@ -787,6 +798,8 @@ TaskData::~TaskData()
 {
     if (signalStack) free(signalStack);
     if (stack) gMem.DeleteStackSpace(stack);
+    delete(profileSamples);
+    profileCounterClose(this);
 #ifdef HAVE_WINDOWS_H
     if (threadHandle) CloseHandle(threadHandle);
 #endif
@@ -888,6 +901,7 @@ void Processes::ThreadUseMLMemoryWithSchedLock(TaskData *taskData)
     }
     ASSERT(! ptaskData->inMLHeap);
     ptaskData->inMLHeap = true;
+    traceEnd(TRACE_BLOCKED);
 }
 
 // Called to indicate that the thread has temporarily finished with the
@@ -899,18 +913,27 @@ void Processes::ThreadReleaseMLMemoryWithSchedLock(TaskData *taskData)
     TaskData *ptaskData = taskData;
     ASSERT(ptaskData->inMLHeap);
     ptaskData->inMLHeap = false;
+    traceBegin(TRACE_BLOCKED);
     // Put a dummy object in any unused space.  This maintains the
     // invariant that the allocated area is filled with valid objects.
     ptaskData->FillUnusedSpace();
     //
     if (threadRequest != 0)
+    {
+        // If this is the last thread to stop this shows where it was running.
+        stackItem *sp;
+        lastToStop = ptaskData;
+        lastStopPC = ptaskData->GetProfileSite(sp);
+        lastStopTime = traceTimestamp();
         initialThreadWait.Signal();
+    }
 }
 
 
 // Make a request to the root thread.
 void Processes::MakeRootRequest(TaskData *taskData, MainThreadRequest *request)
 {
+    traceBegin(TRACE_ROOT_REQUEST, request->mtp);
     if (singleThreaded)
     {
         mainThreadPhase = request->mtp;
@@ -933,6 +956,8 @@ void Processes::MakeRootRequest(TaskData *taskData, MainThreadRequest *request)
         // Now the other requests have been dealt with (and we have schedLock).
         request->completed = false;
         threadRequest = request;
+        threadRequestTime = traceTimestamp();
+        lastToStop = 0;
         // Wait for it to complete.
         while (! request->completed)
         {
@@ -940,6 +965,28 @@ void Processes::MakeRootRequest(TaskData *taskData, MainThreadRequest *request)
             ThreadUseMLMemoryWithSchedLock(taskData); // Drops schedLock while waiting.
         }
     }
+    traceEnd(TRACE_ROOT_REQUEST, request->mtp);
+}
+
+// Called by the main thread once all the threads have stopped for a request.
+// A long wait means a thread has been running for a long time without
+// checking for an interrupt.
+void Processes::ReportSafepointWait(void)
+{
+    uint64_t waitTime = lastStopTime > threadRequestTime ? lastStopTime - threadRequestTime : 0;
+    globalStats.recordSafepointWait((double)waitTime / 1.0E9);
+    if ((debugOptions & DEBUG_SAFEPOINT) && lastToStop != 0)
+    {
+        std::string name = "<unknown>";
+        PolyObject *codeObj = lastStopPC == 0 ? 0 : gMem.FindCodeObject(lastStopPC);
+        if (codeObj != 0)
+        {
+            PolyWord nameWord = machineDependent->ConstPtrForCode(codeObj)[0];
+            if (nameWord != TAGGED(0)) name = PolyStringToCString(nameWord);
+        }
+        Log("SAFEPOINT: Waited %1.3fms for the threads to stop.  Last thread %p stopped at %p in %s\n",
+            (double)waitTime / 1.0E6, lastToStop, lastStopPC, name.c_str());
+    }
 }
 
 // Find space for an object.  Returns a pointer to the start.  "words" must include
@@ -1178,6 +1225,8 @@ TaskData *Processes::CreateNewTaskData()
 
     {
         PLocker lock(&schedLock);
+        if (profileMode == kProfileTime || profileUsesCounter(profileMode))
+            taskData->profileSamples = new ProfileSampleBuffer;
         // See if there's a spare entry in the array.
         for (thrdIndex = 0;
                 thrdIndex < taskArray.size() && taskArray[thrdIndex] != 0;
@@ -1252,6 +1301,7 @@ static void *NewThreadFunction(void *parameter)
     taskData->saveVec.init(); // Remove initial data
     globalStats.incCount(PSC_THREADS);
     processes->ThreadUseMLMemory(taskData);
+    profileCounterCheck(taskData); // If we are profiling with a hardware counter.
     try {
         taskData->EnterPolyCode(); // Will normally (always?) call ExitThread.
     }
@@ -1396,6 +1446,9 @@ void Processes::BeginRootThread(PolyObject *rootFunction)
 #endif
                     // The thread ref is no longer valid.
                     *(TaskData**)(p->threadObject->threadRef.AsObjPtr()) = 0;
+                    // Include any profile samples it recorded.
+                    if (p->profileSamples) p->profileSamples->ProcessSamples();
+                    if (p == lastToStop) lastToStop = 0;
                     delete(p); // Delete the task Data
                     *i = 0;
                     globalStats.decCount(PSC_THREADS);
@@ -1414,10 +1467,19 @@ void Processes::BeginRootThread(PolyObject *rootFunction)
         if (allStopped && threadRequest != 0)
         {
             mainThreadPhase = threadRequest->mtp;
+            // Record how long it took for all the threads to stop.
+            if (threadRequestTime != 0)
+            {
+                traceComplete(TRACE_SAFEPOINT, threadRequestTime);
+                ReportSafepointWait();
+            }
+            threadRequestTime = 0;
+            traceBegin(TRACE_ROOT_PERFORM, mainThreadPhase);
             gcProgressBeginOtherGC(); // The default unless we're doing a GC.
             gMem.ProtectImmutable(false); // GC, sharing and export may all write to the immutable area
             threadRequest->Perform();
             gMem.ProtectImmutable(true);
+            traceEnd(TRACE_ROOT_PERFORM, mainThreadPhase);
             mainThreadPhase = MTP_USER_CODE;
             gcProgressReturnToML();
             threadRequest->completed = true;
@@ -1489,8 +1551,8 @@ void Processes::BeginRootThread(PolyObject *rootFunction)
         freeSpace += gMem.GetFreeAllocSpace();
         globalStats.updatePeriodicStats(freeSpace, threadsInML);
 
-        // Process the profile queue if necessary.
-        processProfileQueue();
+        // Process the profile samples if necessary.
+        ProcessProfileSamples();
     }
     schedLock.Unlock();
     finish(exitResult); // Close everything down and exit.
@@ -1530,6 +1592,11 @@ Handle Processes::ForkThread(TaskData *taskData, Handle threadFunction, PolyWord
             raise_exception_string(taskData, EXC_thread, "Thread is exiting");
         }
 
+        // If we're time profiling the thread needs a sample buffer.  Existing
+        // threads are given one when profiling starts.
+        if (profileMode == kProfileTime || profileUsesCounter(profileMode))
+            newTaskData->profileSamples = new ProfileSampleBuffer;
+
         // See if there's a spare entry in the array.
         for (thrdIndex = 0;
              thrdIndex < taskArray.size() && taskArray[thrdIndex] != 0;
@@ -1678,6 +1745,8 @@ bool Processes::ProcessAsynchRequests(TaskData *taskData)
     }
     else ptaskData->runningProfileTimer = false;
     // The timer will be stopped next time it goes off.
+    // Open a hardware counter if we are using one.
+    profileCounterCheck(ptaskData);
 #endif
     return wasInterrupted;
 }
@@ -1839,6 +1908,14 @@ DWORD WINAPI ProfilingTimer(LPVOID parm)
 // Profiling control.  Called by the root thread.
 void Processes::StartProfiling(void)
 {
+    // Allocate the sample buffers now while the threads are stopped.  Threads
+    // created later are given one when they are created.
+    for (std::vector<TaskData*>::iterator i = taskArray.begin(); i != taskArray.end(); i++)
+    {
+        TaskData *taskData = *i;
+        if (taskData && taskData->profileSamples == 0)
+            taskData->profileSamples = new ProfileSampleBuffer;
+    }
 #ifdef HAVE_WINDOWS_H
     DWORD threadId;
     extern FILE *polyStdout;
@@ -1868,12 +1945,19 @@ void Processes::StartProfiling(void)
             taskData->InterruptCode();
         }
     }
-    StartProfilingTimer(); // Start the timer in the root thread.
+    if (profileMode == kProfileTime)
+        StartProfilingTimer(); // Start the timer in the root thread.
 #endif
 }
 
 void Processes::StopProfiling(void)
 {
+    // Close any hardware counters.  The ML threads are stopped.
+    for (std::vector<TaskData*>::iterator i = taskArray.begin(); i != taskArray.end(); i++)
+    {
+        if (*i) profileCounterClose(*i);
+    }
+    profileCounterClose(0);
 #ifdef HAVE_WINDOWS_H
     if (hStopEvent) SetEvent(hStopEvent);
     // Wait for the thread to stop
@@ -1886,6 +1970,18 @@ void Processes::StopProfiling(void)
 #endif
 }
 
+// Process the profile samples of all the threads.  Called by the main thread
+// either with schedLock held or while the other threads are stopped.
+void Processes::ProcessProfileSamples(void)
+{
+    for (std::vector<TaskData*>::iterator i = taskArray.begin(); i != taskArray.end(); i++)
+    {
+        TaskData *taskData = *i;
+        if (taskData && taskData->profileSamples)
+            taskData->profileSamples->ProcessSamples();
+    }
+}
+
 // Called by the ML signal handling thread.  It blocks until a signal
 // arrives.  There should only be a single thread waiting here.
 bool Processes::WaitForSignal(TaskData *taskData, PLock *sigLock)
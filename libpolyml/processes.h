@@ -36,6 +36,7 @@
 
 #include "noreturn.h"
 #include "locking.h"
+#include "tracing.h"
 
 class SaveVecEntry;
 typedef SaveVecEntry *Handle;
@@ -45,6 +46,7 @@ class ScanAddress;
 class MDTaskData;
 class Exporter;
 class StackObject;
+class ProfileSampleBuffer;
 
 #ifdef HAVE_WINDOWS_H
 typedef void *HANDLE;
@@ -132,16 +134,25 @@ public:
     virtual uintptr_t currentStackSpace(void) const = 0;
     // Add a count to the local function if we are using store profiling.
     virtual void addProfileCount(POLYUNSIGNED words) = 0;
+    // Return the code address and stack pointer of the current ML code.  Used
+    // to find the allocating function when sampling allocations.
+    virtual POLYCODEPTR GetProfileSite(stackItem *&sp) = 0;
 
     // Functions called before and after an RTS call.
-    virtual void PreRTSCall(void) { saveVec.init(); }
-    virtual void PostRTSCall(void) {}
+    virtual void PreRTSCall(void) { saveVec.init(); traceBegin(TRACE_RTS_CALL, TRACE_RETURN_ADDRESS); }
+    virtual void PostRTSCall(void) { traceEnd(TRACE_RTS_CALL); }
 
     SaveVec     saveVec;
     PolyWord    *allocPointer;  // Allocation pointer - decremented towards...
     PolyWord    *allocLimit;    // ... lower limit of allocation
     uintptr_t   allocSize;     // The preferred heap segment size
     unsigned    allocCount;     // The number of allocations since the last GC
+    // Allocation sampling.  The number of words to be allocated before the
+    // next sample, the allocation pointer when that was last calculated and
+    // the sampling run it belongs to.
+    POLYUNSIGNED allocSampleCountdown;
+    PolyWord    *allocSampleBase;
+    unsigned    allocSampleEpoch;
     StackSpace  *stack;
     ThreadObject *threadObject;  // Pointer to the thread object.
     int         lastError;      // Last error from foreign code.
@@ -182,6 +193,12 @@ private:
 #endif
 public:
     bool threadExited;
+    // Time profile samples for this thread.  Allocated when profiling starts and
+    // only changed by the main thread or by the thread itself with schedLock held.
+    ProfileSampleBuffer *profileSamples;
+    // File descriptor of the hardware counter used for profiling or -1.
+    // Only changed by the thread itself or by the main thread while it is stopped.
+    int profileCounter;
 private:
 #ifdef HAVE_PTHREAD_H
     pthread_t threadId;
@@ -329,6 +346,9 @@ public:
     // Profiling control.
     virtual void StartProfiling(void) = 0;
     virtual void StopProfiling(void) = 0;
+    // Process the time profile samples of all the threads.  Only called
+    // by the main thread.
+    virtual void ProcessProfileSamples(void) = 0;
     
     // Find space for an object.  Returns a pointer to the start.  "words" must include
     // the length word and the result points at where the length word will go.
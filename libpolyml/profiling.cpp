@@ -37,6 +37,38 @@
 #include <malloc.h>
 #endif
 
+#ifdef HAVE_MATH_H
+#include <math.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_SYS_IOCTL_H
+#include <sys/ioctl.h>
+#endif
+
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#endif
+
 #ifdef HAVE_ASSERT_H
 #include <assert.h>
 #define ASSERT(x) assert(x)
@@ -44,6 +76,10 @@
 #define ASSERT(x) 0
 #endif
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "globals.h"
 #include "arb.h"
 #include "processes.h"
@@ -58,11 +94,24 @@
 #include "sys.h"
 #include "rtsentry.h"
 #include "machine_dep.h"
+#include "sighandler.h"
+
+// Hardware counters are read using perf_event_open.  There is no C library
+// wrapper for this so we need the system call number.  F_SETOWN_EX is needed
+// to direct the signal to the thread that owns the counter.
+#if (defined(HAVE_LINUX_PERF_EVENT_H) && defined(__NR_perf_event_open) && defined(F_SETOWN_EX) && defined(SYS_gettid))
+#define HAVE_PROFILE_COUNTERS 1
+#endif
 
 extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyProfiling(POLYUNSIGNED threadId, POLYUNSIGNED mode);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyProfilingCallGraph(POLYUNSIGNED threadId);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyProfilingAllocSampling(POLYUNSIGNED threadId, POLYUNSIGNED interval);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyProfilingAllocSites(POLYUNSIGNED threadId);
 }
 
+// These counts may be incremented by several threads, including from signal
+// handlers, so they are updated with atomic operations rather than a lock.
 static long mainThreadCounts[MTP_MAXENTRY];
 static const char* const mainThreadText[MTP_MAXENTRY] =
 {
@@ -108,19 +157,93 @@ static const char * const extraStoreText[EST_MAX_ENTRY] =
 
 // Poly strings for "standard" counts.  These are generated from the C strings
 // above the first time profiling is activated.
-static PolyWord psRTSString[MTP_MAXENTRY], psExtraStrings[EST_MAX_ENTRY], psGCTotal;
+static PolyWord psRTSString[MTP_MAXENTRY], psExtraStrings[EST_MAX_ENTRY], psGCTotal, psDropped;
 
 ProfileMode profileMode;
 // If we are just profiling a single thread, this is the thread data.
 static TaskData *singleThreadProfile = 0;
 
-// The queue is processed every 400ms and an entry can be
-// added every ms of CPU time by each thread.
-#define PCQUEUESIZE 4000
+// Atomic operations used for counts that may be updated concurrently.
+#if (defined(_MSC_VER))
+#include <intrin.h>
+static inline void atomicIncrement(long *p) { _InterlockedIncrement(p); }
+#ifdef _WIN64
+static inline void atomicAdd(POLYUNSIGNED *p, POLYUNSIGNED incr) { _InterlockedExchangeAdd64((__int64*)p, incr); }
+#else
+static inline void atomicAdd(POLYUNSIGNED *p, POLYUNSIGNED incr) { _InterlockedExchangeAdd((long*)p, incr); }
+#endif
+// MSVC gives volatile accesses acquire and release semantics.
+#define LOAD_ACQUIRE(x)         (x)
+#define STORE_RELEASE(x, v)     ((x) = (v))
+#else
+static inline void atomicIncrement(long *p) { __atomic_fetch_add(p, 1, __ATOMIC_RELAXED); }
+static inline void atomicAdd(POLYUNSIGNED *p, POLYUNSIGNED incr) { __atomic_fetch_add(p, incr, __ATOMIC_RELAXED); }
+#define LOAD_ACQUIRE(x)         __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(x, v)     __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#endif
+
+// Samples that could not be recorded because the thread's buffer was full
+// or it didn't have one.
+static long droppedSamples;
+
+// Call-graph profiling.  If this is set each time sample also records the
+// return addresses found by scanning the ML stack.  The scan is bounded both in
+// the number of frames recorded and the number of stack words examined since it
+// is done in the signal handler.  The samples are converted into function names
+// when the buffers are processed by the main thread.
+static bool profileCallGraph = false;
 
-static long queuePtr = 0;
-static POLYCODEPTR pcQueue[PCQUEUESIZE];
-static PLock queueLock;
+#define CALLGRAPH_MAX_DEPTH     64
+#define CALLGRAPH_MAX_SCAN      4096
+
+#ifdef HAVE_PROFILE_COUNTERS
+// Hardware counter profiling.  Each thread opens a counter that is set to
+// overflow after counterPeriod events.  It is refreshed for a single overflow
+// at a time which disables it and sends SIGPROF to the thread.  The signal
+// handler records the sample and refreshes the counter again.  The counter for
+// the main thread, which runs the GC, is opened when profiling starts.
+#define PROFILE_COUNTER_SIGNAL  SIGPROF
+
+static uint64_t counterConfig, counterPeriod;
+static int rootProfileCounter = -1;
+#endif
+
+// Allocation sampling.  Rather than counting every allocation a sample is
+// taken on average every allocSampleInterval words, with the intervals chosen
+// at random from an exponential distribution.  Each sample records the function
+// that allocated the object and a few of its callers.  The sampled objects are
+// held as weak references so that we can estimate the memory retained by each
+// site.  Unlike the other profiling modes this can be left running.
+#define ALLOCSAMPLE_MAX_DEPTH   16
+
+// Mean number of words between samples.  Zero if sampling is off.
+static POLYUNSIGNED allocSampleInterval = 0;
+// Incremented each time sampling is started so that threads recalculate their countdown.
+static unsigned allocSampleEpoch = 0;
+static uint64_t allocSampleRandom = 88172645463325252ULL;
+
+typedef struct {
+    POLYUNSIGNED samples;
+    double words; // Estimated words allocated.
+} AllocSite;
+
+typedef std::map<std::vector<std::string>, AllocSite> AllocSiteTable;
+
+typedef struct {
+    PolyObject *obj; // Weak reference: set to zero by the GC if it is unreachable.
+    double words; // The number of words this sample represents.
+    const AllocSiteTable::value_type *site;
+} AllocSample;
+
+static AllocSiteTable allocSites;
+static std::vector<AllocSample> allocSamples;
+static PLock allocSampleLock;
+
+// Accumulated counts for each distinct stack.  The names are in order with the
+// function that was executing first.
+typedef std::map<std::vector<std::string>, POLYUNSIGNED> CallGraphTable;
+static CallGraphTable callGraphCounts;
+static PLock callGraphLock;
 
 typedef struct _PROFENTRY
 {
@@ -163,11 +286,6 @@ ProfileRequest::~ProfileRequest()
     }
 }
 
-// Lock to serialise updates of counts. Only used during update.
-// Not required when we print the counts since there's only one thread
-// running then.
-static PLock countLock;
-
 // Get the profile object associated with a piece of code.  Returns null if
 // there isn't one, in particular if this is in the old format.
 static PolyObject *getProfileObjectForCode(PolyObject *code)
@@ -184,7 +302,7 @@ static PolyObject *getProfileObjectForCode(PolyObject *code)
 }
 
 // Adds incr to the profile count for the function pointed at by
-// pc or by one of its callers.
+// pc or by one of its callers.  This may be called by any thread.
 void addSynchronousCount(POLYCODEPTR fpc, POLYUNSIGNED incr)
 {
     // Check that the pc value is within the heap.  It could be
@@ -194,20 +312,12 @@ void addSynchronousCount(POLYCODEPTR fpc, POLYUNSIGNED incr)
     {
         PolyObject *profObject = getProfileObjectForCode(codeObj);
         if (profObject)
-        {
-            PLocker locker(&countLock);
-            profObject->Set(0, PolyWord::FromUnsigned(profObject->Get(0).AsUnsigned() + incr));
-        }
+            atomicAdd((POLYUNSIGNED*)profObject, incr);
     }
     // Didn't find it.
-    else
-    {
-        PLocker locker(&countLock);
-        mainThreadCounts[MTP_USER_CODE]++;
-    }
+    else atomicIncrement(&mainThreadCounts[MTP_USER_CODE]);
 }
 
-
 // newProfileEntry - Make a new entry in the list
 PPROFENTRY ProfileRequest::newProfileEntry(void)
 {
@@ -315,6 +425,15 @@ void ProfileRequest::getResults(void)
         }
     }
 
+    if (droppedSamples)
+    {
+        PPROFENTRY pEnt = newProfileEntry();
+        if (pEnt == 0) return;
+        pEnt->count = droppedSamples;
+        pEnt->functionName = psDropped;
+        droppedSamples = 0;
+    }
+
     for (unsigned l = 0; l < EST_MAX_ENTRY; l++)
     {
         if (extraStoreCounts[l])
@@ -351,38 +470,206 @@ Handle ProfileRequest::extractAsList(TaskData *taskData)
     return list;
 }
 
+static inline bool isCodeAddress(POLYCODEPTR pc)
+{
+    MemSpace *space = gMem.SpaceForAddress(pc);
+    return space != 0 && space->isCode;
+}
+
+// Add the return addresses found on the stack above sp to pcs.  Any word on
+// the stack that points into a code area is taken to be a return address.
+// This may include some stale entries.  Returns the new depth.
+static unsigned scanReturnAddresses(StackSpace *stack, stackItem *sp, POLYCODEPTR *pcs, unsigned depth, unsigned maxDepth)
+{
+    if (stack == 0) return depth;
+    stackItem *top = (stackItem*)stack->top;
+    if (sp < (stackItem*)stack->bottom || sp >= top) return depth;
+    stackItem *limit = top - sp > CALLGRAPH_MAX_SCAN ? sp + CALLGRAPH_MAX_SCAN : top;
+    for (stackItem *p = sp; p < limit && depth < maxDepth; p++)
+    {
+        POLYCODEPTR retAddr = p->codeAddr;
+        if (isCodeAddress(retAddr))
+            pcs[depth++] = retAddr;
+    }
+    return depth;
+}
+
+// Convert a list of code addresses into function names.  Addresses that are
+// not within a named function are ignored.
+static void codeAddressesToNames(POLYCODEPTR *pcs, unsigned depth, std::vector<std::string> &names)
+{
+    for (unsigned i = 0; i < depth; i++)
+    {
+        PolyObject *codeObj = gMem.FindCodeObject(pcs[i]);
+        if (codeObj == 0) continue;
+        PolyWord name = machineDependent->ConstPtrForCode(codeObj)[0];
+        if (name == TAGGED(0)) continue;
+        names.push_back(PolyStringToCString(name));
+    }
+}
+
+ProfileSampleBuffer::ProfileSampleBuffer(): head(0), tail(0), dropped(0), droppedReported(0)
+{
+}
+
+// Called only by the producer.  Returns false if there is no room.
+bool ProfileSampleBuffer::AddSample(const POLYCODEPTR *pcs, unsigned count)
+{
+    uintptr_t t = tail, h = LOAD_ACQUIRE(head);
+    if (PROFILE_BUFFER_SIZE - (t - h) < count + 1)
+    {
+        dropped++;
+        return false;
+    }
+    entries[t & (PROFILE_BUFFER_SIZE-1)] = count;
+    for (unsigned i = 0; i < count; i++)
+        entries[(t + i + 1) & (PROFILE_BUFFER_SIZE-1)] = (uintptr_t)pcs[i];
+    STORE_RELEASE(tail, t + count + 1);
+    return true;
+}
+
 // We have had an asynchronous interrupt and found a potential PC but
-// we're in a signal handler.
-void incrementCountAsynch(POLYCODEPTR pc)
+// we're in a signal handler.  Add it to the thread's buffer.  This must
+// not take any locks.
+void incrementCountAsynch(TaskData *taskData, POLYCODEPTR pc, stackItem *sp)
 {
-    PLocker locker(&queueLock);
-    int q = queuePtr++;
-    if (q < PCQUEUESIZE) pcQueue[q] = pc;
+    POLYCODEPTR pcs[CALLGRAPH_MAX_DEPTH];
+    unsigned depth = 0;
+    pcs[depth++] = pc;
+
+    if (profileCallGraph)
+        depth = scanReturnAddresses(taskData->stack, sp, pcs, depth, CALLGRAPH_MAX_DEPTH);
+
+    if (taskData->profileSamples == 0)
+        atomicIncrement(&droppedSamples);
+    else taskData->profileSamples->AddSample(pcs, depth);
 }
 
-// Called by the main thread to process the queue of PC values
-void processProfileQueue()
+// Convert a sample into a list of function names and add it to the table.
+static void addCallGraphSample(POLYCODEPTR *pcs, unsigned depth)
 {
-    while (1)
+    std::vector<std::string> stack;
+    codeAddressesToNames(pcs, depth, stack);
+    if (stack.empty()) return;
+    PLocker locker(&callGraphLock);
+    callGraphCounts[stack]++;
+}
+
+// Called only by the consumer, the main thread, to process all the samples
+// currently in the buffer.
+void ProfileSampleBuffer::ProcessSamples()
+{
+    uintptr_t h = head, t = LOAD_ACQUIRE(tail);
+    while (h != t)
     {
-        POLYCODEPTR pc = 0;
-        {
-            PLocker locker(&queueLock);
-            if (queuePtr == 0) return;
-            if (queuePtr < PCQUEUESIZE)
-                pc = pcQueue[queuePtr];
-            queuePtr--;
-        }
-        if (pc != 0)
-            addSynchronousCount(pc, 1);
-        else
-        {
-            PLocker locker(&countLock);
-            mainThreadCounts[MTP_USER_CODE]++;
-        }
+        POLYCODEPTR pcs[CALLGRAPH_MAX_DEPTH];
+        unsigned count = (unsigned)entries[h & (PROFILE_BUFFER_SIZE-1)];
+        for (unsigned i = 0; i < count; i++)
+            pcs[i] = (POLYCODEPTR)entries[(h + i + 1) & (PROFILE_BUFFER_SIZE-1)];
+        h += count + 1;
+        if (count == 0) continue; // AddSample never records empty samples.
+        addSynchronousCount(pcs[0], 1);
+        if (profileCallGraph)
+            addCallGraphSample(pcs, count);
+    }
+    STORE_RELEASE(head, h);
+    // The dropped count is only updated by the producer so we take the
+    // difference from the last time.
+    unsigned long d = dropped;
+    if (d != droppedReported)
+    {
+        droppedSamples += (long)(d - droppedReported);
+        droppedReported = d;
+    }
+}
+
+// Choose the number of words until the next sample.  Must be called with
+// allocSampleLock held.
+static POLYUNSIGNED nextAllocSample()
+{
+    // Xorshift generator.  We don't need anything better.
+    allocSampleRandom ^= allocSampleRandom >> 12;
+    allocSampleRandom ^= allocSampleRandom << 25;
+    allocSampleRandom ^= allocSampleRandom >> 27;
+    uint64_t r = allocSampleRandom * 2685821657736338717ULL;
+    double u = ((double)(r >> 11) + 0.5) / 9007199254740992.0; // In (0,1)
+    return (POLYUNSIGNED)(-log(u) * (double)allocSampleInterval);
+}
+
+// If sampling has been restarted since this thread last sampled, start a new countdown.
+static void checkAllocSampleEpoch(TaskData *taskData)
+{
+    if (taskData->allocSampleEpoch != allocSampleEpoch)
+    {
+        PLocker locker(&allocSampleLock);
+        taskData->allocSampleCountdown = nextAllocSample();
+        taskData->allocSampleEpoch = allocSampleEpoch;
     }
 }
 
+PolyWord *allocationSampleLimit(TaskData *taskData)
+{
+    taskData->allocSampleBase = 0;
+    if (allocSampleInterval == 0)
+        return taskData->allocLimit;
+    checkAllocSampleEpoch(taskData);
+    taskData->allocSampleBase = taskData->allocPointer;
+    if ((POLYUNSIGNED)(taskData->allocPointer - taskData->allocLimit) > taskData->allocSampleCountdown)
+        return taskData->allocPointer - taskData->allocSampleCountdown;
+    else return taskData->allocLimit;
+}
+
+void allocationSampleAccount(TaskData *taskData)
+{
+    PolyWord *base = taskData->allocSampleBase;
+    taskData->allocSampleBase = 0;
+    // If the allocation area has changed, e.g. when running the interpreter, we can't tell.
+    if (base == 0 || taskData->allocPointer > base || taskData->allocPointer < taskData->allocLimit)
+        return;
+    POLYUNSIGNED used = (POLYUNSIGNED)(base - taskData->allocPointer);
+    if (used >= taskData->allocSampleCountdown)
+        taskData->allocSampleCountdown = 0;
+    else taskData->allocSampleCountdown -= used;
+}
+
+void allocationSampleCheck(TaskData *taskData, PolyObject *obj, POLYUNSIGNED words)
+{
+    if (allocSampleInterval == 0) return;
+    checkAllocSampleEpoch(taskData);
+    if (words <= taskData->allocSampleCountdown)
+    {
+        taskData->allocSampleCountdown -= words;
+        return;
+    }
+
+    stackItem *sp = 0;
+    POLYCODEPTR pcs[ALLOCSAMPLE_MAX_DEPTH];
+    unsigned depth = 0;
+    pcs[depth++] = taskData->GetProfileSite(sp);
+    depth = scanReturnAddresses(taskData->stack, sp, pcs, depth, ALLOCSAMPLE_MAX_DEPTH);
+    std::vector<std::string> names;
+    codeAddressesToNames(pcs, depth, names);
+    if (names.empty()) names.push_back(mainThreadText[MTP_USER_CODE]);
+
+    PLocker locker(&allocSampleLock);
+    if (allocSampleInterval == 0) return;
+    // The probability that an object of this size is sampled is 1-exp(-words/interval)
+    // so to give an unbiased estimate each sample represents the size divided by that.
+    double interval = (double)allocSampleInterval;
+    double weight = (double)words / (1.0 - exp(-(double)words / interval));
+    AllocSiteTable::iterator site = allocSites.find(names);
+    if (site == allocSites.end())
+    {
+        AllocSite newSite = { 0, 0.0 };
+        site = allocSites.insert(AllocSiteTable::value_type(names, newSite)).first;
+    }
+    site->second.samples++;
+    site->second.words += weight;
+    AllocSample sample = { obj, weight, &*site };
+    allocSamples.push_back(sample);
+    taskData->allocSampleCountdown = nextAllocSample();
+}
+
 // Handle a SIGVTALRM or the simulated equivalent in Windows.  This may be called
 // at any time so we have to be careful.  In particular in Linux this may be
 // executed by a thread while holding a mutex so we must not do anything, such
@@ -395,20 +682,113 @@ void handleProfileTrap(TaskData *taskData, SIGNALCONTEXT *context)
     if (mainThreadPhase == MTP_USER_CODE)
     {
         if (taskData == 0 || !taskData->AddTimeProfileCount(context))
-        {
-            PLocker lock(&countLock);
-            mainThreadCounts[MTP_USER_CODE]++;
-        }
+            atomicIncrement(&mainThreadCounts[MTP_USER_CODE]);
         // On Mac OS X all virtual timer interrupts seem to be directed to the root thread
         // so all the counts will be "unknown".
     }
-    else
+    else atomicIncrement(&mainThreadCounts[mainThreadPhase]);
+}
+
+#ifdef HAVE_PROFILE_COUNTERS
+// Open a counter for the current thread.  Returns -1 with errno set on failure.
+static int openProfileCounter(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = counterConfig;
+    attr.sample_period = counterPeriod;
+    attr.disabled = 1;
+    // Only count events in user space.  This is all that is allowed by
+    // the default setting of perf_event_paranoid.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    unsigned long flags = 0;
+#ifdef PERF_FLAG_FD_CLOEXEC
+    flags = PERF_FLAG_FD_CLOEXEC;
+#endif
+    int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, flags);
+    if (fd < 0) return -1;
+    struct f_owner_ex owner;
+    owner.type = F_OWNER_TID;
+    owner.pid = (pid_t)syscall(SYS_gettid);
+    if (fcntl(fd, F_SETOWN_EX, &owner) < 0 ||
+        fcntl(fd, F_SETSIG, PROFILE_COUNTER_SIGNAL) < 0 ||
+        fcntl(fd, F_SETFL, O_ASYNC) < 0 ||
+        ioctl(fd, PERF_EVENT_IOC_REFRESH, 1) < 0)
     {
-        PLocker lock(&countLock);
-        mainThreadCounts[mainThreadPhase]++;
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
     }
+    return fd;
 }
 
+// Called by the main thread when profiling is started.  Returns an error message
+// if the counter cannot be used.
+static const char *startProfileCounters(ProfileMode mode)
+{
+    switch (mode)
+    {
+    case kProfileCycles:
+        counterConfig = PERF_COUNT_HW_CPU_CYCLES;
+        counterPeriod = 2000000; // Roughly one sample per ms.
+        break;
+    case kProfileCacheMisses:
+        counterConfig = PERF_COUNT_HW_CACHE_MISSES;
+        counterPeriod = 10007;
+        break;
+    default:
+        counterConfig = PERF_COUNT_HW_BRANCH_MISSES;
+        counterPeriod = 10007;
+        break;
+    }
+    rootProfileCounter = openProfileCounter();
+    if (rootProfileCounter >= 0)
+        return 0;
+    else if (errno == EACCES || errno == EPERM)
+        return "Not permitted to use hardware counters (see perf_event_paranoid)";
+    else return "Hardware counters are not available";
+}
+
+static void catchProfileCounter(SIG_HANDLER_ARGS(sig, context))
+{
+    TaskData *taskData = processes->GetTaskDataForThread();
+    int fd = taskData == 0 ? rootProfileCounter : taskData->profileCounter;
+    // If profiling has stopped leave the counter disabled.  It is closed later.
+    if (fd < 0 || !profileUsesCounter(profileMode))
+        return;
+    handleProfileTrap(taskData, (SIGNALCONTEXT*)context);
+    ioctl(fd, PERF_EVENT_IOC_REFRESH, 1);
+}
+
+void profileCounterCheck(TaskData *taskData)
+{
+    if (profileUsesCounter(profileMode) && taskData->profileCounter < 0)
+        taskData->profileCounter = openProfileCounter();
+}
+
+// If taskData is null this closes the counter for the main thread.
+void profileCounterClose(TaskData *taskData)
+{
+    int *counter = taskData == 0 ? &rootProfileCounter : &taskData->profileCounter;
+    int fd = *counter;
+    *counter = -1; // Clear this first in case of a signal.
+    if (fd >= 0) close(fd);
+}
+
+#else
+static const char *startProfileCounters(ProfileMode)
+{
+    return "Hardware counters are not available";
+}
+
+void profileCounterCheck(TaskData *) {}
+void profileCounterClose(TaskData *) {}
+#endif
+
 // Called from the GC when allocation profiling is on.
 void AddObjectProfile(PolyObject *obj)
 {
@@ -488,6 +868,8 @@ static Handle profilerc(TaskData *taskData, Handle mode_handle)
         }
         if (psGCTotal == TAGGED(0))
             psGCTotal = C_string_to_Poly(taskData, "GARBAGE COLLECTION (total)");
+        if (psDropped == TAGGED(0))
+            psDropped = C_string_to_Poly(taskData, "Samples dropped (buffer full)");
     }
     // All these actions are performed by the root thread.  Only profile
     // printing needs to be performed with all the threads stopped but it's
@@ -517,6 +899,160 @@ POLYUNSIGNED PolyProfiling(POLYUNSIGNED threadId, POLYUNSIGNED mode)
     else return result->Word().AsUnsigned();
 }
 
+// Return the stacks recorded by call-graph profiling as a list of pairs of the count
+// and the list of function names, innermost first.  The table is cleared.
+POLYUNSIGNED PolyProfilingCallGraph(POLYUNSIGNED threadId)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+
+    try {
+        // Take the table while holding the lock but don't allocate ML memory
+        // until it has been released.
+        CallGraphTable table;
+        {
+            PLocker locker(&callGraphLock);
+            table.swap(callGraphCounts);
+        }
+        Handle saved = taskData->saveVec.mark();
+        Handle list = taskData->saveVec.push(ListNull);
+        for (CallGraphTable::iterator i = table.begin(); i != table.end(); i++)
+        {
+            const std::vector<std::string> &stack = i->first;
+            Handle names = taskData->saveVec.push(ListNull);
+            for (size_t j = stack.size(); j > 0; j--)
+            {
+                Handle name = taskData->saveVec.push(C_string_to_Poly(taskData, stack[j-1].c_str()));
+                Handle cell = alloc_and_save(taskData, sizeof(ML_Cons_Cell) / sizeof(PolyWord));
+                DEREFLISTHANDLE(cell)->h = name->Word();
+                DEREFLISTHANDLE(cell)->t = names->Word();
+                names = cell;
+            }
+            Handle countValue = Make_arbitrary_precision(taskData, i->second);
+            Handle pair = alloc_and_save(taskData, 2);
+            pair->WordP()->Set(0, countValue->Word());
+            pair->WordP()->Set(1, names->Word());
+            Handle next = alloc_and_save(taskData, sizeof(ML_Cons_Cell) / sizeof(PolyWord));
+            DEREFLISTHANDLE(next)->h = pair->Word();
+            DEREFLISTHANDLE(next)->t = list->Word();
+
+            taskData->saveVec.reset(saved);
+            list = taskData->saveVec.push(next->Word());
+        }
+        result = list;
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+// Start or stop allocation sampling.  The argument is the mean number of bytes
+// between samples or zero to stop sampling.  Starting sampling discards any
+// existing samples.  When sampling is stopped the samples are retained so that
+// they can still be examined.
+POLYUNSIGNED PolyProfilingAllocSampling(POLYUNSIGNED threadId, POLYUNSIGNED interval)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle pushedArg = taskData->saveVec.push(interval);
+
+    try {
+        POLYUNSIGNED bytes = getPolyUnsigned(taskData, pushedArg->Word());
+        PLocker locker(&allocSampleLock);
+        if (bytes == 0)
+            allocSampleInterval = 0;
+        else
+        {
+            allocSites.clear();
+            allocSamples.clear();
+            allocSampleInterval = (bytes + sizeof(PolyWord) - 1) / sizeof(PolyWord);
+            allocSampleEpoch++;
+        }
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(0).AsUnsigned();
+}
+
+// Return the allocation sites as a list of tuples containing the list of
+// function names, innermost first, the number of samples, the estimated number
+// of bytes allocated and the estimated number of bytes that were still reachable
+// at the last garbage collection.
+POLYUNSIGNED PolyProfilingAllocSites(POLYUNSIGNED threadId)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+
+    try {
+        // Copy the information while holding the lock and then create the ML data.
+        typedef struct { std::vector<std::string> names; POLYUNSIGNED samples; double allocated, retained; } SiteInfo;
+        std::vector<SiteInfo> sites;
+        {
+            PLocker locker(&allocSampleLock);
+            std::map<const AllocSiteTable::value_type*, double> retained;
+            for (std::vector<AllocSample>::iterator i = allocSamples.begin(); i != allocSamples.end(); i++)
+            {
+                if (i->obj != 0)
+                    retained[i->site] += i->words;
+            }
+            for (AllocSiteTable::iterator i = allocSites.begin(); i != allocSites.end(); i++)
+            {
+                SiteInfo info;
+                info.names = i->first;
+                info.samples = i->second.samples;
+                info.allocated = i->second.words * sizeof(PolyWord);
+                info.retained = retained[&*i] * sizeof(PolyWord);
+                sites.push_back(info);
+            }
+        }
+        Handle saved = taskData->saveVec.mark();
+        Handle list = taskData->saveVec.push(ListNull);
+        for (std::vector<SiteInfo>::iterator i = sites.begin(); i != sites.end(); i++)
+        {
+            Handle names = taskData->saveVec.push(ListNull);
+            for (size_t j = i->names.size(); j > 0; j--)
+            {
+                Handle name = taskData->saveVec.push(C_string_to_Poly(taskData, i->names[j-1].c_str()));
+                Handle cell = alloc_and_save(taskData, sizeof(ML_Cons_Cell) / sizeof(PolyWord));
+                DEREFLISTHANDLE(cell)->h = name->Word();
+                DEREFLISTHANDLE(cell)->t = names->Word();
+                names = cell;
+            }
+            Handle samples = Make_arbitrary_precision(taskData, i->samples);
+            Handle allocated = Make_arbitrary_precision(taskData, (POLYUNSIGNED)i->allocated);
+            Handle retained = Make_arbitrary_precision(taskData, (POLYUNSIGNED)i->retained);
+            Handle tuple = alloc_and_save(taskData, 4);
+            tuple->WordP()->Set(0, names->Word());
+            tuple->WordP()->Set(1, samples->Word());
+            tuple->WordP()->Set(2, allocated->Word());
+            tuple->WordP()->Set(3, retained->Word());
+            Handle next = alloc_and_save(taskData, sizeof(ML_Cons_Cell) / sizeof(PolyWord));
+            DEREFLISTHANDLE(next)->h = tuple->Word();
+            DEREFLISTHANDLE(next)->t = list->Word();
+
+            taskData->saveVec.reset(saved);
+            list = taskData->saveVec.push(next->Word());
+        }
+        result = list;
+    } catch (...) { } // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 // This is called from the root thread when all the ML threads have been paused.
 void ProfileRequest::Perform()
 {
@@ -535,11 +1071,27 @@ void ProfileRequest::Perform()
         // Turn off old profiling mechanism and print out accumulated results 
         profileMode = kProfileOff;
         processes->StopProfiling();
+        processes->ProcessProfileSamples(); // Include any samples still in the buffers.
+        profileCallGraph = false;
         getResults();
         // Remove all the bitmaps to free up memory
         gMem.RemoveProfilingBitmaps(); 
         break;
 
+    case kProfileTimeCallGraphThread:
+        singleThreadProfile = pCallingThread;
+        // And drop through to kProfileTimeCallGraph
+
+    case kProfileTimeCallGraph:
+        {
+            PLocker locker(&callGraphLock);
+            callGraphCounts.clear();
+        }
+        profileCallGraph = true;
+        profileMode = kProfileTime;
+        processes->StartProfiling();
+        break;
+
     case kProfileTimeThread:
         singleThreadProfile = pCallingThread;
         // And drop through to kProfileTime
@@ -549,6 +1101,30 @@ void ProfileRequest::Perform()
         processes->StartProfiling();
         break;
 
+    case kProfileCyclesCallGraph:
+    case kProfileCacheMissesCallGraph:
+    case kProfileBranchMissesCallGraph:
+    case kProfileCycles:
+    case kProfileCacheMisses:
+    case kProfileBranchMisses:
+        {
+            bool callGraph = mode >= kProfileCyclesCallGraph;
+            ProfileMode counterMode =
+                (ProfileMode)(callGraph ? mode - kProfileCyclesCallGraph + kProfileCycles : mode);
+            errorMessage = startProfileCounters(counterMode);
+            if (errorMessage != 0)
+                break;
+            if (callGraph)
+            {
+                PLocker locker(&callGraphLock);
+                callGraphCounts.clear();
+            }
+            profileCallGraph = callGraph;
+            profileMode = counterMode;
+            processes->StartProfiling();
+        }
+        break;
+
     case kProfileStoreAllocation:
         profileMode = kProfileStoreAllocation;
         break;
@@ -579,6 +1155,9 @@ struct _entrypts profilingEPT[] =
 {
     // Profiling
     { "PolyProfiling",                  (polyRTSFunction)&PolyProfiling},
+    { "PolyProfilingCallGraph",         (polyRTSFunction)&PolyProfilingCallGraph},
+    { "PolyProfilingAllocSampling",     (polyRTSFunction)&PolyProfilingAllocSampling},
+    { "PolyProfilingAllocSites",        (polyRTSFunction)&PolyProfilingAllocSites},
 
     { NULL, NULL} // End of list.
 };
@@ -599,6 +1178,10 @@ void Profiling::Init(void)
     // Reset profiling counts.
     profileMode = kProfileOff;
     for (unsigned k = 0; k < MTP_MAXENTRY; k++) mainThreadCounts[k] = 0;
+#ifdef HAVE_PROFILE_COUNTERS
+    markSignalInuse(PROFILE_COUNTER_SIGNAL);
+    setSignalHandler(PROFILE_COUNTER_SIGNAL, catchProfileCounter);
+#endif
 }
 
 void Profiling::GarbageCollect(ScanAddress *process)
@@ -609,4 +1192,15 @@ void Profiling::GarbageCollect(ScanAddress *process)
     for (unsigned k = 0; k < EST_MAX_ENTRY; k++)
         process->ScanRuntimeWord(&psExtraStrings[k]);
     process->ScanRuntimeWord(&psGCTotal);
+    process->ScanRuntimeWord(&psDropped);
+
+    // The sampled objects are weak references.  Remove any that are no longer reachable.
+    size_t j = 0;
+    for (size_t i = 0; i < allocSamples.size(); i++)
+    {
+        process->ScanRuntimeAddress(&allocSamples[i].obj, ScanAddress::STRENGTH_WEAK);
+        if (allocSamples[i].obj != 0)
+            allocSamples[j++] = allocSamples[i];
+    }
+    allocSamples.resize(j);
 }
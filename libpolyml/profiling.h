@@ -26,6 +26,7 @@
 class SaveVecEntry;
 typedef SaveVecEntry *Handle;
 class TaskData;
+union stackItem;
 
 // Current profiling mode
 typedef enum {
@@ -36,25 +37,85 @@ typedef enum {
     kProfileLiveData,
     kProfileLiveMutables,
     kProfileTimeThread,
-    kProfileMutexContention
+    kProfileMutexContention,
+    kProfileTimeCallGraph,
+    kProfileTimeCallGraphThread,
+    kProfileCycles,         // Hardware counters.
+    kProfileCacheMisses,
+    kProfileBranchMisses,
+    kProfileCyclesCallGraph,
+    kProfileCacheMissesCallGraph,
+    kProfileBranchMissesCallGraph
 } ProfileMode;
 
 extern ProfileMode profileMode;
 
+// True if profileMode is one of the hardware counter modes.  The call-graph
+// variants are only used in requests.
+inline bool profileUsesCounter(ProfileMode mode)
+{
+    return mode == kProfileCycles || mode == kProfileCacheMisses || mode == kProfileBranchMisses;
+}
+
 #include "processes.h" // For SIGNALCONTEXT
 
 // Handle a SIGVTALRM or the simulated equivalent in Windows.
 extern void handleProfileTrap(TaskData *taskData, SIGNALCONTEXT *context);
 // Add count.  Must not be called from a signal handler.
 extern void addSynchronousCount(POLYCODEPTR pc, POLYUNSIGNED incr);
-// Add one to the timing counter.  May occur at any time.
-extern void incrementCountAsynch(POLYCODEPTR pc);
-// Process the queue of profile pc values if we're time profiling.
-// Only called by the main thread.
-extern void processProfileQueue();
+// Add one to the timing counter.  May occur at any time, including in a
+// signal handler, and must not take any locks.  The sample is added to the
+// thread's profile buffer.  If call-graph profiling is enabled and sp is within
+// the stack the return addresses above sp are recorded as well.
+extern void incrementCountAsynch(TaskData *taskData, POLYCODEPTR pc, stackItem *sp = 0);
+
+// Size of a profile sample buffer in words.  Must be a power of two.  The
+// buffers are processed every 400ms and a thread may add a sample every ms
+// so this allows for call-graph samples of up to 80 words.
+#define PROFILE_BUFFER_SIZE     32768
+
+// Each thread being time profiled has a buffer of samples.  There is a single
+// producer, the thread itself when it is interrupted, and a single consumer,
+// the main thread, so no locking is needed.  Each sample is a count followed
+// by that number of pc values.  If the buffer is full the sample is dropped
+// and counted.
+class ProfileSampleBuffer
+{
+public:
+    ProfileSampleBuffer();
+
+    bool AddSample(const POLYCODEPTR *pcs, unsigned count);
+    // Process all the samples in the buffer.  Only called by the main thread.
+    void ProcessSamples();
+
+private:
+    uintptr_t entries[PROFILE_BUFFER_SIZE];
+    volatile uintptr_t head; // Next entry to be read.  Updated by the consumer.
+    volatile uintptr_t tail; // Next entry to be written.  Updated by the producer.
+    volatile unsigned long dropped; // Updated by the producer.
+    unsigned long droppedReported; // Used by the consumer.
+};
 
 extern void AddObjectProfile(PolyObject *obj);
 
+// Hardware counter profiling.  Each ML thread has its own counter and the
+// overflow signal is treated like SIGVTALRM.  profileCounterCheck is called
+// by a thread when it processes asynchronous requests and opens a counter
+// if one is needed.  profileCounterClose may be called by the main thread
+// when the ML threads are stopped or when the thread data is deleted.
+extern void profileCounterCheck(TaskData *taskData);
+extern void profileCounterClose(TaskData *taskData);
+
+// Allocation sampling.  allocationSampleLimit returns the lower limit for
+// allocation by compiled code so that it traps when the next sample is due.
+// allocationSampleAccount must be called when returning from ML code to count
+// the memory that was allocated.  allocationSampleCheck is called after an
+// object has been allocated by the run-time system or after a trap and
+// records a sample if one is due.
+extern PolyWord *allocationSampleLimit(TaskData *taskData);
+extern void allocationSampleAccount(TaskData *taskData);
+extern void allocationSampleCheck(TaskData *taskData, PolyObject *obj, POLYUNSIGNED words);
+
 extern struct _entrypts profilingEPT[];
 
 #endif /* _PROFILING_H_DEFINED */
@@ -57,6 +57,7 @@ these has filled up it fails and a full garbage collection must be done.
 #include "gctaskfarm.h"
 #include "statistics.h"
 #include "gc_progress.h"
+#include "tracing.h"
 
 // This protects access to the gMem.lSpace table.
 static PLock localTableLock("Minor GC tables");
@@ -523,6 +524,8 @@ bool RunQuickGC(const POLYUNSIGNED wordsRequiredToAllocate)
         return false;
 
     gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeStart);
+    globalStats.startGCTimer();
+    traceBegin(TRACE_GC_MINOR);
     globalStats.incCount(PSC_GC_PARTIALGC);
     mainThreadPhase = MTP_GCQUICK;
     succeeded = true;
@@ -685,6 +688,8 @@ bool RunQuickGC(const POLYUNSIGNED wordsRequiredToAllocate)
     if (succeeded)
     {
         gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeEnd);
+        globalStats.recordGCPause(PSH_MINOR_GC);
+        traceEnd(TRACE_GC_MINOR);
 
         if (! gHeapSizeParameters.AdjustSizeAfterMinorGC(spaceAfterGC, spaceBeforeGC)) // Adjust the allocation size.
             return false; // If necessary trigger a full GC immediately
@@ -706,6 +711,8 @@ bool RunQuickGC(const POLYUNSIGNED wordsRequiredToAllocate)
         // There was insufficient room to copy everything.  We will need to
         // run a full GC.
         gHeapSizeParameters.RecordGCTime(HeapSizeParameters::GCTimeEnd);
+        globalStats.recordGCPause(PSH_MINOR_GC);
+        traceEnd(TRACE_GC_MINOR);
         if (debugOptions & DEBUG_GC)
             Log("GC: Quick GC failed\n");
     }
@@ -131,6 +131,8 @@ extern "C" {
     POLYEXTERNALSYMBOL double PolyRealNextAfter(double arg1, double arg2);
     POLYEXTERNALSYMBOL double PolyRealLdexp(double arg1, POLYUNSIGNED arg2);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyRealFrexp(POLYUNSIGNED threadId, POLYUNSIGNED arg);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyRealArrayMap(POLYUNSIGNED threadId, POLYUNSIGNED code, POLYUNSIGNED src, POLYUNSIGNED dst, POLYUNSIGNED indexes);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyRealArrayFold(POLYUNSIGNED threadId, POLYUNSIGNED code, POLYUNSIGNED arr1, POLYUNSIGNED arr2, POLYUNSIGNED indexes);
     POLYEXTERNALSYMBOL float PolyRealFSqrt(float arg);
     POLYEXTERNALSYMBOL float PolyRealFSin(float arg);
     POLYEXTERNALSYMBOL float PolyRealFCos(float arg);
@@ -441,6 +443,149 @@ POLYUNSIGNED PolyRealFrexp(POLYUNSIGNED threadId, POLYUNSIGNED arg)
     else return result->Word().AsUnsigned();
 }
 
+// Operations on arrays of reals.  A real array is a vector of pointers to boxes
+// so applying a function to each element in ML needs a call and a new box for
+// each one.  These process a whole slice at once.  The values are copied into a
+// local buffer so that the loop over the buffer can use vector instructions
+// where the compiler can generate them.
+#define REAL_ARRAY_BLOCK 256
+
+static void realArrayApply(unsigned code, double *values, unsigned n)
+{
+    unsigned i;
+    switch (code)
+    {
+    case 0: for (i = 0; i < n; i++) values[i] = sqrt(values[i]); break;
+    case 1: for (i = 0; i < n; i++) values[i] = PolyRealExp(values[i]); break;
+    case 2: for (i = 0; i < n; i++) values[i] = PolyRealLog(values[i]); break;
+    case 3: for (i = 0; i < n; i++) values[i] = PolyRealSin(values[i]); break;
+    case 4: for (i = 0; i < n; i++) values[i] = PolyRealCos(values[i]); break;
+    case 5: for (i = 0; i < n; i++) values[i] = PolyRealTan(values[i]); break;
+    case 6: for (i = 0; i < n; i++) values[i] = PolyRealArctan(values[i]); break;
+    case 7: for (i = 0; i < n; i++) values[i] = fabs(values[i]); break;
+    case 8: for (i = 0; i < n; i++) values[i] = -values[i]; break;
+    }
+}
+
+// Apply a function to each element of a slice and put the results into another
+// array.  indexes is a triple of the start of the source, the start of the
+// destination and the length.  These have been checked in ML.  The result is
+// as though all the source values were read before any results were stored even
+// if the arrays are the same.
+POLYUNSIGNED PolyRealArrayMap(POLYUNSIGNED threadId, POLYUNSIGNED code, POLYUNSIGNED src, POLYUNSIGNED dst, POLYUNSIGNED indexes)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle srcHandle = taskData->saveVec.push(src);
+    Handle dstHandle = taskData->saveVec.push(dst);
+    PolyObject *indexObj = PolyWord::FromUnsigned(indexes).AsObjPtr();
+    POLYUNSIGNED srcStart = indexObj->Get(0).UnTaggedUnsigned();
+    POLYUNSIGNED dstStart = indexObj->Get(1).UnTaggedUnsigned();
+    POLYUNSIGNED length = indexObj->Get(2).UnTaggedUnsigned();
+    unsigned op = (unsigned)UNTAGGED(PolyWord::FromUnsigned(code));
+
+    try {
+        double values[REAL_ARRAY_BLOCK];
+        // If the destination overlaps the source further up the array work
+        // down from the top so nothing is overwritten before it is read.
+        bool downwards = srcHandle->WordP() == dstHandle->WordP() && dstStart > srcStart;
+        POLYUNSIGNED blocks = (length + REAL_ARRAY_BLOCK - 1) / REAL_ARRAY_BLOCK;
+        for (POLYUNSIGNED b = 0; b < blocks; b++)
+        {
+            POLYUNSIGNED offset = (downwards ? blocks - b - 1 : b) * REAL_ARRAY_BLOCK;
+            unsigned n = length - offset < REAL_ARRAY_BLOCK ? (unsigned)(length - offset) : REAL_ARRAY_BLOCK;
+            for (unsigned i = 0; i < n; i++)
+            {
+                // Nothing is allocated here so the addresses can't change.
+                PolyObject *box = srcHandle->WordP()->Get(srcStart + offset + i).AsObjPtr();
+                union db u;
+                for (unsigned j = 0; j < DBLE; j++)
+                    u.words[j] = box->Get(j).AsUnsigned();
+                values[i] = u.dble;
+            }
+            realArrayApply(op, values, n);
+            for (unsigned i = 0; i < n; i++)
+            {
+                // Allocating the box may GC so the array must be found through the handle.
+                PolyObject *box = alloc(taskData, DBLE, F_BYTE_OBJ);
+                union db u;
+                u.dble = values[i];
+                for (unsigned j = 0; j < DBLE; j++)
+                    box->Set(j, PolyWord::FromUnsigned(u.words[j]));
+                dstHandle->WordP()->Set(dstStart + offset + i, box);
+            }
+        }
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(0).AsUnsigned();
+}
+
+// Reduce one or two slices to a single real.  Code 0 is the sum of the first
+// and code 1 is the dot product of the two.  indexes is a triple of the start
+// of each and the length.
+POLYUNSIGNED PolyRealArrayFold(POLYUNSIGNED threadId, POLYUNSIGNED code, POLYUNSIGNED arr1, POLYUNSIGNED arr2, POLYUNSIGNED indexes)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+    PolyObject *a1 = PolyWord::FromUnsigned(arr1).AsObjPtr();
+    PolyObject *a2 = PolyWord::FromUnsigned(arr2).AsObjPtr();
+    PolyObject *indexObj = PolyWord::FromUnsigned(indexes).AsObjPtr();
+    POLYUNSIGNED start1 = indexObj->Get(0).UnTaggedUnsigned();
+    POLYUNSIGNED start2 = indexObj->Get(1).UnTaggedUnsigned();
+    POLYUNSIGNED length = indexObj->Get(2).UnTaggedUnsigned();
+    bool isDot = UNTAGGED(PolyWord::FromUnsigned(code)) == 1;
+
+    // Nothing is allocated until the end so the arrays won't move.  Sum into
+    // several accumulators to allow the additions to overlap.
+    double values[REAL_ARRAY_BLOCK];
+    double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (POLYUNSIGNED offset = 0; offset < length; offset += REAL_ARRAY_BLOCK)
+    {
+        unsigned n = length - offset < REAL_ARRAY_BLOCK ? (unsigned)(length - offset) : REAL_ARRAY_BLOCK;
+        for (unsigned i = 0; i < n; i++)
+        {
+            union db u;
+            PolyObject *box = a1->Get(start1 + offset + i).AsObjPtr();
+            for (unsigned j = 0; j < DBLE; j++)
+                u.words[j] = box->Get(j).AsUnsigned();
+            values[i] = u.dble;
+            if (isDot)
+            {
+                box = a2->Get(start2 + offset + i).AsObjPtr();
+                for (unsigned j = 0; j < DBLE; j++)
+                    u.words[j] = box->Get(j).AsUnsigned();
+                values[i] *= u.dble;
+            }
+        }
+        unsigned i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            for (unsigned k = 0; k < 4; k++)
+                acc[k] += values[i + k];
+        }
+        for (; i < n; i++)
+            acc[0] += values[i];
+    }
+
+    try {
+        result = real_result(taskData, (acc[0] + acc[1]) + (acc[2] + acc[3]));
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
 // RTS call for square-root.
 float PolyRealFSqrt(float arg)
 {
@@ -853,6 +998,8 @@ struct _entrypts realsEPT[] =
     { "PolyRealNextAfter",              (polyRTSFunction)&PolyRealNextAfter },
     { "PolyRealLdexp",                  (polyRTSFunction)&PolyRealLdexp },
     { "PolyRealFrexp",                  (polyRTSFunction)&PolyRealFrexp },
+    { "PolyRealArrayMap",               (polyRTSFunction)&PolyRealArrayMap },
+    { "PolyRealArrayFold",              (polyRTSFunction)&PolyRealArrayFold },
     { "PolyRealFSqrt",                  (polyRTSFunction)&PolyRealFSqrt },
     { "PolyRealFSin",                   (polyRTSFunction)&PolyRealFSin },
     { "PolyRealFCos",                   (polyRTSFunction)&PolyRealFCos },
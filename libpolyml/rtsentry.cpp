@@ -70,6 +70,9 @@
 #include "savestate.h"
 #include "bytecode.h"
 #include "modules.h"
+#include "asyncio.h"
+#include "tracing.h"
+#include "bytevector.h"
 
 extern struct _entrypts rtsCallEPT[];
 
@@ -98,6 +101,9 @@ static entrypts entryPointTable[] =
     machineSpecificEPT,
     byteCodeEPT,
     modulesEPT,
+    asyncIOEPT,
+    tracingEPT,
+    byteVectorEPT,
     NULL
 };
 
@@ -96,6 +96,7 @@ PolyObject *alloc(TaskData *taskData, uintptr_t data_words, unsigned flags)
     // structural equality and wanted to make sure that unused bytes were cleared.
     // N.B.  This sets the store to zero NOT TAGGED(0).
     for (POLYUNSIGNED i = 0; i < data_words; i++) pObj->Set(i, PolyWord::FromUnsigned(0));
+    allocationSampleCheck(taskData, pObj, words);
     return pObj;
 }
 
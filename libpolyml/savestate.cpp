@@ -111,6 +111,8 @@ typedef char TCHAR;
 #include "timing.h"
 #include "rtsentry.h"
 #include "check_objects.h"
+#include "perfmap.h"
+#include "bytecodejit.h"
 #include "rtsentry.h"
 
 #ifdef _MSC_VER
@@ -814,6 +816,11 @@ void StateLoader::Perform(void)
             }
             (void)LoadFile(true, ModuleId(), TAGGED(0));
         }
+        if (errorResult == 0)
+        {
+            perfMapReload();
+            byteCodeJitInvalidate(); // The code in the old states has gone.
+        }
     }
     catch (const std::bad_alloc&)
     {
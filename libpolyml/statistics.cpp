@@ -89,6 +89,26 @@
 #include <errno.h>
 #endif
 
+#ifdef HAVE_SYS_SOCKET_H
+#include <sys/socket.h>
+#endif
+
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+
+#ifdef HAVE_NETDB_H
+#include <netdb.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #if defined(HAVE_MMAP)
 // How do we get the page size?
 #ifndef HAVE_GETPAGESIZE
@@ -137,6 +157,10 @@ extern "C" {
     POLYEXTERNALSYMBOL POLYUNSIGNED PolySetUserStat(POLYUNSIGNED threadId, POLYUNSIGNED index, POLYUNSIGNED value);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetLocalStats(POLYUNSIGNED threadId);
     POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetRemoteStats(POLYUNSIGNED threadId, POLYUNSIGNED procId);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetOpenMetrics(POLYUNSIGNED threadId);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyStartMetricsServer(POLYUNSIGNED threadId, POLYUNSIGNED endpoint);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetLockStats(POLYUNSIGNED threadId);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolySetLockHoldTiming(POLYUNSIGNED enable);
 }
 
 #define STATS_SPACE 4096 // Enough for all the statistics
@@ -148,6 +172,9 @@ extern "C" {
 #define ASN1_U_ENUM      10
 #define ASN1_U_SEQUENCE  16
 
+// Upper bounds, in microseconds, of the GC pause histogram buckets.
+static const unsigned long gcPauseBuckets[N_GC_PAUSE_BUCKETS] = { POLY_STATS_PAUSE_BUCKETS };
+
 // For the moment we don't bother to interlock access to the statistics memory.
 // Other processes only read the memory and at worst they may get a glitch in
 // the values.
@@ -165,6 +192,18 @@ Statistics::Statistics(): accessLock("Statistics")
     memset(&gcSystemTime, 0, sizeof(gcSystemTime));
     memset(&gcRealTime, 0, sizeof(gcRealTime));
 
+    for (unsigned h = 0; h < N_PS_HISTOGRAMS; h++)
+    {
+        for (unsigned l = 0; l <= N_GC_PAUSE_BUCKETS; l++)
+        {
+            gcPauseCounts[h][l] = 0;
+            histAddrs[h].bucketAddrs[l] = 0;
+        }
+        gcPauseSums[h] = 0.0;
+        histAddrs[h].secAddr = histAddrs[h].usecAddr = 0;
+    }
+    gcTimerStart = gcPhaseStart = 0.0;
+
 #ifdef _WIN32
     // File mapping handle
     hFileMap  = NULL;
@@ -173,6 +212,9 @@ Statistics::Statistics(): accessLock("Statistics")
     mapFd = -1;
     mapFileName = 0;
     exportStats = false; // Don't export by default
+    metricsEndpoint = 0;
+    metricsSocket = -1;
+    metricsPath = 0;
 #endif
     memSize = 0;
     statMemory = 0;
@@ -282,6 +324,11 @@ void Statistics::Init()
     addTime(PST_GC_STIME, POLY_STATS_ID_GC_STIME, "GCSystemTime");
     addTime(PST_NONGC_RTIME, POLY_STATS_ID_NONGC_RTIME, "NonGCRealTime");
     addTime(PST_GC_RTIME, POLY_STATS_ID_GC_RTIME, "GCRealTime");
+    addTime(PST_GC_MARK_RTIME, POLY_STATS_ID_GC_MARK_RTIME, "GCMarkRealTime");
+    addTime(PST_GC_COPY_RTIME, POLY_STATS_ID_GC_COPY_RTIME, "GCCopyRealTime");
+    addTime(PST_GC_UPDATE_RTIME, POLY_STATS_ID_GC_UPDATE_RTIME, "GCUpdateRealTime");
+    addTime(PST_GC_WEAKREF_RTIME, POLY_STATS_ID_GC_WEAKREF_RTIME, "GCWeakRefRealTime");
+    addTime(PST_GC_SHARE_RTIME, POLY_STATS_ID_GC_SHARE_RTIME, "GCShareRealTime");
 
     addUser(0, POLY_STATS_ID_USER0, "UserCounter0");
     addUser(1, POLY_STATS_ID_USER1, "UserCounter1");
@@ -291,6 +338,44 @@ void Statistics::Init()
     addUser(5, POLY_STATS_ID_USER5, "UserCounter5");
     addUser(6, POLY_STATS_ID_USER6, "UserCounter6");
     addUser(7, POLY_STATS_ID_USER7, "UserCounter7");
+
+    addHistogram(PSH_MINOR_GC, POLY_STATS_ID_MINOR_GC_PAUSES, "MinorGCPauses");
+    addHistogram(PSH_MAJOR_GC, POLY_STATS_ID_MAJOR_GC_PAUSES, "MajorGCPauses");
+    addHistogram(PSH_SHARING_GC, POLY_STATS_ID_SHARING_GC_PAUSES, "SharingGCPauses");
+    addHistogram(PSH_SAFEPOINT, POLY_STATS_ID_SAFEPOINT_WAITS, "SafepointWaits");
+}
+
+void Statistics::Start()
+{
+#ifndef _WIN32
+    // Start the metrics server if --metrics was given.  As with --exportstats
+    // we exit if this fails.
+    if (metricsEndpoint != 0)
+    {
+        int err = startMetricsServer(metricsEndpoint);
+        if (err != 0)
+            ExitWithError("Unable to start the metrics server: ", err);
+    }
+#endif
+}
+
+void Statistics::Stop()
+{
+#ifndef _WIN32
+    if (metricsSocket != -1)
+    {
+        // Shutting down the socket wakes up the server thread.
+        shutdown(metricsSocket, SHUT_RDWR);
+        close(metricsSocket);
+        metricsSocket = -1;
+    }
+    if (metricsPath != 0)
+    {
+        unlink(metricsPath);
+        free(metricsPath);
+        metricsPath = 0;
+    }
+#endif
 }
 
 #ifndef _WIN32
@@ -467,6 +552,59 @@ void Statistics::addUser(int n, unsigned statId, const char *name)
     statMemory[3] = length & 0xff;
 }
 
+// A histogram is too long for a single-byte length so it uses the two-byte form.
+void Statistics::addHistogram(int hEnum, unsigned statId, const char *name)
+{
+    // Tag header
+    *newPtr++ = POLY_STATS_C_HISTOGRAMSTAT;
+    *newPtr++ = 0x81; // Extended length, 1 byte
+    *newPtr++ = 0x00; // Initial length - overwritten at the end
+    unsigned char *tagStart = newPtr;
+    // First item - Id of this statistic - Implicit int
+    *newPtr++ = POLY_STATS_C_IDENTIFIER;
+    *newPtr++ = 0x01;
+    ASSERT(statId < 128);
+    *newPtr++ = statId;
+    // Second item - The name
+    size_t nameLength = strlen(name);
+    ASSERT(nameLength < 60);
+    *newPtr++ = POLY_STATS_C_NAME;
+    *newPtr++ = (unsigned char)nameLength;
+    for (unsigned i = 0; i < nameLength; i++) *newPtr++ = name[i];
+    // Third item - the total time.  As addTime.
+    *newPtr++ = POLY_STATS_C_TIME;
+    *newPtr++ = 12;
+    *newPtr++ = POLY_STATS_C_SECONDS;
+    *newPtr++ = 4;
+    histAddrs[hEnum].secAddr = newPtr;
+    for (unsigned j = 0; j < 4; j++) *newPtr++ = 0;
+    *newPtr++ = POLY_STATS_C_MICROSECS;
+    *newPtr++ = 4;
+    histAddrs[hEnum].usecAddr = newPtr;
+    for (unsigned k = 0; k < 4; k++) *newPtr++ = 0;
+    // Fourth item - the bucket counts.  Each is a four byte value with
+    // an extra zero byte so that it is always positive.
+    *newPtr++ = POLY_STATS_C_BUCKETS;
+    *newPtr++ = (N_GC_PAUSE_BUCKETS+1) * 7;
+    ASSERT((N_GC_PAUSE_BUCKETS+1) * 7 < 128);
+    for (unsigned l = 0; l <= N_GC_PAUSE_BUCKETS; l++)
+    {
+        *newPtr++ = POLY_STATS_C_COUNTER_VALUE;
+        *newPtr++ = 5;
+        *newPtr++ = 0;
+        histAddrs[hEnum].bucketAddrs[l] = newPtr;
+        for (unsigned m = 0; m < 4; m++) *newPtr++ = 0;
+    }
+    // Finally set the tag length and the overall size.
+    size_t length = newPtr - tagStart;
+    ASSERT(length < 256);
+    tagStart[-1] = (unsigned char)length;
+    // Set the overall size.
+    length = newPtr-statMemory - 4;
+    statMemory[2] = (length >> 8) & 0xff;
+    statMemory[3] = length & 0xff;
+}
+
 Statistics::~Statistics()
 {
 #ifdef _WIN32
@@ -706,6 +844,477 @@ void Statistics::setUserCounter(unsigned which, POLYSIGNED value)
     }
 }
 
+// Real time in seconds for GC timing.
+static double getRealTime()
+{
+#if (defined(_WIN32))
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULARGE_INTEGER li;
+    li.LowPart = ft.dwLowDateTime;
+    li.HighPart = ft.dwHighDateTime;
+    return (double)li.QuadPart / 1.0E7;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1.0E6;
+#endif
+}
+
+void Statistics::startGCTimer()
+{
+    gcTimerStart = getRealTime();
+}
+
+// Called at the end of each GC.  Adds the time since startGCTimer to the histogram.
+void Statistics::recordGCPause(int which)
+{
+    double seconds = getRealTime() - gcTimerStart;
+    if (seconds < 0.0) seconds = 0.0; // In case the clock has been changed.
+    addToHistogram(which, seconds);
+}
+
+void Statistics::recordSafepointWait(double seconds)
+{
+    addToHistogram(PSH_SAFEPOINT, seconds);
+}
+
+void Statistics::addToHistogram(int which, double seconds)
+{
+    unsigned long usecs = (unsigned long)(seconds * 1.0E6);
+    unsigned bucket = 0;
+    while (bucket < N_GC_PAUSE_BUCKETS && usecs > gcPauseBuckets[bucket])
+        bucket++;
+    PLocker lock(&accessLock);
+    POLYUNSIGNED count = ++gcPauseCounts[which][bucket];
+    gcPauseSums[which] += seconds;
+    if (statMemory && histAddrs[which].bucketAddrs[bucket])
+    {
+        for (unsigned i = 4; i > 0; i--)
+        {
+            histAddrs[which].bucketAddrs[bucket][i-1] = (unsigned char)(count & 0xff);
+            count = count >> 8;
+        }
+        setTimeWithLock(histAddrs[which].secAddr, histAddrs[which].usecAddr, gcPauseSums[which]);
+    }
+}
+
+void Statistics::startGCPhase()
+{
+    gcPhaseStart = getRealTime();
+}
+
+// Add the time since startGCPhase to the phase time.
+void Statistics::endGCPhase(int which)
+{
+    double seconds = getRealTime() - gcPhaseStart;
+    if (seconds < 0.0) seconds = 0.0;
+    PLocker lock(&accessLock);
+    if (statMemory && timeAddrs[which].secAddr && timeAddrs[which].usecAddr)
+        setTimeWithLock(timeAddrs[which].secAddr, timeAddrs[which].usecAddr, getTimeWithLock(which) + seconds);
+}
+
+void Statistics::setTimeWithLock(unsigned char *secAddr, unsigned char *usecAddr, double t)
+{
+    unsigned long secs = (unsigned long)t;
+    unsigned long usecs = (unsigned long)((t - (double)secs) * 1.0E6);
+    unsigned sLength = secAddr[-1];
+    while (sLength--)
+    {
+        secAddr[sLength] = (unsigned char)(secs & 0xff);
+        secs = secs >> 8;
+    }
+    unsigned usLength = usecAddr[-1];
+    while (usLength--)
+    {
+        usecAddr[usLength] = (unsigned char)(usecs & 0xff);
+        usecs = usecs >> 8;
+    }
+}
+
+double Statistics::getTimeWithLock(int which)
+{
+    unsigned long secs = 0, usecs = 0;
+    unsigned sLength = timeAddrs[which].secAddr[-1];
+    for (unsigned i = 0; i < sLength; i++)
+        secs = (secs << 8) | timeAddrs[which].secAddr[i];
+    unsigned usLength = timeAddrs[which].usecAddr[-1];
+    for (unsigned j = 0; j < usLength; j++)
+        usecs = (usecs << 8) | timeAddrs[which].usecAddr[j];
+    return (double)secs + (double)usecs / 1.0E6;
+}
+
+// Render the statistics in the OpenMetrics text format.  The values are
+// copied while holding the lock and formatted afterwards.
+// Append the buckets, count and sum of a histogram.  The labels, if any, end with a comma.
+static void appendHistogram(std::string &result, const char *metric, const char *labels,
+                            const POLYUNSIGNED *counts, double sum)
+{
+    char buff[200];
+    POLYUNSIGNED cumulative = 0;
+    for (unsigned b = 0; b < N_GC_PAUSE_BUCKETS; b++)
+    {
+        cumulative += counts[b];
+        snprintf(buff, sizeof(buff), "%s_bucket{%sle=\"%g\"} %lu\n",
+            metric, labels, (double)gcPauseBuckets[b] / 1.0E6, (unsigned long)cumulative);
+        result.append(buff);
+    }
+    cumulative += counts[N_GC_PAUSE_BUCKETS];
+    snprintf(buff, sizeof(buff), "%s_bucket{%sle=\"+Inf\"} %lu\n", metric, labels, (unsigned long)cumulative);
+    result.append(buff);
+    // The count and sum take the labels without the trailing comma.
+    std::string l(labels);
+    if (!l.empty()) l = "{" + l.substr(0, l.size()-1) + "}";
+    snprintf(buff, sizeof(buff), "%s_count%s %lu\n%s_sum%s %.6f\n",
+        metric, l.c_str(), (unsigned long)cumulative, metric, l.c_str(), sum);
+    result.append(buff);
+}
+
+void Statistics::getOpenMetrics(std::string &result)
+{
+    size_t counts[N_PS_INTS];
+    double times[N_PS_TIMES];
+    POLYSIGNED users[N_PS_USER];
+    POLYUNSIGNED pauseCounts[N_PS_HISTOGRAMS][N_GC_PAUSE_BUCKETS+1];
+    double pauseSums[N_PS_HISTOGRAMS];
+    {
+        PLocker lock(&accessLock);
+        for (unsigned i = 0; i < N_PS_INTS; i++)
+            counts[i] = statMemory && counterAddrs[i] ? getSizeWithLock(i) : 0;
+        for (unsigned k = 0; k < N_PS_TIMES; k++)
+            times[k] = statMemory && timeAddrs[k].secAddr && timeAddrs[k].usecAddr ? getTimeWithLock(k) : 0.0;
+        for (unsigned l = 0; l < N_PS_USER; l++)
+        {
+            POLYSIGNED value = 0;
+            if (statMemory && userAddrs[l])
+            {
+                // Big-endian and signed.
+                unsigned length = userAddrs[l][-1];
+                for (unsigned m = 0; m < length; m++)
+                    value = (value << 8) | userAddrs[l][m];
+                if (length != 0 && length < sizeof(POLYSIGNED) && (userAddrs[l][0] & 0x80))
+                    value -= (POLYSIGNED)1 << (length * 8);
+            }
+            users[l] = value;
+        }
+        for (unsigned h = 0; h < N_PS_HISTOGRAMS; h++)
+        {
+            for (unsigned n = 0; n <= N_GC_PAUSE_BUCKETS; n++)
+                pauseCounts[h][n] = gcPauseCounts[h][n];
+            pauseSums[h] = gcPauseSums[h];
+        }
+    }
+
+    char buff[200];
+    result.clear();
+
+    result.append("# TYPE polyml_threads gauge\n# HELP polyml_threads Number of ML threads.\n");
+    snprintf(buff, sizeof(buff), "polyml_threads %lu\n", (unsigned long)counts[PSC_THREADS]);
+    result.append(buff);
+    result.append("# TYPE polyml_threads_in_ml gauge\n# HELP polyml_threads_in_ml Number of threads running ML code.\n");
+    snprintf(buff, sizeof(buff), "polyml_threads_in_ml %lu\n", (unsigned long)counts[PSC_THREADS_IN_ML]);
+    result.append(buff);
+    result.append("# TYPE polyml_threads_waiting gauge\n# HELP polyml_threads_waiting Number of threads waiting.\n");
+    static const struct { int which; const char *reason; } waits[] =
+    {
+        { PSC_THREADS_WAIT_IO, "io" }, { PSC_THREADS_WAIT_MUTEX, "mutex" },
+        { PSC_THREADS_WAIT_CONDVAR, "condvar" }, { PSC_THREADS_WAIT_SIGNAL, "signal" }
+    };
+    for (unsigned w = 0; w < sizeof(waits)/sizeof(waits[0]); w++)
+    {
+        snprintf(buff, sizeof(buff), "polyml_threads_waiting{reason=\"%s\"} %lu\n", waits[w].reason, (unsigned long)counts[waits[w].which]);
+        result.append(buff);
+    }
+
+    result.append("# TYPE polyml_gc_collections counter\n# HELP polyml_gc_collections Number of garbage collections.\n");
+    static const struct { int which; const char *kind; } gcs[] =
+    {
+        { PSC_GC_FULLGC, "full" }, { PSC_GC_PARTIALGC, "partial" }, { PSC_GC_SHARING, "sharing" }
+    };
+    for (unsigned g = 0; g < sizeof(gcs)/sizeof(gcs[0]); g++)
+    {
+        snprintf(buff, sizeof(buff), "polyml_gc_collections_total{kind=\"%s\"} %lu\n", gcs[g].kind, (unsigned long)counts[gcs[g].which]);
+        result.append(buff);
+    }
+    result.append("# TYPE polyml_gc_state gauge\n# HELP polyml_gc_state Current GC phase or zero if no GC is running.\n");
+    snprintf(buff, sizeof(buff), "polyml_gc_state %lu\n", (unsigned long)counts[PSC_GC_STATE]);
+    result.append(buff);
+    result.append("# TYPE polyml_gc_percent gauge\n# HELP polyml_gc_percent Progress of the current GC phase.\n");
+    snprintf(buff, sizeof(buff), "polyml_gc_percent %lu\n", (unsigned long)counts[PSC_GC_PERCENT]);
+    result.append(buff);
+
+    static const struct { int which; const char *name; const char *help; } sizeNames[] =
+    {
+        { PSS_TOTAL_HEAP, "polyml_heap_bytes", "Total size of the heap." },
+        { PSS_AFTER_LAST_GC, "polyml_heap_free_after_gc_bytes", "Free space after the last GC." },
+        { PSS_AFTER_LAST_FULLGC, "polyml_heap_free_after_full_gc_bytes", "Free space after the last full GC." },
+        { PSS_ALLOCATION, "polyml_allocation_space_bytes", "Size of the allocation space." },
+        { PSS_ALLOCATION_FREE, "polyml_allocation_space_free_bytes", "Free space in the allocation space." },
+        { PSS_CODE_SPACE, "polyml_code_space_bytes", "Space used for code." },
+        { PSS_STACK_SPACE, "polyml_stack_space_bytes", "Space used for thread stacks." }
+    };
+    for (unsigned z = 0; z < sizeof(sizeNames)/sizeof(sizeNames[0]); z++)
+    {
+        snprintf(buff, sizeof(buff), "# TYPE %s gauge\n# UNIT %s bytes\n",
+            sizeNames[z].name, sizeNames[z].name);
+        result.append(buff);
+        snprintf(buff, sizeof(buff), "# HELP %s %s\n%s %lu\n", sizeNames[z].name, sizeNames[z].help,
+            sizeNames[z].name, (unsigned long)counts[sizeNames[z].which]);
+        result.append(buff);
+    }
+
+    result.append("# TYPE polyml_cpu_seconds counter\n# UNIT polyml_cpu_seconds seconds\n"
+        "# HELP polyml_cpu_seconds CPU time used in the GC and in the rest of the program.\n");
+    static const struct { int which; const char *labels; } cpuTimes[] =
+    {
+        { PST_NONGC_UTIME, "phase=\"mutator\",mode=\"user\"" }, { PST_NONGC_STIME, "phase=\"mutator\",mode=\"system\"" },
+        { PST_GC_UTIME, "phase=\"gc\",mode=\"user\"" }, { PST_GC_STIME, "phase=\"gc\",mode=\"system\"" }
+    };
+    for (unsigned c = 0; c < sizeof(cpuTimes)/sizeof(cpuTimes[0]); c++)
+    {
+        snprintf(buff, sizeof(buff), "polyml_cpu_seconds_total{%s} %.6f\n", cpuTimes[c].labels, times[cpuTimes[c].which]);
+        result.append(buff);
+    }
+    result.append("# TYPE polyml_real_seconds counter\n# UNIT polyml_real_seconds seconds\n"
+        "# HELP polyml_real_seconds Elapsed time spent in the GC and in the rest of the program.\n");
+    snprintf(buff, sizeof(buff), "polyml_real_seconds_total{phase=\"mutator\"} %.6f\n", times[PST_NONGC_RTIME]);
+    result.append(buff);
+    snprintf(buff, sizeof(buff), "polyml_real_seconds_total{phase=\"gc\"} %.6f\n", times[PST_GC_RTIME]);
+    result.append(buff);
+
+    result.append("# TYPE polyml_gc_phase_seconds counter\n# UNIT polyml_gc_phase_seconds seconds\n"
+        "# HELP polyml_gc_phase_seconds Elapsed time spent in each phase of the full GC.\n");
+    static const struct { int which; const char *phase; } phaseTimes[] =
+    {
+        { PST_GC_MARK_RTIME, "mark" }, { PST_GC_COPY_RTIME, "copy" }, { PST_GC_UPDATE_RTIME, "update" },
+        { PST_GC_WEAKREF_RTIME, "weakref" }, { PST_GC_SHARE_RTIME, "share" }
+    };
+    for (unsigned t = 0; t < sizeof(phaseTimes)/sizeof(phaseTimes[0]); t++)
+    {
+        snprintf(buff, sizeof(buff), "polyml_gc_phase_seconds_total{phase=\"%s\"} %.6f\n", phaseTimes[t].phase, times[phaseTimes[t].which]);
+        result.append(buff);
+    }
+
+    result.append("# TYPE polyml_gc_pause_seconds histogram\n# UNIT polyml_gc_pause_seconds seconds\n"
+        "# HELP polyml_gc_pause_seconds Elapsed time of each garbage collection.\n");
+    static const char *const pauseKinds[PSH_SAFEPOINT] = { "kind=\"minor\",", "kind=\"major\",", "kind=\"sharing\"," };
+    for (unsigned h = 0; h < PSH_SAFEPOINT; h++)
+        appendHistogram(result, "polyml_gc_pause_seconds", pauseKinds[h], pauseCounts[h], pauseSums[h]);
+
+    result.append("# TYPE polyml_safepoint_wait_seconds histogram\n# UNIT polyml_safepoint_wait_seconds seconds\n"
+        "# HELP polyml_safepoint_wait_seconds Time taken for all the ML threads to stop for a GC or other request.\n");
+    appendHistogram(result, "polyml_safepoint_wait_seconds", "", pauseCounts[PSH_SAFEPOINT], pauseSums[PSH_SAFEPOINT]);
+
+    std::vector<PLockStatistics> locks;
+    PLock::GetStatistics(locks);
+    // Counts are integers; times, in nanoseconds, are output in seconds.
+    static const struct { const char *name; const char *type; bool isTime; uint64_t PLockStatistics::*field; const char *help; } lockFamilies[] =
+    {
+        { "polyml_lock_acquisitions", "counter", false, &PLockStatistics::acquisitions, "Number of times the lock was acquired." },
+        { "polyml_lock_contended", "counter", false, &PLockStatistics::contended, "Number of acquisitions that had to wait." },
+        { "polyml_lock_wait_seconds", "counter", true, &PLockStatistics::waitTime, "Total time spent waiting for the lock." },
+        { "polyml_lock_max_wait_seconds", "gauge", true, &PLockStatistics::maxWait, "Longest time spent waiting for the lock." },
+        { "polyml_lock_hold_seconds", "counter", true, &PLockStatistics::holdTime, "Total time the lock was held while hold timing was enabled." }
+    };
+    for (unsigned f = 0; f < sizeof(lockFamilies)/sizeof(lockFamilies[0]); f++)
+    {
+        const char *family = lockFamilies[f].name;
+        snprintf(buff, sizeof(buff), "# TYPE %s %s\n", family, lockFamilies[f].type);
+        result.append(buff);
+        if (lockFamilies[f].isTime)
+        {
+            snprintf(buff, sizeof(buff), "# UNIT %s seconds\n", family);
+            result.append(buff);
+        }
+        snprintf(buff, sizeof(buff), "# HELP %s %s\n", family, lockFamilies[f].help);
+        result.append(buff);
+        const char *suffix = strcmp(lockFamilies[f].type, "counter") == 0 ? "_total" : "";
+        for (std::vector<PLockStatistics>::iterator i = locks.begin(); i != locks.end(); i++)
+        {
+            uint64_t value = (*i).*(lockFamilies[f].field);
+            if (lockFamilies[f].isTime)
+                snprintf(buff, sizeof(buff), "%s%s{lock=\"%s\"} %.9f\n", family, suffix, i->name, (double)value / 1.0E9);
+            else snprintf(buff, sizeof(buff), "%s%s{lock=\"%s\"} %llu\n", family, suffix, i->name, (unsigned long long)value);
+            result.append(buff);
+        }
+    }
+
+    result.append("# TYPE polyml_user_counter gauge\n# HELP polyml_user_counter Counters set by the application.\n");
+    for (unsigned u = 0; u < N_PS_USER; u++)
+    {
+        snprintf(buff, sizeof(buff), "polyml_user_counter{index=\"%u\"} %ld\n", u, (long)users[u]);
+        result.append(buff);
+    }
+
+    result.append("# EOF\n");
+}
+
+#ifndef _WIN32
+static void *metricsThread(void *arg)
+{
+    ((Statistics*)arg)->serveMetrics();
+    return 0;
+}
+
+// Create the listening socket and start a thread to serve requests on it.
+int Statistics::startMetricsServer(const char *endpoint)
+{
+    if (metricsSocket != -1)
+        return EBUSY;
+    int sock = -1;
+    if (strchr(endpoint, '/') != 0)
+    {
+        // Unix-domain socket.
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(endpoint) >= sizeof(addr.sun_path))
+            return ENAMETOOLONG;
+        strcpy(addr.sun_path, endpoint);
+        // Remove a socket left over from a previous run but nothing else.
+        struct stat statBuf;
+        if (lstat(endpoint, &statBuf) == 0 && S_ISSOCK(statBuf.st_mode))
+            unlink(endpoint);
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock == -1)
+            return errno;
+        if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            int err = errno;
+            close(sock);
+            return err;
+        }
+        metricsPath = strdup(endpoint);
+    }
+    else
+    {
+        // [host:]port.  An IPv6 address can be given in brackets.
+        std::string host("127.0.0.1"), port(endpoint);
+        const char *colon = strrchr(endpoint, ':');
+        if (colon != 0)
+        {
+            host = std::string(endpoint, colon - endpoint);
+            port = std::string(colon + 1);
+            if (host.length() >= 2 && host[0] == '[' && host[host.length()-1] == ']')
+                host = host.substr(1, host.length()-2);
+        }
+        struct addrinfo hints, *addrs;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        int gaiRes = getaddrinfo(host.empty() ? 0 : host.c_str(), port.c_str(), &hints, &addrs);
+        if (gaiRes != 0)
+            return gaiRes == EAI_SYSTEM ? errno : EINVAL;
+        int err = EADDRNOTAVAIL;
+        for (struct addrinfo *a = addrs; a != 0; a = a->ai_next)
+        {
+            sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (sock == -1) { err = errno; continue; }
+            int on = 1;
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char*)&on, sizeof(on));
+            if (bind(sock, a->ai_addr, a->ai_addrlen) == 0)
+                break;
+            err = errno;
+            close(sock);
+            sock = -1;
+        }
+        freeaddrinfo(addrs);
+        if (sock == -1)
+            return err;
+    }
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+    if (listen(sock, 16) != 0)
+    {
+        int err = errno;
+        close(sock);
+        if (metricsPath) { unlink(metricsPath); free(metricsPath); metricsPath = 0; }
+        return err;
+    }
+    metricsSocket = sock;
+
+    // The thread must not receive any of the signals handled by the RTS.
+    sigset_t allSignals, oldSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &oldSignals);
+    pthread_t pthreadId;
+    pthread_attr_t attrs;
+    pthread_attr_init(&attrs);
+    pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&pthreadId, &attrs, metricsThread, this);
+    pthread_attr_destroy(&attrs);
+    pthread_sigmask(SIG_SETMASK, &oldSignals, 0);
+    if (err != 0)
+    {
+        Stop();
+        return err;
+    }
+    return 0;
+}
+
+// Accept connections and reply to each with the current metrics.  Only GET of
+// "/" or "/metrics" is recognised and the connection is always closed afterwards.
+void Statistics::serveMetrics()
+{
+    int listener = metricsSocket;
+    while (true)
+    {
+        int conn = accept(listener, 0, 0);
+        if (conn == -1)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return; // Socket closed
+        }
+        // Don't let a slow client hold up the thread.
+        struct timeval timeout;
+        timeout.tv_sec = 2;
+        timeout.tv_usec = 0;
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+        setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, (char*)&timeout, sizeof(timeout));
+
+        // Read the request header.  We don't need anything after the first line
+        // but we read the whole header so that the client sees an orderly close.
+        char request[4096];
+        size_t reqLength = 0;
+        while (reqLength < sizeof(request) - 1)
+        {
+            ssize_t n = recv(conn, request + reqLength, sizeof(request) - 1 - reqLength, 0);
+            if (n <= 0) break;
+            reqLength += n;
+            request[reqLength] = 0;
+            if (strstr(request, "\r\n\r\n") != 0 || strstr(request, "\n\n") != 0) break;
+        }
+        request[reqLength] = 0;
+
+        std::string reply, body;
+        if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0)
+        {
+            getOpenMetrics(body);
+            reply = "HTTP/1.0 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n";
+        }
+        else
+        {
+            body = "Not found\n";
+            reply = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n";
+        }
+        char buff[100];
+        snprintf(buff, sizeof(buff), "Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long)body.length());
+        reply.append(buff);
+        if (strncmp(request, "HEAD ", 5) != 0)
+            reply.append(body);
+
+        size_t sent = 0;
+        while (sent < reply.length())
+        {
+            ssize_t n = send(conn, reply.data() + sent, reply.length() - sent, 0);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(conn);
+    }
+}
+#endif
+
 Handle Statistics::returnStatistics(TaskData *taskData, const unsigned char *stats, size_t size)
 {
     // Just return the memory as a string i.e. Word8Vector.vector.
@@ -874,12 +1483,116 @@ POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetRemoteStats(POLYUNSIGNED threadId, POLYUN
     else return result->Word().AsUnsigned();
 }
 
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetOpenMetrics(POLYUNSIGNED threadId)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+
+    try {
+        std::string metrics;
+        globalStats.getOpenMetrics(metrics);
+        result = taskData->saveVec.push(C_string_to_Poly(taskData, metrics.data(), metrics.length()));
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyStartMetricsServer(POLYUNSIGNED threadId, POLYUNSIGNED endpoint)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+
+    try {
+#ifdef _WIN32
+        raise_fail(taskData, "The metrics server is not available in Windows");
+#else
+        TempCString endpointName(Poly_string_to_C_alloc(PolyWord::FromUnsigned(endpoint)));
+        int err = globalStats.startMetricsServer(endpointName);
+        if (err != 0)
+            raise_syscall(taskData, "Unable to start metrics server", err);
+#endif
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+
+    return TAGGED(0).AsUnsigned();
+}
+
+// Return the statistics for the named locks as a list of tuples.  The times are in nanoseconds.
+POLYEXTERNALSYMBOL POLYUNSIGNED PolyGetLockStats(POLYUNSIGNED threadId)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+    Handle result = 0;
+
+    try {
+        std::vector<PLockStatistics> locks;
+        PLock::GetStatistics(locks);
+        Handle saved = taskData->saveVec.mark();
+        Handle list = taskData->saveVec.push(ListNull);
+        for (std::vector<PLockStatistics>::reverse_iterator i = locks.rbegin(); i != locks.rend(); i++)
+        {
+            Handle name = taskData->saveVec.push(C_string_to_Poly(taskData, i->name));
+            Handle acquisitions = Make_arbitrary_precision(taskData, (unsigned long long)i->acquisitions);
+            Handle contended = Make_arbitrary_precision(taskData, (unsigned long long)i->contended);
+            Handle waitTime = Make_arbitrary_precision(taskData, (unsigned long long)i->waitTime);
+            Handle maxWait = Make_arbitrary_precision(taskData, (unsigned long long)i->maxWait);
+            Handle holdTime = Make_arbitrary_precision(taskData, (unsigned long long)i->holdTime);
+            Handle tuple = alloc_and_save(taskData, 6);
+            tuple->WordP()->Set(0, name->Word());
+            tuple->WordP()->Set(1, acquisitions->Word());
+            tuple->WordP()->Set(2, contended->Word());
+            tuple->WordP()->Set(3, waitTime->Word());
+            tuple->WordP()->Set(4, maxWait->Word());
+            tuple->WordP()->Set(5, holdTime->Word());
+            Handle next = alloc_and_save(taskData, sizeof(ML_Cons_Cell) / sizeof(PolyWord));
+            DEREFLISTHANDLE(next)->h = tuple->Word();
+            DEREFLISTHANDLE(next)->t = list->Word();
+
+            taskData->saveVec.reset(saved);
+            list = taskData->saveVec.push(next->Word());
+        }
+        result = list;
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+
+    if (result == 0) return TAGGED(0).AsUnsigned();
+    else return result->Word().AsUnsigned();
+}
+
+POLYEXTERNALSYMBOL POLYUNSIGNED PolySetLockHoldTiming(POLYUNSIGNED enable)
+{
+    PLock::holdTiming = PolyWord::FromUnsigned(enable).UnTagged() != 0;
+    return TAGGED(0).AsUnsigned();
+}
+
 struct _entrypts statisticsEPT[] =
 {
     { "PolyGetUserStatsCount",            (polyRTSFunction)&PolyGetUserStatsCount },
     { "PolySetUserStat",                  (polyRTSFunction)&PolySetUserStat },
     { "PolyGetLocalStats",                (polyRTSFunction)&PolyGetLocalStats },
     { "PolyGetRemoteStats",               (polyRTSFunction)&PolyGetRemoteStats },
+    { "PolyGetOpenMetrics",               (polyRTSFunction)&PolyGetOpenMetrics },
+    { "PolyStartMetricsServer",           (polyRTSFunction)&PolyStartMetricsServer },
+    { "PolyGetLockStats",                 (polyRTSFunction)&PolyGetLockStats },
+    { "PolySetLockHoldTiming",            (polyRTSFunction)&PolySetLockHoldTiming },
 
     { NULL, NULL } // End of list.
 };
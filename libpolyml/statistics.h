@@ -30,6 +30,9 @@
 #include "rts_module.h"
 
 #include "../polystatistics.h"
+
+#include <string>
+
 enum {
     PSC_THREADS = 0,                // Total number of threads
     PSC_THREADS_IN_ML,              // Threads running ML code
@@ -63,12 +66,30 @@ enum {
     PST_GC_STIME,
     PST_NONGC_RTIME,
     PST_GC_RTIME,
+    PST_GC_MARK_RTIME,              // Real time in each phase of the full GC
+    PST_GC_COPY_RTIME,
+    PST_GC_UPDATE_RTIME,
+    PST_GC_WEAKREF_RTIME,
+    PST_GC_SHARE_RTIME,
     N_PS_TIMES
 };
 
+// Histograms of GC pause times and of the time taken to stop the ML threads.
+enum {
+    PSH_MINOR_GC,                   // Minor GCs
+    PSH_MAJOR_GC,                   // Full GCs without a sharing pass
+    PSH_SHARING_GC,                 // Full GCs that included a sharing pass
+    PSH_SAFEPOINT,                  // Wait for all threads to stop for a request to the main thread
+    N_PS_HISTOGRAMS
+};
+
 // A few counters that can be used by the application
 #define N_PS_USER   8
 
+// Number of finite buckets in the GC pause histograms.  The bounds are
+// POLY_STATS_PAUSE_BUCKETS.
+#define N_GC_PAUSE_BUCKETS  16
+
 class TaskData;
 class SaveVecEntry;
 typedef SaveVecEntry *Handle;
@@ -80,6 +101,8 @@ public:
     ~Statistics();
 
     virtual void Init(void); // Initialise after set-up
+    virtual void Start(void);
+    virtual void Stop(void);
 
     Handle getLocalStatistics(TaskData *taskData);
     Handle getRemoteStatistics(TaskData *taskData, POLYUNSIGNED processId);
@@ -95,6 +118,19 @@ public:
 
     void setUserCounter(unsigned which, POLYSIGNED value);
 
+    // Timing of garbage collections.  startGCTimer is called at the start of
+    // each GC and recordGCPause at the end.  Phases within a full GC are
+    // bracketed by startGCPhase and endGCPhase.
+    void startGCTimer(void);
+    void recordGCPause(int which);
+    void startGCPhase(void);
+    void endGCPhase(int which);
+    // Record the time between a request to the main thread and all the threads stopping.
+    void recordSafepointWait(double seconds);
+
+    // Produce the statistics as OpenMetrics text.
+    void getOpenMetrics(std::string &result);
+
 #ifdef _WIN32
     // Native Windows
     void copyGCTimes(const FILETIME &gcUtime, const FILETIME &gcStime, const FILETIME &gcRtime);
@@ -105,6 +141,13 @@ public:
     struct timeval gcUserTime, gcSystemTime, gcRealTime, startTime;
     bool createSharedStats(const char *baseName, const char *subDirName);
     int openSharedStats(const char* baseName, const char* subDirName, int pid);
+
+    // Serve the statistics as OpenMetrics text over HTTP from a separate thread.
+    // The endpoint is either the path of a Unix-domain socket or [host:]port.
+    // Returns zero if successful or an error code.
+    int startMetricsServer(const char *endpoint);
+    void serveMetrics(void);
+    const char *metricsEndpoint; // Set by --metrics
 #endif
     
     void updatePeriodicStats(size_t freeSpace, unsigned threadsInML);
@@ -120,6 +163,8 @@ private:
 #else
     char *mapFileName;
     int mapFd;
+    int metricsSocket;
+    char *metricsPath; // If it is a Unix-domain socket
 #endif
     size_t memSize;
     unsigned char *statMemory;
@@ -129,15 +174,26 @@ private:
     struct { unsigned char *secAddr; unsigned char *usecAddr; } timeAddrs[N_PS_TIMES];
     unsigned char *userAddrs[N_PS_USER];
 
+    // GC pause histograms.  The last entry counts pauses above the largest bucket.
+    POLYUNSIGNED gcPauseCounts[N_PS_HISTOGRAMS][N_GC_PAUSE_BUCKETS+1];
+    double gcPauseSums[N_PS_HISTOGRAMS];
+    struct { unsigned char *bucketAddrs[N_GC_PAUSE_BUCKETS+1]; unsigned char *secAddr; unsigned char *usecAddr; }
+        histAddrs[N_PS_HISTOGRAMS];
+    double gcTimerStart, gcPhaseStart;
+
     Handle returnStatistics(TaskData *taskData, const unsigned char *stats, size_t size);
     void addCounter(int cEnum, unsigned statId, const char *name);
     void addSize(int cEnum, unsigned statId, const char *name);
     void addTime(int cEnum, unsigned statId, const char *name);
     void addUser(int n, unsigned statId, const char *name);
+    void addHistogram(int hEnum, unsigned statId, const char *name);
+    void addToHistogram(int which, double seconds);
 
     size_t getSizeWithLock(int which);
+    double getTimeWithLock(int which);
     void setSizeWithLock(int which, size_t s);
     void setTimeValue(int which, unsigned long secs, unsigned long usecs);
+    void setTimeWithLock(unsigned char *secAddr, unsigned char *usecAddr, double t);
 };
 
 extern Statistics globalStats;
@@ -0,0 +1,551 @@
+/*
+    Title:      Event trace buffers for the run-time system.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+/*
+Events in the RTS, such as the phases of the GC, requests to the main thread
+and threads blocking, are recorded in binary form in a ring buffer belonging
+to the thread.  Recording an event does not take any locks so this is cheap
+enough to leave on.  When the buffer is full the oldest events are overwritten.
+The buffers can be written out as a JSON file in the Chrome trace event format,
+which can be viewed with Perfetto (ui.perfetto.dev) or chrome://tracing.  Each
+buffer has a single writer, its thread, so the dump copies the events and then
+discards any that may have been overwritten while it was copying.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#elif defined(_WIN32)
+#include "winconfig.h"
+#else
+#error "No configuration file"
+#endif
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+#ifdef HAVE_TIME_H
+#include <time.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_DLFCN_H
+#include <dlfcn.h>
+#endif
+#ifdef HAVE_WINDOWS_H
+#include <windows.h>
+#endif
+
+#ifdef HAVE_ASSERT_H
+#include <assert.h>
+#define ASSERT(x) assert(x)
+#else
+#define ASSERT(x)
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "globals.h"
+#include "tracing.h"
+#include "processes.h"
+#include "run_time.h"
+#include "polystring.h"
+#include "save_vec.h"
+#include "rts_module.h"
+#include "locking.h"
+#include "sighandler.h"
+#include "diagnostics.h"
+#include "rtsentry.h"
+
+extern "C" {
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolySetTracing(POLYUNSIGNED enable);
+    POLYEXTERNALSYMBOL POLYUNSIGNED PolyDumpTrace(POLYUNSIGNED threadId, POLYUNSIGNED fileName);
+}
+
+#if (defined(_MSC_VER))
+#define LOAD_ACQUIRE(x)         (x)
+#define STORE_RELEASE(x, v)     ((x) = (v))
+#define ACQUIRE_FENCE()         MemoryBarrier()
+#else
+#define LOAD_ACQUIRE(x)         __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(x, v)     __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define ACQUIRE_FENCE()         __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#endif
+
+// Number of events in each thread's buffer.  Must be a power of two.
+#define TRACE_BUFFER_EVENTS     16384
+// Once there are this many buffers those belonging to threads that have
+// exited are reused.
+#define TRACE_MAX_BUFFERS       64
+
+bool traceEnabled = false;
+
+typedef struct {
+    uint64_t time;
+    uintptr_t arg; // For a complete event this is the duration.
+    uint16_t kind;
+    uint16_t id;
+} TraceEvent;
+
+class TraceBuffer
+{
+public:
+    TraceBuffer(): next(0), threadId(0), threadName(0), exited(false) {}
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    uint64_t next; // Index of the next event.  Only updated by the owning thread.
+    unsigned long threadId;
+    const char *threadName;
+    bool exited;
+};
+
+static const struct { const char *name, *category; } eventNames[TRACE_MAX_EVENT] =
+{
+    { "Full GC",            "gc" },
+    { "Minor GC",           "gc" },
+    { "Sharing",            "gc" },
+    { "Mark",               "gc" },
+    { "Weak references",    "gc" },
+    { "Copy",               "gc" },
+    { "Update",             "gc" },
+    { "Request",            "sched" },
+    { "Perform",            "sched" },
+    { "Safepoint wait",     "sched" },
+    { "Blocked",            "thread" },
+    { "RTS call",           "rts" }
+};
+
+// Names for the main thread phases.  These must match enum _mainThreadPhase.
+static const char * const phaseNames[MTP_MAXENTRY] =
+{
+    "ML", "GC sharing", "GC mark", "GC copy", "GC update", "Minor GC",
+    "Sharing", "Export", "Save state", "Load state", "Profiling",
+    "Signal handler", "Cygwin spawn", "Store module", "Load module", "Release module"
+};
+
+class TraceModule: public RtsModule
+{
+public:
+    TraceModule(): registryLock("Trace buffers"), dumpLock("Trace dump"), startTime(0), mainThread(0)
+#if (!defined(_WIN32))
+        , dumpPipeRead(-1), dumpPipeWrite(-1)
+#endif
+        {}
+    virtual void Init(void);
+    virtual void Start(void);
+    virtual void Stop(void);
+
+    TraceBuffer *GetBuffer(void);
+    int Dump(const char *fileName);
+    void SetEnabled(bool enable);
+
+    PLock registryLock; // Protects buffers
+    std::vector<TraceBuffer*> buffers;
+    PLock dumpLock; // Only one dump at a time
+    uint64_t startTime;
+    std::string traceFile; // Set by --trace
+    unsigned long mainThread;
+#if (!defined(_WIN32))
+    pthread_key_t bufferKey;
+    int dumpPipeRead, dumpPipeWrite;
+#else
+    DWORD bufferKey;
+#endif
+};
+
+static TraceModule traceModule;
+
+uint64_t traceTimestamp(void)
+{
+#if (defined(_WIN32))
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER count;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (uint64_t)(count.QuadPart / frequency.QuadPart * 1000000000 +
+        count.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static unsigned long currentThreadId(void)
+{
+#if (defined(_WIN32))
+    return GetCurrentThreadId();
+#elif (defined(SYS_gettid))
+    return (unsigned long)syscall(SYS_gettid);
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+#if (!defined(_WIN32))
+// Called when a thread exits.  The buffer is kept so that its events can be
+// included in a dump but may be reused.
+static void traceBufferDestructor(void *p)
+{
+    PLocker lock(&traceModule.registryLock);
+    ((TraceBuffer*)p)->exited = true;
+}
+#endif
+
+// Find or create the buffer for this thread.
+TraceBuffer *TraceModule::GetBuffer(void)
+{
+#if (!defined(_WIN32))
+    TraceBuffer *buffer = (TraceBuffer*)pthread_getspecific(bufferKey);
+#else
+    TraceBuffer *buffer = (TraceBuffer*)TlsGetValue(bufferKey);
+#endif
+    if (buffer != 0) return buffer;
+
+    unsigned long tid = currentThreadId();
+    const char *name;
+    if (processes->GetTaskDataForThread() != 0) name = "ML thread";
+    else if (tid == mainThread) name = "Main thread";
+    else name = "RTS thread";
+
+    {
+        PLocker lock(&registryLock);
+        if (buffers.size() >= TRACE_MAX_BUFFERS)
+        {
+            for (std::vector<TraceBuffer*>::iterator i = buffers.begin(); i != buffers.end(); i++)
+            {
+                if ((*i)->exited)
+                {
+                    buffer = *i;
+                    buffer->exited = false;
+                    STORE_RELEASE(buffer->next, 0);
+                    break;
+                }
+            }
+        }
+        if (buffer == 0)
+        {
+            buffer = new(std::nothrow) TraceBuffer;
+            if (buffer == 0) return 0;
+            buffers.push_back(buffer);
+        }
+        buffer->threadId = tid;
+        buffer->threadName = name;
+    }
+#if (!defined(_WIN32))
+    pthread_setspecific(bufferKey, buffer);
+#else
+    TlsSetValue(bufferKey, buffer);
+#endif
+    return buffer;
+}
+
+void traceRecord(TraceEventKind kind, TraceEventId id, uintptr_t arg, uint64_t startTime)
+{
+    TraceBuffer *buffer = traceModule.GetBuffer();
+    if (buffer == 0) return;
+    uint64_t n = buffer->next;
+    TraceEvent *event = &buffer->events[n & (TRACE_BUFFER_EVENTS-1)];
+    uint64_t now = traceTimestamp();
+    if (kind == TRACE_COMPLETE)
+    {
+        event->time = startTime;
+        event->arg = (uintptr_t)(now - startTime);
+    }
+    else
+    {
+        event->time = now;
+        event->arg = arg;
+    }
+    event->kind = (uint16_t)kind;
+    event->id = (uint16_t)id;
+    STORE_RELEASE(buffer->next, n + 1);
+}
+
+void TraceModule::SetEnabled(bool enable)
+{
+    if (enable && startTime == 0)
+        startTime = traceTimestamp();
+    traceEnabled = enable;
+}
+
+// Find a name for an address in an RTS function.
+static std::string rtsFunctionName(uintptr_t addr, std::map<uintptr_t, std::string> &cache)
+{
+    std::map<uintptr_t, std::string>::iterator i = cache.find(addr);
+    if (i != cache.end()) return i->second;
+    std::string name;
+#if (defined(HAVE_DLFCN_H) && !defined(_WIN32))
+    Dl_info info;
+    if (dladdr((void*)addr, &info) != 0 && info.dli_sname != 0)
+        name = info.dli_sname;
+#endif
+    if (name.empty())
+    {
+        char buff[40];
+        snprintf(buff, sizeof(buff), "%p", (void*)addr);
+        name = buff;
+    }
+    cache[addr] = name;
+    return name;
+}
+
+static void writeEvent(FILE *f, bool &first, const char *ph, const std::string &name, const char *category,
+                       double ts, double dur, unsigned long tid, const char *phase)
+{
+    fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f", first ? "" : ",",
+        name.c_str(), category, ph, ts);
+    if (*ph == 'X') fprintf(f, ",\"dur\":%.3f", dur);
+    fprintf(f, ",\"pid\":%d,\"tid\":%lu", (int)getpid(), tid);
+    if (phase != 0) fprintf(f, ",\"args\":{\"phase\":\"%s\"}", phase);
+    fputs("}", f);
+    first = false;
+}
+
+// Write the trace in the Chrome JSON format.  Begin and end events are matched
+// and written as complete events.  Returns zero or an error code.
+int TraceModule::Dump(const char *fileName)
+{
+    PLocker dumpLocker(&dumpLock);
+    FILE *f = fopen(fileName, "w");
+    if (f == 0) return errno;
+
+    std::vector<TraceBuffer*> toDump;
+    {
+        PLocker lock(&registryLock);
+        toDump = buffers;
+    }
+    std::map<uintptr_t, std::string> nameCache;
+    std::vector<TraceEvent> events;
+    bool first = true;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+
+    for (std::vector<TraceBuffer*>::iterator i = toDump.begin(); i != toDump.end(); i++)
+    {
+        TraceBuffer *buffer = *i;
+        unsigned long tid = buffer->threadId;
+        // Copy the events and then remove any that may have been overwritten.
+        uint64_t end = LOAD_ACQUIRE(buffer->next);
+        uint64_t start = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+        events.clear();
+        for (uint64_t n = start; n < end; n++)
+            events.push_back(buffer->events[n & (TRACE_BUFFER_EVENTS-1)]);
+        ACQUIRE_FENCE();
+        uint64_t newNext = LOAD_ACQUIRE(buffer->next);
+        size_t skip = 0;
+        if (newNext < end) skip = events.size(); // The buffer has been reused.
+        else if (newNext - TRACE_BUFFER_EVENTS > start && newNext > TRACE_BUFFER_EVENTS)
+            skip = (size_t)(newNext - TRACE_BUFFER_EVENTS - start);
+        if (skip >= events.size()) continue;
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",", (int)getpid(), tid, buffer->threadName);
+        first = false;
+
+        std::vector<TraceEvent> open; // Begin events that have not yet been matched.
+        for (size_t j = skip; j < events.size(); j++)
+        {
+            TraceEvent &ev = events[j];
+            if (ev.id >= TRACE_MAX_EVENT) continue;
+            if (ev.kind == TRACE_BEGIN)
+                open.push_back(ev);
+            else
+            {
+                TraceEvent begin = ev;
+                double dur = (double)ev.arg / 1000.0;
+                if (ev.kind == TRACE_END)
+                {
+                    // Find the matching begin.  If it has been lost ignore the end.
+                    size_t k = open.size();
+                    while (k > 0 && open[k-1].id != ev.id) k--;
+                    if (k == 0) continue;
+                    begin = open[k-1];
+                    open.resize(k-1); // Discard any unmatched events inside this.
+                    dur = (double)(ev.time - begin.time) / 1000.0;
+                }
+                std::string name = eventNames[ev.id].name;
+                const char *phase = 0;
+                if (ev.id == TRACE_RTS_CALL)
+                    name = rtsFunctionName(begin.arg, nameCache);
+                else if (ev.id == TRACE_ROOT_REQUEST || ev.id == TRACE_ROOT_PERFORM || ev.id == TRACE_SAFEPOINT)
+                {
+                    if (ev.kind == TRACE_COMPLETE) phase = 0;
+                    else if (begin.arg < MTP_MAXENTRY) phase = phaseNames[begin.arg];
+                }
+                writeEvent(f, first, "X", name, eventNames[ev.id].category,
+                    (double)(begin.time - startTime) / 1000.0, dur, tid, phase);
+            }
+        }
+        // Anything still open is written as a begin event.
+        for (std::vector<TraceEvent>::iterator k = open.begin(); k != open.end(); k++)
+        {
+            std::string name = k->id == TRACE_RTS_CALL ? rtsFunctionName(k->arg, nameCache) : eventNames[k->id].name;
+            writeEvent(f, first, "B", name, eventNames[k->id].category,
+                (double)(k->time - startTime) / 1000.0, 0.0, tid, 0);
+        }
+    }
+    fputs("\n]}\n", f);
+    if (ferror(f))
+    {
+        fclose(f);
+        return EIO;
+    }
+    if (fclose(f) != 0) return errno;
+    return 0;
+}
+
+#if (!defined(_WIN32))
+// SIGUSR2 requests a dump to the file given with --trace.  The signal handler
+// writes to a pipe and a separate thread does the work.
+static void catchTraceSignal(SIG_HANDLER_ARGS(sig, context))
+{
+    char ch = 0;
+    if (write(traceModule.dumpPipeWrite, &ch, 1) < 0) {}
+}
+
+static void *traceDumpThread(void *)
+{
+    char ch;
+    while (read(traceModule.dumpPipeRead, &ch, 1) == 1)
+    {
+        int err = traceModule.Dump(traceModule.traceFile.c_str());
+        if (err != 0)
+            Log("TRACE: Unable to write %s: %s\n", traceModule.traceFile.c_str(), strerror(err));
+    }
+    return 0;
+}
+#endif
+
+void TraceModule::Init(void)
+{
+    mainThread = currentThreadId();
+#if (!defined(_WIN32))
+    pthread_key_create(&bufferKey, traceBufferDestructor);
+#else
+    bufferKey = TlsAlloc();
+#endif
+    if (!traceFile.empty())
+        SetEnabled(true);
+}
+
+void TraceModule::Start(void)
+{
+#if (!defined(_WIN32))
+    if (traceFile.empty()) return;
+    int fds[2];
+    if (pipe(fds) != 0) return;
+    dumpPipeRead = fds[0];
+    dumpPipeWrite = fds[1];
+    // Run the thread with the signals blocked.
+    sigset_t blockAll, oldMask;
+    sigfillset(&blockAll);
+    pthread_sigmask(SIG_SETMASK, &blockAll, &oldMask);
+    pthread_t thread;
+    pthread_attr_t attrs;
+    pthread_attr_init(&attrs);
+    pthread_attr_setdetachstate(&attrs, PTHREAD_CREATE_DETACHED);
+    bool started = pthread_create(&thread, &attrs, traceDumpThread, 0) == 0;
+    pthread_attr_destroy(&attrs);
+    pthread_sigmask(SIG_SETMASK, &oldMask, 0);
+    if (started)
+    {
+        markSignalInuse(SIGUSR2);
+        setSignalHandler(SIGUSR2, catchTraceSignal);
+    }
+#endif
+}
+
+// If --trace was given write the trace at the end.
+void TraceModule::Stop(void)
+{
+    if (traceFile.empty()) return;
+    traceEnabled = false;
+    int err = Dump(traceFile.c_str());
+    if (err != 0)
+        Log("TRACE: Unable to write %s: %s\n", traceFile.c_str(), strerror(err));
+}
+
+void traceSetFile(const TCHAR *fileName)
+{
+#if (defined(_WIN32) && defined(UNICODE))
+    char buff[MAX_PATH];
+    WideCharToMultiByte(CP_UTF8, 0, fileName, -1, buff, sizeof(buff), NULL, NULL);
+    traceModule.traceFile = buff;
+#else
+    traceModule.traceFile = fileName;
+#endif
+}
+
+POLYUNSIGNED PolySetTracing(POLYUNSIGNED enable)
+{
+    traceModule.SetEnabled(PolyWord::FromUnsigned(enable).UnTagged() != 0);
+    return TAGGED(0).AsUnsigned();
+}
+
+// Write the trace to a file.
+POLYUNSIGNED PolyDumpTrace(POLYUNSIGNED threadId, POLYUNSIGNED fileName)
+{
+    TaskData *taskData = TaskData::FindTaskForId(threadId);
+    ASSERT(taskData != 0);
+    taskData->PreRTSCall();
+    Handle reset = taskData->saveVec.mark();
+
+    try {
+        TempCString name(Poly_string_to_C_alloc(PolyWord::FromUnsigned(fileName)));
+        // Don't hold on to the ML memory while writing the file.
+        processes->ThreadReleaseMLMemory(taskData);
+        int err = traceModule.Dump(name);
+        processes->ThreadUseMLMemory(taskData);
+        if (err != 0)
+            raise_syscall(taskData, "Unable to write trace", err);
+    }
+    catch (...) {} // If an ML exception is raised
+
+    taskData->saveVec.reset(reset);
+    taskData->PostRTSCall();
+    return TAGGED(0).AsUnsigned();
+}
+
+struct _entrypts tracingEPT[] =
+{
+    { "PolySetTracing",                 (polyRTSFunction)&PolySetTracing},
+    { "PolyDumpTrace",                  (polyRTSFunction)&PolyDumpTrace},
+
+    { NULL, NULL} // End of list.
+};
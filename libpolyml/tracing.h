@@ -0,0 +1,91 @@
+/*
+    Title:      Event trace buffers for the run-time system.
+
+    Copyright (c) 2026 David C. J. Matthews
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License version 2.1 as published by the Free Software Foundation.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#ifndef _TRACING_H
+#define _TRACING_H
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#ifdef HAVE_TCHAR_H
+#include <tchar.h>
+#else
+typedef char TCHAR;
+#endif
+
+// Events that can be traced.  Most are recorded as a begin and an end.
+typedef enum {
+    TRACE_GC_FULL,      // Full GC
+    TRACE_GC_MINOR,     // Minor GC
+    TRACE_GC_SHARING,   // Phases of the full GC.
+    TRACE_GC_MARK,
+    TRACE_GC_WEAKREF,
+    TRACE_GC_COPY,
+    TRACE_GC_UPDATE,
+    TRACE_ROOT_REQUEST, // An ML thread waiting for the main thread.  The argument is the phase.
+    TRACE_ROOT_PERFORM, // The main thread performing a request.  The argument is the phase.
+    TRACE_SAFEPOINT,    // Time from a request until all the ML threads had stopped.
+    TRACE_BLOCKED,      // An ML thread not using the heap because it is waiting.
+    TRACE_RTS_CALL,     // A call into the RTS.  The argument is an address in the function.
+    TRACE_MAX_EVENT
+} TraceEventId;
+
+typedef enum { TRACE_BEGIN, TRACE_END, TRACE_COMPLETE } TraceEventKind;
+
+// True if events are being recorded.
+extern bool traceEnabled;
+
+extern uint64_t traceTimestamp(void);
+extern void traceRecord(TraceEventKind kind, TraceEventId id, uintptr_t arg, uint64_t startTime);
+
+inline void traceBegin(TraceEventId id, uintptr_t arg = 0)
+{
+    if (traceEnabled) traceRecord(TRACE_BEGIN, id, arg, 0);
+}
+
+inline void traceEnd(TraceEventId id, uintptr_t arg = 0)
+{
+    if (traceEnabled) traceRecord(TRACE_END, id, arg, 0);
+}
+
+// Record an event that started at startTime and has just finished.
+inline void traceComplete(TraceEventId id, uint64_t startTime, uintptr_t arg = 0)
+{
+    if (traceEnabled) traceRecord(TRACE_COMPLETE, id, arg, startTime);
+}
+
+// Set from the --trace option.  Tracing starts immediately and the trace is
+// written to the file when SIGUSR2 is received and at the end.
+extern void traceSetFile(const TCHAR *fileName);
+
+extern struct _entrypts tracingEPT[];
+
+// The address that the current function will return to.  Used to identify RTS calls.
+#if (defined(__GNUC__))
+#define TRACE_RETURN_ADDRESS    ((uintptr_t)__builtin_return_address(0))
+#elif (defined(_MSC_VER))
+#include <intrin.h>
+#define TRACE_RETURN_ADDRESS    ((uintptr_t)_ReturnAddress())
+#else
+#define TRACE_RETURN_ADDRESS    0
+#endif
+
+#endif
@@ -660,6 +660,20 @@ static Handle writeArray(TaskData *taskData, Handle stream, Handle args, bool/*i
     return Make_fixed_precision(taskData, haveWritten);
 }
 
+// Vectored IO.  Windows has no direct equivalent of readv and writev for
+// the various kinds of stream so we transfer only the first non-empty slice.
+// This is allowed since the caller must deal with a partial transfer.
+static Handle firstNonEmptySlice(TaskData *taskData, Handle args)
+{
+    for (PolyWord p = args->Word(); !ML_Cons_Cell::IsNull(p); p = ((ML_Cons_Cell*)p.AsObjPtr())->t)
+    {
+        PolyWord triple = ((ML_Cons_Cell*)p.AsObjPtr())->h;
+        if (getPolyUnsigned(taskData, triple.AsObjPtr()->Get(2)) != 0)
+            return SAVE(triple);
+    }
+    return 0;
+}
+
 Handle pollTest(TaskData *taskData, Handle stream)
 {
     WinStream *strm = *(WinStream**)(stream->WordP());
@@ -1168,6 +1182,20 @@ static Handle IO_dispatch_c(TaskData *taskData, Handle args, Handle strm, Handle
     case 26: /* Get binary as a vector. */
         return readString(taskData, strm, args, false);
 
+    case 32: /* Read binary into a list of array slices. */
+    {
+        Handle slice = firstNonEmptySlice(taskData, args);
+        if (slice == 0) return Make_fixed_precision(taskData, 0);
+        return readArray(taskData, strm, slice, false);
+    }
+
+    case 33: /* Write from a list of array or vector slices. */
+    {
+        Handle slice = firstNonEmptySlice(taskData, args);
+        if (slice == 0) return Make_fixed_precision(taskData, 0);
+        return writeArray(taskData, strm, slice, false);
+    }
+
     case 27: /* Block until input is available. */
     {
         WinStream *stream = *(WinStream **)(strm->WordP());
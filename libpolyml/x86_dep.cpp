@@ -217,6 +217,9 @@ public:
     virtual void addProfileCount(POLYUNSIGNED words)
     { addSynchronousCount(assemblyInterface.stackPtr[0].codeAddr, words); }
 
+    virtual POLYCODEPTR GetProfileSite(stackItem *&sp)
+    { sp = assemblyInterface.stackPtr + 1; return assemblyInterface.stackPtr[0].codeAddr; }
+
     // PreRTSCall: After calling from ML to the RTS we need to save the current heap pointer
     virtual void PreRTSCall(void) { TaskData::PreRTSCall();  SaveMemRegisters(); }
     // PostRTSCall: Before returning we need to restore the heap pointer.
@@ -849,7 +852,7 @@ bool X86TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace *space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp);
             return true;
         }
     }
@@ -861,7 +864,7 @@ bool X86TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace *space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp+1);
             return true;
         }
     }
@@ -876,7 +879,7 @@ bool X86TaskData::AddTimeProfileCount(SIGNALCONTEXT *context)
         MemSpace *space = gMem.SpaceForAddress(pc);
         if (space != 0 && (space->spaceType == ST_CODE || space->spaceType == ST_PERMANENT))
         {
-            incrementCountAsynch(pc);
+            incrementCountAsynch(this, pc, sp+1);
             return true;
         }
     }
@@ -932,6 +935,7 @@ void X86TaskData::SetMemRegisters()
         // Set the allocation register to this area. N.B.  This is an absolute address.
         if (this->allocReg < 15)
             get_reg(this->allocReg)[0].codeAddr = (POLYCODEPTR)(this->allocPointer + 1); /* remember: it's off-by-one */
+        allocationSampleCheck(this, (PolyObject*)(this->allocPointer + 1), this->allocWords);
         this->allocWords = 0;
     }
 
@@ -944,7 +948,9 @@ void X86TaskData::SetMemRegisters()
     if (this->allocPointer == 0) this->allocPointer += MAX_OBJECT_SIZE;
     if (this->allocLimit == 0) this->allocLimit += MAX_OBJECT_SIZE;
 
-    this->assemblyInterface.localMbottom = this->allocLimit + 1;
+    // If we are sampling allocations the limit may be set so that we trap
+    // at the next sample.
+    this->assemblyInterface.localMbottom = allocationSampleLimit(this) + 1;
     this->assemblyInterface.localMpointer = this->allocPointer + 1;
     // If we are profiling store allocation we set mem_hl so that a trap
     // will be generated.
@@ -959,6 +965,7 @@ void X86TaskData::SaveMemRegisters()
 {
     if (interpreterPc == 0) // Not if we're already in the interpreter
         this->allocPointer = this->assemblyInterface.localMpointer - 1;
+    allocationSampleAccount(this);
     this->allocWords = 0;
     this->assemblyInterface.exceptionPacket = TAGGED(0);
     this->saveRegisterMask = 0;
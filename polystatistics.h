@@ -41,6 +41,8 @@
 #define POLY_STATS_C_SECONDS        0x49    // Application 9 - Implicit integer
 #define POLY_STATS_C_MICROSECS      0x4A    // Application 10 - Implicit integer
 #define POLY_STATS_C_USERSTAT       0x6B    // Application 11 - Implicit sequence
+#define POLY_STATS_C_HISTOGRAMSTAT  0x6C    // Application 12 - Implicit sequence
+#define POLY_STATS_C_BUCKETS        0x6D    // Application 13 - Implicit sequence of counter values
 
 // Identifiers for the particular statistics
 #define POLY_STATS_ID_THREADS                 1   // Total number of threads
@@ -81,6 +83,25 @@
 #define POLY_STATS_ID_GC_STATE               31
 #define POLY_STATS_ID_GC_PERCENT             32
 
+#define POLY_STATS_ID_GC_MARK_RTIME          33     // Real time in the mark phase
+#define POLY_STATS_ID_GC_COPY_RTIME          34     // Real time in the copy phase
+#define POLY_STATS_ID_GC_UPDATE_RTIME        35     // Real time in the update phase
+#define POLY_STATS_ID_GC_WEAKREF_RTIME       36     // Real time checking weak references
+#define POLY_STATS_ID_GC_SHARE_RTIME         37     // Real time in the sharing phase
+
+// Histograms of GC pause times.  Each contains the total time followed by the
+// number of pauses in each bucket.  The upper bounds of the buckets in microseconds
+// are given by POLY_STATS_PAUSE_BUCKETS with a final bucket for longer pauses.
+#define POLY_STATS_ID_MINOR_GC_PAUSES        38
+#define POLY_STATS_ID_MAJOR_GC_PAUSES        39
+#define POLY_STATS_ID_SHARING_GC_PAUSES      40
+// Time between a request to stop the ML threads, e.g. for a GC, and the last thread stopping.
+#define POLY_STATS_ID_SAFEPOINT_WAITS        41
+
+#define POLY_STATS_PAUSE_BUCKETS \
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, \
+    50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+
 #endif // POLY_STATISTICS_INCLUDED
 
 